@@ -0,0 +1,384 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_array_backend_examples_hpp
+#define cl_array_backend_examples_hpp
+
+#define CL_BASE_SERIALIZER_OPEN
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <valarray>
+#include <cl/tape/tape.hpp>
+#include "impl/utils.hpp"
+#include "impl/sweep_options_examples.hpp"
+
+namespace cl
+{
+    // Returns the lanes of the value of other backend as tape value.
+    template <class Inner>
+    inline cl::tvalue array_backend_value(Inner const& x)
+    {
+        if (x.is_scalar() && !x.is_broadcast())
+        {
+            return cl::tvalue(x.scalar_value_);
+        }
+        std::valarray<double> lanes(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            lanes[i] = x.element_at(i);
+        }
+        return cl::tvalue(lanes);
+    }
+
+    template <class Inner>
+    inline std::vector<cl::tvalue> array_backend_values(std::vector<Inner> const& x)
+    {
+        std::vector<cl::tvalue> result;
+        for (Inner const& v : x)
+        {
+            result.push_back(array_backend_value(v));
+        }
+        return result;
+    }
+
+    // Records y0 = x0 * x1 + exp(x0) - x0 / 2
+    // and y1 = sin(y0) * log(x0) + x0^2 + sqrt(x0), x1 is scalar.
+    template <class Inner>
+    inline std::unique_ptr<cl::tfunc<Inner>> array_backend_function(std::vector<Inner> const& x)
+    {
+        std::vector<cl::tape_wrapper<Inner>> X = { x[0], x[1] };
+        cl::tape_start(X);
+
+        cl::tape_wrapper<Inner> u = X[0] * X[1] + std::exp(X[0]) - X[0] / 2.0;
+        cl::tape_wrapper<Inner> v = std::sin(u) * std::log(X[0]) + std::pow(X[0], 2.0) + std::sqrt(X[0]);
+        std::vector<cl::tape_wrapper<Inner>> Y = { u, v };
+        return std::unique_ptr<cl::tfunc<Inner>>(new cl::tfunc<Inner>(X, Y));
+    }
+
+    // Records the function with the array backend Inner, runs Forward(0)
+    // and Reverse(1) sweeps at the recorded and at other inputs and compares
+    // them with the sweeps of tape values.
+    template <class Inner>
+    inline void array_backend_compare(std::ostream& out_stream, const char* name
+        , std::vector<std::vector<Inner>> const& inputs)
+    {
+        out_str << name << ":\n\n";
+
+        std::vector<Inner> w = { Inner(1.0), Inner(1.0) };
+        std::vector<cl::tvalue> plain_w = array_backend_values(w);
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = array_backend_function(array_backend_values(inputs[0]));
+        std::unique_ptr<cl::tfunc<Inner>> f = array_backend_function(inputs[0]);
+        for (std::vector<Inner> const& x : inputs)
+        {
+            std::vector<cl::tvalue> plain_x = array_backend_values(x);
+            out_str << "Input vector: " << plain_x << "\n";
+            std::vector<cl::tvalue> plain_y = plain->forward(0, plain_x);
+            std::vector<cl::tvalue> plain_dx = plain->reverse(1, plain_w);
+
+            std::vector<cl::tvalue> y = array_backend_values(f->forward(0, x));
+            out_str << "Forward(0) sweep result: " << y << "\n";
+            std::vector<cl::tvalue> dx = array_backend_values(f->reverse(1, w));
+            out_str << "Reverse(1, w) sweep for w = " << plain_w << " result: " << dx << "\n";
+            out_str << "Difference from tape values: "
+                << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n";
+        }
+        out_str << "\n";
+    }
+
+    // Inputs of four lanes.
+    template <class Inner>
+    inline void array_backend_compare(std::ostream& out_stream, const char* name)
+    {
+        array_backend_compare<Inner>(out_stream, name, {
+            { Inner({ 1.0, 2.0, 0.5, 3.0 }), Inner(0.5) }
+            , { Inner({ 0.25, 4.0, 1.5, 2.0 }), Inner(-1.0) }
+        });
+    }
+
+    // Inputs of the given lane count, the lanes of the array are positive.
+    template <class Inner>
+    inline std::vector<std::vector<Inner>> array_backend_inputs(size_t lanes)
+    {
+        std::valarray<double> first(lanes), second(lanes);
+        for (size_t i = 0; i < lanes; i++)
+        {
+            first[i] = 0.5 + 0.25 * i;
+            second[i] = 2.0 - 0.0625 * i;
+        }
+        return {
+            { Inner(&first[0], lanes), Inner(0.5) }
+            , { Inner(&second[0], lanes), Inner(-1.0) }
+        };
+    }
+
+    // Copies of shared arrays share the lanes, the write through begin()
+    // or by an operator takes own lanes and leaves the copies unchanged.
+    inline void shared_array_example(std::ostream& out_stream = std::cout)
+    {
+        array_backend_compare<cl::tape_valueShared>(out_stream, "Shared array backend");
+
+        cl::tape_valueShared a = { 1, 2, 3, 4 };
+        cl::tape_valueShared b = a;
+        cl::tape_valueShared c = a;
+        out_str << "Copies share the lanes: " << (!a.array_value_.unique() ? "true" : "false") << "\n";
+        double* lanes = b.begin();
+        for (size_t i = 0; i < b.size(); i++)
+        {
+            lanes[i] *= 10;
+        }
+        c += 1.0;
+        out_str << "Written copies: " << array_backend_value(b) << " " << array_backend_value(c)
+            << " original: " << array_backend_value(a) << "\n";
+        out_str << "Original owns the lanes again: " << (a.array_value_.unique() ? "true" : "false") << "\n\n";
+    }
+
+    // Returns true if the lanes are stored inside the value.
+    template <class Inner>
+    inline bool array_backend_inline(Inner const& x)
+    {
+        const char* lanes = reinterpret_cast<const char*>(x.begin());
+        const char* value = reinterpret_cast<const char*>(&x);
+        return lanes >= value && lanes < value + sizeof(x);
+    }
+
+    // Arrays up to 16 lanes are stored inline, the sweeps are
+    // the same for the inline and for the heap storage.
+    inline void small_array_example(std::ostream& out_stream = std::cout)
+    {
+        array_backend_compare<cl::tape_valueSmall>(out_stream, "Small array backend");
+        array_backend_compare<cl::tape_valueSmall>(out_stream, "Small array backend, 20 lanes on the heap"
+            , array_backend_inputs<cl::tape_valueSmall>(20));
+
+        cl::tape_valueSmall short_array = array_backend_inputs<cl::tape_valueSmall>(16)[0][0];
+        cl::tape_valueSmall long_array = array_backend_inputs<cl::tape_valueSmall>(17)[0][0];
+        cl::tape_valueSmall moved = std::move(long_array);
+        out_str << "16 lanes stored inline: " << (array_backend_inline(short_array) ? "true" : "false") << "\n";
+        out_str << "17 lanes stored inline: " << (array_backend_inline(moved) ? "true" : "false") << "\n";
+        out_str << "Sum of copied 16 lanes: " << cl::tape_valueSmall(short_array).sum()
+            << " moved 17 lanes: " << moved.sum() << "\n\n";
+    }
+
+    // Lane count is a compile time constant, the values of other
+    // lane count are not accepted.
+    inline void fixed_array_example(std::ostream& out_stream = std::cout)
+    {
+        array_backend_compare<cl::tape_valueFixed<4>>(out_stream, "Fixed array backend");
+
+        out_str << "Lanes stored inline: "
+            << (array_backend_inline(cl::tape_valueFixed<4>({ 1, 2, 3, 4 })) ? "true" : "false") << "\n";
+        try
+        {
+            std::vector<double> lanes = { 1, 2, 3 };
+            cl::tape_valueFixed<4> x(lanes.data(), lanes.size());
+        }
+        catch (std::exception& e)
+        {
+            out_str << "Three lanes: " << e.what() << "\n";
+        }
+        out_str << "\n";
+    }
+
+    // Lazy expressions are evaluated in one loop without the intermediate
+    // arrays, the lanes are the same as the lanes of the eager operators.
+    // The expression refers to its destination and to a broadcast, and
+    // makes the step along the gradient of the recorded function.
+    template <class Inner>
+    inline void lazy_expression_compare(std::ostream& out_stream, const char* name)
+    {
+        using cl::tapescript::lazy;
+
+        out_str << name << ":\n\n";
+
+        Inner x = { 1.0, 2.0, 0.5, 3.0 };
+        Inner y = { 0.5, -1.0, 2.0, 0.25 };
+        Inner b = Inner::broadcast(3.0, 4);
+
+        Inner z = lazy(x) * y + 2.0 * exp(lazy(b) - x);
+        Inner eager = x * y + 2.0 * cl::tapescript::exp(b - x);
+        out_str << "x * y + 2 * exp(b - x) for broadcast b = 3: " << array_backend_value(z)
+            << " difference from eager: " << sweep_options_difference({ array_backend_value(z) }, { array_backend_value(eager) }) << "\n";
+
+        Inner uniform = lazy(b) * 2.0 + 1.0;
+        out_str << "b * 2 + 1 is broadcast: " << (uniform.is_broadcast() ? "true" : "false")
+            << " of " << uniform.size() << " lanes, value " << uniform.element_at(0) << "\n";
+
+        // the destination is read and written in the same loop,
+        // its copy keeps the previous lanes
+        Inner copy = x;
+        eager = x * x + cl::tapescript::sqrt(x) / 2.0;
+        x = lazy(x) * x + sqrt(lazy(x)) / 2.0;
+        out_str << "x = x * x + sqrt(x) / 2: " << array_backend_value(x)
+            << " difference from eager: " << sweep_options_difference({ array_backend_value(x) }, { array_backend_value(eager) })
+            << " copy: " << array_backend_value(copy) << "\n";
+        eager = x + x * b;
+        x += lazy(x) * b;
+        out_str << "x += x * b: " << array_backend_value(x)
+            << " difference from eager: " << sweep_options_difference({ array_backend_value(x) }, { array_backend_value(eager) }) << "\n";
+
+        std::vector<Inner> input = { copy, Inner(0.5) };
+        std::unique_ptr<cl::tfunc<Inner>> f = array_backend_function(input);
+        std::vector<Inner> y0 = f->forward(0, input);
+        std::vector<Inner> dx = f->reverse(1, std::vector<Inner>{ Inner(0.0), Inner(1.0) });
+        input[0] = lazy(input[0]) - 0.01 * lazy(dx[0]);
+        std::vector<Inner> y1 = f->forward(0, input);
+        out_str << "Step x - 0.01 * dy1/dx: " << array_backend_value(input[0])
+            << " change of y1: " << array_backend_value(Inner(y1[1] - y0[1])) << "\n\n";
+    }
+
+    inline void lazy_expression_example(std::ostream& out_stream = std::cout)
+    {
+        lazy_expression_compare<cl::tvalue>(out_stream, "Lazy expressions");
+        lazy_expression_compare<cl::tape_valueShared>(out_stream, "Lazy expressions of shared arrays");
+    }
+
+#if defined CL_SIMD_MATH_ENABLED
+    // Difference of z from r in units of the last place of r,
+    // the infinities and NaN have to be the same.
+    inline double simd_math_ulps(double z, double r)
+    {
+        if (std::isnan(z) || std::isnan(r))
+        {
+            return std::isnan(z) && std::isnan(r) ? 0.0 : std::numeric_limits<double>::infinity();
+        }
+        if (std::isinf(z) || std::isinf(r) || z == r)
+        {
+            return z == r ? 0.0 : std::numeric_limits<double>::infinity();
+        }
+        double ulp = std::nextafter(std::abs(r), std::numeric_limits<double>::infinity()) - std::abs(r);
+        return std::abs(z - r) / ulp;
+    }
+
+    // Evaluates the array functions of simd_math at the level, the arguments
+    // include the values out of the range of the vector kernels.
+    inline std::vector<std::vector<double>> simd_math_values(cl::simd_math::level_type level)
+    {
+        std::vector<double> x = { 0.0, -0.0, 1e-310, 1e-8, 709.7, 709.8, 800.0, -745.0, -800.0
+            , 1e5, 1e6, -1e5, 1e300, std::numeric_limits<double>::infinity()
+            , -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN() };
+        for (int i = 0; i <= 4000; i++)
+        {
+            x.push_back(-20.0 + 0.01 * i);
+        }
+        std::vector<double> y(x.size());
+        for (size_t i = 0; i < y.size(); i++)
+        {
+            y[i] = 0.37 * (i % 17) - 2.5;
+        }
+
+        cl::simd_math::set_level(level);
+        const size_t n = x.size();
+        std::vector<std::vector<double>> z(7, std::vector<double>(n));
+        cl::simd_math::exp(&z[0][0], &x[0], n);
+        cl::simd_math::log(&z[1][0], &x[0], n);
+        cl::simd_math::sqrt(&z[2][0], &x[0], n);
+        cl::simd_math::sin(&z[3][0], &x[0], n);
+        cl::simd_math::cos(&z[4][0], &x[0], n);
+        cl::simd_math::tanh(&z[5][0], &x[0], n);
+        cl::simd_math::pow(&z[6][0], &x[0], 1, &y[0], 1, n);
+        cl::simd_math::set_level(cl::simd_math::avx512_level);
+        return z;
+    }
+
+    // Largest difference of the values of two levels in units of the last place.
+    inline double simd_math_level_difference(std::vector<std::vector<double>> const& z
+        , std::vector<std::vector<double>> const& r)
+    {
+        double result = 0.0;
+        for (size_t k = 0; k < z.size(); k++)
+        {
+            for (size_t i = 0; i < z[k].size(); i++)
+            {
+                result = std::max(result, simd_math_ulps(z[k][i], r[k][i]));
+            }
+        }
+        return result;
+    }
+
+    // Vector kernels of each level are checked against libm, which is used
+    // by the scalar level, and against each other. Levels not supported by
+    // the CPU fall back to the widest supported one. The function recorded
+    // with the vectorized backend is swept at each level.
+    inline void simd_math_level_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Vectorized math levels:\n\n";
+
+        const double tolerance = 4.0;
+        std::vector<std::vector<double>> scalar = simd_math_values(cl::simd_math::scalar_level);
+        std::vector<std::vector<double>> sse2 = simd_math_values(cl::simd_math::sse2_level);
+        std::vector<cl::simd_math::level_type> levels = {
+            cl::simd_math::sse2_level, cl::simd_math::avx2_level, cl::simd_math::avx512_level
+        };
+        const char* names[] = { "SSE2", "AVX2", "AVX-512" };
+
+        std::vector<cl::tape_valueSimd> x = { cl::tape_valueSimd({ 1.0, 2.0, 0.5, 3.0, 0.25, 4.0, 1.5, 2.0, 7.0 }), cl::tape_valueSimd(0.5) };
+        std::vector<cl::tape_valueSimd> w = { cl::tape_valueSimd(1.0), cl::tape_valueSimd(1.0) };
+        std::vector<cl::tvalue> plain_x = array_backend_values(x);
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = array_backend_function(plain_x);
+        std::vector<cl::tvalue> plain_y = plain->forward(0, plain_x);
+        std::vector<cl::tvalue> plain_dx = plain->reverse(1, array_backend_values(w));
+        std::unique_ptr<cl::tfunc<cl::tape_valueSimd>> f = array_backend_function(x);
+
+        for (size_t k = 0; k < levels.size(); k++)
+        {
+            std::vector<std::vector<double>> z = simd_math_values(levels[k]);
+            out_str << names[k] << " within " << tolerance << " ulp of libm: "
+                << (simd_math_level_difference(z, scalar) <= tolerance ? "true" : "false");
+            if (levels[k] != cl::simd_math::sse2_level)
+            {
+                out_str << ", of SSE2: " << (simd_math_level_difference(z, sse2) <= tolerance ? "true" : "false");
+            }
+            out_str << "\n";
+
+            cl::simd_math::set_level(levels[k]);
+            std::vector<cl::tvalue> y = array_backend_values(f->forward(0, x));
+            std::vector<cl::tvalue> dx = array_backend_values(f->reverse(1, w));
+            cl::simd_math::set_level(cl::simd_math::avx512_level);
+            double difference = std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx));
+            out_str << names[k] << " sweeps within 1e-12 of tape values: " << (difference <= 1e-12 ? "true" : "false") << "\n";
+        }
+        out_str << "\n";
+    }
+
+    inline void simd_math_examples()
+    {
+        std::ofstream of("output/simd_math_output.txt");
+        cl::tape_serializer<cl::tvalue> serializer(of);
+        serializer.precision(3);
+
+        simd_math_level_example(serializer);
+    }
+#endif
+
+    inline void array_backend_examples()
+    {
+        std::ofstream of("output/array_backend_output.txt");
+        cl::tape_serializer<cl::tvalue> serializer(of);
+        serializer.precision(3);
+
+        shared_array_example(serializer);
+        small_array_example(serializer);
+        fixed_array_example(serializer);
+        lazy_expression_example(serializer);
+    }
+}
+
+#endif // cl_array_backend_examples_hpp
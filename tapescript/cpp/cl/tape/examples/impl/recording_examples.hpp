@@ -0,0 +1,268 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef cl_recording_examples_hpp
+#define cl_recording_examples_hpp
+
+#define CL_BASE_SERIALIZER_OPEN
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <valarray>
+#include <cl/tape/tape.hpp>
+#include "impl/utils.hpp"
+#include "impl/sweep_options_examples.hpp"
+
+namespace cl
+{
+    typedef CppAD::AD<cl::tvalue> recording_ad;
+
+    // Records x + 0, x * 1, x * 0, x / 4, pow(x, 3), pow(x, -2) and log(exp(x))
+    // by the operators of tape values, which rewrite them, or by the operators
+    // of CppAD, which record them as they are, if plain is true.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> simplify_function(cl::tvalue const& x, bool plain)
+    {
+        std::vector<cl::tobject> X = { x };
+        cl::tape_start(X);
+
+        cl::tvalue zeros = { 0, 0, 0, 0 };
+        std::vector<cl::tobject> Y;
+        if (plain)
+        {
+            recording_ad a = cl::tapescript::cvalue(X[0]);
+            Y = {
+                cl::tobject(a + recording_ad(cl::tvalue(0.0)))
+                , cl::tobject(a * recording_ad(cl::tvalue(1.0)))
+                , cl::tobject(a * recording_ad(zeros))
+                , cl::tobject(a / recording_ad(cl::tvalue(4.0)))
+                , cl::tobject(CppAD::pow(a, recording_ad(cl::tvalue(3.0))))
+                , cl::tobject(CppAD::pow(a, recording_ad(cl::tvalue(-2.0))))
+                , cl::tobject(CppAD::log(CppAD::exp(a)))
+            };
+        }
+        else
+        {
+            Y = {
+                X[0] + 0.0
+                , X[0] * 1.0
+                , X[0] * cl::tobject(zeros)
+                , X[0] / 4.0
+                , std::pow(X[0], 3.0)
+                , std::pow(X[0], -2.0)
+                , std::log(std::exp(X[0]))
+            };
+        }
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, Y));
+    }
+
+    // The operations with a parameter which is 0 or 1 in every lane, division
+    // by a power of two and pow with a small integer exponent are rewritten
+    // at record time. The sweeps are compared with the tape recorded without
+    // rewriting at the inputs of the recording and at other inputs.
+    inline void simplify_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Record time simplification:\n\n";
+
+        cl::tvalue x = { 1, 2, 0.5, 3 };
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = simplify_function(x, false);
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = simplify_function(x, true);
+        out_str << "Variables simplified: " << f->size_var() << " plain: " << plain->size_var() << "\n";
+
+        std::vector<cl::tvalue> w(f->Range(), cl::tvalue(1.0));
+        std::vector<cl::tvalue> inputs = { x, cl::tvalue({ 1.5, 4, 0.25, 10 }) };
+        for (cl::tvalue const& input : inputs)
+        {
+            std::vector<cl::tvalue> X = { input };
+            std::vector<cl::tvalue> y = f->forward(0, X);
+            std::vector<cl::tvalue> dx = f->reverse(1, w);
+            std::vector<cl::tvalue> plain_y = plain->forward(0, X);
+            std::vector<cl::tvalue> plain_dx = plain->reverse(1, w);
+            out_str << "Input: " << input << "\n";
+            out_str << "Forward(0) sweep result: " << y << "\n";
+            out_str << "Reverse(1, w) sweep result: " << dx << "\n";
+            out_str << "Difference from plain sweeps: "
+                << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n";
+        }
+
+        // exp overflows and underflows, log of exp is recorded as it is
+        std::vector<cl::tvalue> X = { cl::tvalue({ 800, -800, 1, 2 }) };
+        out_str << "log(exp(x)) for x = " << X[0] << ": " << f->forward(0, X)[6]
+            << " plain: " << plain->forward(0, X)[6] << "\n\n";
+    }
+
+    // Records y0 = x0 * x1 where (x0 < x1 and not x0 > 2) or x0 == 0.5, x0 + x1 elsewhere,
+    // and y1 = exp(x0) where not (x0 >= 1 or x1 < 0), x1 * x1 elsewhere.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> mask_function(std::vector<cl::tvalue> const& x)
+    {
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+
+        cl::tapescript::tape_mask<cl::tvalue> first
+            = (cl::tapescript::lt(X[0], X[1]) & !cl::tapescript::gt(X[0], 2.0)) | cl::tapescript::eq(X[0], 0.5);
+        cl::tapescript::tape_mask<cl::tvalue> second
+            = !(cl::tapescript::ge(X[0], 1.0) | cl::tapescript::lt(X[1], 0.0));
+        std::vector<cl::tobject> Y = {
+            cl::tapescript::where(first, X[0] * X[1], X[0] + X[1])
+            , cl::tapescript::where(second, std::exp(X[0]), X[1] * X[1])
+        };
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, Y));
+    }
+
+    // Forward(0) and Reverse(1) sweeps of the mask function for w = { 1, 1 },
+    // evaluated by branches for each lane.
+    inline std::vector<cl::tvalue> mask_lane_sweeps(std::vector<cl::tvalue> const& x)
+    {
+        size_t lanes = x[0].size();
+        std::valarray<double> y0(lanes), y1(lanes), dx0(lanes), dx1(lanes);
+        for (size_t i = 0; i < lanes; i++)
+        {
+            double a = x[0].element_at(i), b = x[1].element_at(i);
+            if ((a < b && !(a > 2)) || a == 0.5)
+            {
+                y0[i] = a * b; dx0[i] = b; dx1[i] = a;
+            }
+            else
+            {
+                y0[i] = a + b; dx0[i] = 1; dx1[i] = 1;
+            }
+
+            if (!(a >= 1 || b < 0))
+            {
+                y1[i] = std::exp(a); dx0[i] += y1[i];
+            }
+            else
+            {
+                y1[i] = b * b; dx1[i] += 2 * b;
+            }
+        }
+        return { cl::tvalue(y0), cl::tvalue(y1), cl::tvalue(dx0), cl::tvalue(dx1) };
+    }
+
+    // Lanes are selected by the masks combined by &, | and !, the recorded
+    // conditional expressions select the lanes again for other inputs.
+    // The sweeps are compared with the branches evaluated for each lane.
+    inline void mask_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Lane masks:\n\n";
+
+        std::vector<cl::tvalue> x = { cl::tvalue({ 0.5, 1, 3, 0.2 }), cl::tvalue({ 0.1, 2, 4, -1 }) };
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = mask_function(x);
+
+        std::vector<cl::tvalue> w = { 1.0, 1.0 };
+        std::vector<std::vector<cl::tvalue>> inputs = {
+            x, { cl::tvalue({ 2.5, 0.5, 1.5, -2 }), cl::tvalue({ 3, 0.5, 1, 1 }) }
+        };
+        for (std::vector<cl::tvalue> const& input : inputs)
+        {
+            std::vector<cl::tvalue> y = f->forward(0, input);
+            std::vector<cl::tvalue> dx = f->reverse(1, w);
+            std::vector<cl::tvalue> lane = mask_lane_sweeps(input);
+            out_str << "Input vector: " << input << "\n";
+            out_str << "Forward(0) sweep result: " << y << "\n";
+            out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+            out_str << "Difference from lane branches: " << std::max(
+                sweep_options_difference(y, { lane[0], lane[1] })
+                , sweep_options_difference(dx, { lane[2], lane[3] })) << "\n";
+        }
+        out_str << "\n";
+    }
+
+    // Returns true if the equal arrays have the same hash at each level
+    // supported by the CPU, and the hash does not depend on the level.
+    inline bool dedup_hash_levels(std::vector<cl::tvalue> const& arrays)
+    {
+        bool same = true;
+        for (int level = cl::simd_math::scalar_level; level <= cl::simd_math::avx512_level; level++)
+        {
+            for (cl::tvalue const& x : arrays)
+            {
+                cl::tvalue copy = std::valarray<double>(x.begin(), x.size());
+                cl::simd_math::set_level(cl::simd_math::scalar_level);
+                std::uint64_t scalar_hash = cl::simd_math::hash(x.begin(), x.size());
+                cl::simd_math::set_level(static_cast<cl::simd_math::level_type>(level));
+                same = same && cl::simd_math::hash(x.begin(), x.size()) == scalar_hash
+                    && cl::simd_math::hash(copy.begin(), copy.size()) == scalar_hash;
+            }
+        }
+        cl::simd_math::set_level(cl::simd_math::avx512_level);
+        return same;
+    }
+
+    // Equal array constants are recorded as one parameter, the arrays
+    // which differ in one lane by one ulp or by the order of the lanes
+    // are recorded separately.
+    inline void dedup_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Parameter deduplication:\n\n";
+
+        std::vector<double> lanes = { 0.5, -0.0, 1.25, 3, 7, 0.1, 2, 9, 4.5, 6 };
+        std::valarray<double> a(lanes.data(), lanes.size());
+        std::valarray<double> b = a;
+        b[1] = 0.0;
+        std::valarray<double> ulp = a;
+        ulp[5] = std::nextafter(ulp[5], 1.0);
+        std::valarray<double> swapped = a;
+        std::swap(swapped[2], swapped[3]);
+        std::vector<cl::tvalue> constants = {
+            cl::tvalue(a), cl::tvalue(b), cl::tvalue(a), cl::tvalue(ulp), cl::tvalue(swapped)
+        };
+        out_str << "Equal arrays have equal hash at all levels: " << (dedup_hash_levels(constants) ? "true" : "false") << "\n";
+        out_str << "Hash differs for one ulp: "
+            << (cl::simd_math::hash(&a[0], a.size()) != cl::simd_math::hash(&ulp[0], ulp.size()) ? "true" : "false") << "\n";
+        out_str << "Hash differs for swapped lanes: "
+            << (cl::simd_math::hash(&a[0], a.size()) != cl::simd_math::hash(&swapped[0], swapped.size()) ? "true" : "false") << "\n";
+
+        std::vector<cl::tobject> X = { cl::tvalue(1.0) };
+        cl::tape_start(X);
+        std::vector<cl::tobject> Y;
+        for (cl::tvalue const& c : constants)
+        {
+            Y.push_back(X[0] * cl::tobject(c));
+        }
+        cl::tfunc<cl::tvalue> f(X, Y);
+        out_str << "Constants recorded: " << constants.size() << " parameters: " << f.size_par() << "\n";
+
+        std::vector<cl::tvalue> x = { cl::tvalue(2.0) };
+        std::vector<cl::tvalue> y = f.forward(0, x);
+        std::vector<cl::tvalue> expected;
+        for (cl::tvalue const& c : constants)
+        {
+            expected.push_back(2.0 * c);
+        }
+        out_str << "Difference from constants: " << sweep_options_difference(y, expected) << "\n";
+        bool kept = y[3].element_at(5) == 2.0 * ulp[5] && y[0].element_at(5) == 0.2
+            && y[4].element_at(2) == 6.0 && y[0].element_at(2) == 2.5;
+        out_str << "Near-duplicate lanes kept: " << (kept ? "true" : "false") << "\n\n";
+    }
+
+    inline void recording_examples()
+    {
+        std::ofstream of("output/recording_output.txt");
+        cl::tape_serializer<cl::tvalue> serializer(of);
+        serializer.precision(3);
+
+        simplify_example(serializer);
+        mask_example(serializer);
+        dedup_example(serializer);
+    }
+}
+
+#endif // cl_recording_examples_hpp
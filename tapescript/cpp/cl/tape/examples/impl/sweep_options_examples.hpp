@@ -0,0 +1,560 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_sweep_options_examples_hpp
+#define cl_sweep_options_examples_hpp
+
+#define CL_BASE_SERIALIZER_OPEN
+#include <memory>
+#include <cl/tape/tape.hpp>
+#include "impl/utils.hpp"
+
+namespace cl
+{
+    // Lanes of the inputs of the sweep option examples.
+    inline std::vector<cl::tvalue> sweep_options_input()
+    {
+        cl::tvalue x0 = { 1, 2, 0.5, -1, 1.5, 3, -0.5, 2.5 };
+        cl::tvalue x1 = { 3, 4, -2, 0.25, 1, -1, 2, 0.5 };
+        return { x0, x1 };
+    }
+
+    // Records y0 = (x0 * x1 + x0)^2 and y1 = sum of x0 * exp(-x1) over the lanes,
+    // x0 * x1 + x0 is recorded twice and a value not used by the outputs is recorded.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> sweep_options_function()
+    {
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+
+        cl::tobject u = X[0] * X[1] + X[0];
+        cl::tobject u_again = X[0] * X[1] + X[0];
+        cl::tobject unused = std::exp(X[0]);
+        cl::tobject v = X[0] * std::exp(-X[1]);
+        std::vector<cl::tobject> Y = { u * u_again, cl::tapescript::sum_vec(v) };
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, Y));
+    }
+
+    // Largest difference of the lanes of a and b.
+    inline double sweep_options_difference(std::vector<cl::tvalue> const& a, std::vector<cl::tvalue> const& b)
+    {
+        double result = 0;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            cl::tvalue d = a[i] - b[i];
+            for (size_t k = 0; k < (d.is_array() ? d.size() : 1); k++)
+            {
+                result = std::max(result, std::abs(d.element_at(k)));
+            }
+        }
+        return result;
+    }
+
+    // Reverse(1, w) sweep of the function recorded by doubles for each lane,
+    // the tape has no arrays, so its sweep stores the partials of all variables.
+    inline std::vector<cl::tvalue> sweep_options_lane_reverse(std::vector<cl::tvalue> const& x, std::vector<double> const& w)
+    {
+        size_t lanes = x[0].size();
+        std::vector<cl::tdouble> X(2 * lanes);
+        std::vector<double> xd(2 * lanes);
+        for (size_t i = 0; i < lanes; i++)
+        {
+            X[i] = xd[i] = x[0].element_at(i);
+            X[lanes + i] = xd[lanes + i] = x[1].element_at(i);
+        }
+        cl::tape_start(X);
+
+        std::vector<cl::tdouble> Y(lanes + 1);
+        cl::tdouble sum = 0.0;
+        for (size_t i = 0; i < lanes; i++)
+        {
+            cl::tdouble u = X[i] * X[lanes + i] + X[i];
+            Y[i] = u * u;
+            sum += X[i] * std::exp(-X[lanes + i]);
+        }
+        Y[lanes] = sum;
+        cl::tfunc<double> f(X, Y);
+
+        std::vector<double> wd(lanes + 1, w[0]);
+        wd[lanes] = w[1];
+        f.forward(0, xd);
+        std::vector<double> dx = f.reverse(1, wd);
+
+        std::valarray<double> dx0(&dx[0], lanes);
+        std::valarray<double> dx1(&dx[lanes], lanes);
+        return { cl::tvalue(dx0), cl::tvalue(dx1) };
+    }
+
+    // Runs Forward(0) and Reverse(1) sweeps of the function with the option
+    // set by setup and compares them with the sweeps of the plain function.
+    template <class Setup>
+    inline void sweep_options_compare(std::ostream& out_stream, const char* name, Setup setup)
+    {
+        out_str << name << ":\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0, 1.0 };
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = sweep_options_function();
+        std::vector<cl::tvalue> plain_y = plain->forward(0, x);
+        std::vector<cl::tvalue> plain_dx = plain->reverse(1, w);
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_function();
+        setup(*f);
+        std::vector<cl::tvalue> y = f->forward(0, x);
+        out_str << "Forward(0) sweep result: " << y << "\n";
+        std::vector<cl::tvalue> dx = f->reverse(1, w);
+        out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+
+        out_str << "Difference from plain sweeps: "
+            << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n\n";
+    }
+
+    // Forward and reverse sweeps of four lane shards run concurrently.
+    inline void lane_shards_example(std::ostream& out_stream = std::cout)
+    {
+        sweep_options_compare(out_stream, "Lane shards", [](cl::tfunc<cl::tvalue>& f)
+        {
+            f.set_lane_shards(4);
+        });
+    }
+
+    // Elementwise operations are evaluated by fused groups block by block of lanes.
+    inline void fusion_example(std::ostream& out_stream = std::cout)
+    {
+        sweep_options_compare(out_stream, "Fusion", [&out_stream](cl::tfunc<cl::tvalue>& f)
+        {
+            f.set_fusion();
+            out_str << "Fused groups: " << f.fused_groups() << "\n";
+        });
+    }
+
+    // Operations not used by the outputs are removed and the common
+    // subexpressions are merged.
+    inline void optimize_example(std::ostream& out_stream = std::cout)
+    {
+        sweep_options_compare(out_stream, "Optimize", [&out_stream](cl::tfunc<cl::tvalue>& f)
+        {
+            out_str << "Variables before optimize: " << f.size_var() << "\n";
+            f.optimize();
+            out_str << "Variables after optimize: " << f.size_var() << "\n";
+        });
+    }
+
+    // The reverse sweep takes array storage for a partial before its first write
+    // and gives it back after the operation which makes the variable, the sweep
+    // is compared with the sweep of the tape of doubles for each lane.
+    inline void liveness_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Liveness:\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0, 1.0 };
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_function();
+        f->forward(0, x);
+        std::vector<cl::tvalue> dx = f->reverse(1, w);
+        out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+        out_str << "Difference from lane tape of doubles: "
+            << sweep_options_difference(dx, sweep_options_lane_reverse(x, { 1.0, 1.0 })) << "\n\n";
+    }
+
+    // The storage pooled by the function after repeated Forward(0) and Reverse(1)
+    // sweeps is taken by the next sweeps, so the pool does not grow.
+    inline void arena_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Arena:\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0, 1.0 };
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_function();
+
+        const size_t sweeps = 6;
+        size_t first = 0;
+        bool stable = true;
+        for (size_t k = 0; k < sweeps; k++)
+        {
+            f->forward(0, x);
+            f->reverse(1, w);
+            if (k == 0)
+            {
+                first = f->arena().size();
+            }
+            stable = stable && f->arena().size() == first;
+        }
+        out_str << "Pooled arrays stable over " << sweeps << " sweeps: " << (stable ? "true" : "false") << "\n\n";
+    }
+
+    // The reverse sweep seeded with one output starts with untouched partials,
+    // the operations whose results have untouched partials are skipped.
+    // The sweeps are compared with the sweeps of the tape of doubles for each lane.
+    inline void untouched_partials_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Untouched partials:\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_function();
+        f->forward(0, x);
+        std::vector<std::vector<double>> weights = { { 1.0, 0.0 }, { 0.0, 1.0 } };
+        for (std::vector<double> const& weight : weights)
+        {
+            std::vector<cl::tvalue> w = { weight[0], weight[1] };
+            std::vector<cl::tvalue> dx = f->reverse(1, w);
+            out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+            out_str << "Difference from lane tape of doubles: "
+                << sweep_options_difference(dx, sweep_options_lane_reverse(x, weight)) << "\n";
+        }
+        out_str << "\n";
+    }
+
+    // Forward sweeps which are not followed by a reverse sweep give the storage
+    // of the values back after their last read, the sweeps of zero and first
+    // order are compared with the sweeps of the plain function.
+    inline void forward_only_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Forward-only:\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> dx = { 1.0, 0.0 };
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = sweep_options_function();
+        std::vector<cl::tvalue> plain_y = plain->forward(0, x);
+        std::vector<cl::tvalue> plain_dy = plain->forward(1, dx);
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_function();
+        f->set_forward_only();
+        std::vector<cl::tvalue> y = f->forward(0, x);
+        out_str << "Forward(0) sweep result: " << y << "\n";
+
+        // the sweep of first order starts from zero order
+        std::vector<cl::tvalue> xdx = { x[0], dx[0], x[1], dx[1] };
+        std::vector<cl::tvalue> ydy = f->forward(1, xdx);
+        std::vector<cl::tvalue> dy = { ydy[1], ydy[3] };
+        out_str << "Forward(1, dx) sweep for dx = " << dx << " result: " << dy << "\n";
+
+        out_str << "Difference from plain sweeps: "
+            << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dy, plain_dy)) << "\n\n";
+    }
+
+    // The zero order sweep drops the results of cheap operations after their
+    // last read and the reverse sweep makes them again before the first operation
+    // which reads them, the sweeps are compared with the sweeps storing all values.
+    inline void recompute_example(std::ostream& out_stream = std::cout)
+    {
+        std::vector<unsigned> classes = { cl::recompute_linear, cl::recompute_all };
+        for (unsigned c : classes)
+        {
+            sweep_options_compare(out_stream, c == cl::recompute_all ? "Recompute all" : "Recompute linear"
+                , [&out_stream, c](cl::tfunc<cl::tvalue>& f)
+            {
+                f.set_recompute(c, 1);
+                out_str << "Recomputed operations: " << f.recomputed() << "\n";
+            });
+        }
+    }
+
+    // Records y = a * x0 + exp(b * x1), a and b are dynamic parameters if dynamic is true.
+    inline void dynamic_function(cl::tfunc<cl::tvalue>& f, double a, double b, bool dynamic)
+    {
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+
+        std::vector<cl::tobject> P = { cl::tvalue(a), cl::tvalue(b) };
+        if (dynamic)
+        {
+            cl::tape_dynamic(P);
+        }
+        std::vector<cl::tobject> Y = { P[0] * X[0] + std::exp(P[1] * X[1]) };
+        f.dependent(X, Y);
+    }
+
+    // The dynamic parameters are replaced without recording again,
+    // the sweeps are compared with the function recorded with the new values.
+    inline void dynamic_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Dynamic parameters:\n\n";
+
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0 };
+        out_str << "Input vector: " << x << "\n";
+
+        cl::tfunc<cl::tvalue> plain;
+        dynamic_function(plain, 2.0, -0.5, false);
+        std::vector<cl::tvalue> plain_y = plain.forward(0, x);
+        std::vector<cl::tvalue> plain_dx = plain.reverse(1, w);
+
+        cl::tfunc<cl::tvalue> f;
+        dynamic_function(f, 1.0, 0.25, true);
+        out_str << "Dynamic parameters recorded: " << f.size_dynamic() << "\n";
+        std::vector<cl::tvalue> p = { 2.0, -0.5 };
+        f.new_dynamic(p);
+        out_str << "New dynamic parameters: " << p << "\n";
+
+        std::vector<cl::tvalue> y = f.forward(0, x);
+        out_str << "Forward(0) sweep result: " << y << "\n";
+        std::vector<cl::tvalue> dx = f.reverse(1, w);
+        out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+
+        out_str << "Difference from recording with the new values: "
+            << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n\n";
+    }
+
+    // Calls of a function with a branch by the tape cache, the tape is recorded
+    // again when the branch changes and when the previous recording has thrown.
+    inline void tape_cache_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Tape cache:\n\n";
+
+        typedef std::vector<cl::tobject> tape_vector;
+        auto record = [](tape_vector const& X)
+        {
+            if (X[0] > 0.0)
+            {
+                return tape_vector{ X[0] * X[0] };
+            }
+            return tape_vector{ -X[0] };
+        };
+
+        cl::tape_cache<cl::tvalue> cache;
+        std::vector<double> inputs = { 1, 2, -1, -3, 3 };
+        for (double input : inputs)
+        {
+            std::vector<cl::tvalue> x = { input };
+            std::vector<cl::tvalue> y;
+            size_t records = cache.records();
+            cl::tfunc<cl::tvalue>& f = cache.forward("branch", x, y, record);
+            std::vector<cl::tvalue> dx = f.reverse(1, std::vector<cl::tvalue>{ 1.0 });
+            out_str << "x = " << x << " y = " << y << " dy/dx = " << dx
+                << (cache.records() > records ? " recorded" : " replayed") << "\n";
+        }
+
+        try
+        {
+            std::vector<cl::tvalue> x = { 0.0 };
+            std::vector<cl::tvalue> y;
+            cache.forward("throws", x, y, [](tape_vector const&) -> tape_vector
+            {
+                cl::throw_("Recording has failed.");
+                return tape_vector();
+            });
+        }
+        catch (std::exception& e)
+        {
+            out_str << "Exception in recording: " << e.what() << "\n";
+        }
+
+        std::vector<cl::tvalue> x = { 4.0 };
+        std::vector<cl::tvalue> y;
+        cache.forward("after", x, y, record);
+        out_str << "Next recording: x = " << x << " y = " << y << "\n";
+        out_str << "Recorded: " << cache.records() << " replayed: " << cache.hits() << "\n\n";
+    }
+
+    // Body of the loop examples, s = 0.5 * s * c + d for the data d of the step.
+    inline std::vector<cl::tobject> loop_body(std::vector<cl::tobject> const& s
+        , std::vector<cl::tobject> const& c, std::vector<cl::tobject> const& d)
+    {
+        return { 0.5 * s[0] * c[0] + d[0] };
+    }
+
+    // Data of the steps of the loop examples.
+    inline std::vector<std::vector<cl::tvalue>> loop_data(size_t count)
+    {
+        std::vector<std::vector<cl::tvalue>> data(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            data[k] = { cl::tvalue(0.25 * k) };
+        }
+        return data;
+    }
+
+    // Records the steps of the loop body one by one.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> loop_unrolled(std::vector<cl::tvalue> const& x
+        , std::vector<std::vector<cl::tvalue>> const& data)
+    {
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+        std::vector<cl::tobject> S = { X[0] };
+        for (size_t k = 0; k < data.size(); k++)
+        {
+            S = loop_body(S, { X[1] }, { data[k][0] });
+        }
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, S));
+    }
+
+    // Records the loop with the state x0 and the invariant x1.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> loop_function(cl::tape_loop<cl::tvalue>& loop
+        , std::vector<cl::tvalue> const& x)
+    {
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+        std::vector<cl::tobject> Y = loop({ X[0] }, { X[1] });
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, Y));
+    }
+
+    // Steps of the body recorded by a loop operation, the sweeps are compared
+    // with the sweeps of the steps recorded one by one. The comparisons of a scalar
+    // body which change by iteration are counted by the tape using the loop, and
+    // a body which throws does not leave its recording open.
+    inline void tape_loop_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Loop:\n\n";
+
+        const size_t count = 4;
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0 };
+        std::vector<std::vector<cl::tvalue>> data = loop_data(count);
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = loop_unrolled(x, data);
+        std::vector<cl::tvalue> plain_y = plain->forward(0, x);
+        std::vector<cl::tvalue> plain_dx = plain->reverse(1, w);
+
+        cl::tape_loop<cl::tvalue> loop("loop", count, loop_body, { x[0] }, { x[1] }, data);
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = loop_function(loop, x);
+        out_str << "Operations with loop: " << f->size_op() << " unrolled: " << plain->size_op() << "\n";
+
+        std::vector<cl::tvalue> y = f->forward(0, x);
+        out_str << "Forward(0) sweep result: " << y << "\n";
+        std::vector<cl::tvalue> dx = f->reverse(1, w);
+        out_str << "Reverse(1, w) sweep for w = " << w << " result: " << dx << "\n";
+        out_str << "Difference from unrolled sweeps: "
+            << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n";
+
+        // s is halved while it is above one, the recording takes the first branch
+        cl::tape_loop<cl::tvalue> halving("halving", count, [](std::vector<cl::tobject> const& s
+            , std::vector<cl::tobject> const& c, std::vector<cl::tobject> const&)
+        {
+            if (s[0] > 1.0)
+            {
+                return std::vector<cl::tobject>{ 0.5 * s[0] };
+            }
+            return std::vector<cl::tobject>{ s[0] * c[0] };
+        }, { cl::tvalue(4.0) }, { cl::tvalue(1.0) });
+
+        std::vector<cl::tobject> X = { cl::tvalue(4.0) };
+        cl::tape_start(X);
+        std::vector<cl::tobject> Y = halving({ X[0] }, { X[0] });
+        cl::tfunc<cl::tvalue> g(X, Y);
+        std::vector<double> inputs = { 4, 16 };
+        for (double input : inputs)
+        {
+            g.forward(0, std::vector<cl::tvalue>{ input });
+            out_str << "Iterations with changed branch for x = " << input << ": " << g.compare_change() << "\n";
+        }
+
+        try
+        {
+            cl::tape_loop<cl::tvalue> wrong("wrong", count, [](std::vector<cl::tobject> const& s
+                , std::vector<cl::tobject> const&, std::vector<cl::tobject> const&)
+            {
+                return std::vector<cl::tobject>{ s[0], s[0] };
+            }, { cl::tvalue(1.0) }, { cl::tvalue(1.0) });
+        }
+        catch (std::exception& e)
+        {
+            out_str << "Exception in recording: " << e.what() << "\n";
+        }
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> h = loop_function(loop, x);
+        out_str << "Next recording difference: "
+            << sweep_options_difference(h->forward(0, x), plain_y) << "\n\n";
+    }
+
+    // The reverse sweep of a loop of ten steps stores some carried states
+    // and runs the steps between them again, the sweeps are compared with
+    // the sweeps of the steps recorded one by one. A segment is checkpointed
+    // by a loop of one step.
+    inline void checkpoint_example(std::ostream& out_stream = std::cout)
+    {
+        out_str << "Checkpoints:\n\n";
+
+        const size_t count = 10;
+        std::vector<cl::tvalue> x = sweep_options_input();
+        std::vector<cl::tvalue> w = { 1.0 };
+        std::vector<std::vector<cl::tvalue>> data = loop_data(count);
+        out_str << "Input vector: " << x << "\n";
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain = loop_unrolled(x, data);
+        std::vector<cl::tvalue> plain_y = plain->forward(0, x);
+        std::vector<cl::tvalue> plain_dx = plain->reverse(1, w);
+
+        cl::tape_loop<cl::tvalue> loop("checkpoints", count, loop_body, { x[0] }, { x[1] }, data);
+        std::vector<size_t> checkpoints = { 0, 3, 1 };
+        for (size_t c : checkpoints)
+        {
+            loop.set_checkpoints(c);
+            std::unique_ptr<cl::tfunc<cl::tvalue>> f = loop_function(loop, x);
+            std::vector<cl::tvalue> y = f->forward(0, x);
+            std::vector<cl::tvalue> dx = f->reverse(1, w);
+            out_str << "Checkpoints " << c << " difference from unrolled sweeps: "
+                << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n";
+        }
+
+        // the memory of two carried states of eight lanes
+        loop.set_checkpoints(0);
+        loop.set_memory_budget(2 * 8 * sizeof(double));
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = loop_function(loop, x);
+        std::vector<cl::tvalue> y = f->forward(0, x);
+        std::vector<cl::tvalue> dx = f->reverse(1, w);
+        out_str << "Memory budget " << 2 * 8 * sizeof(double) << " bytes difference from unrolled sweeps: "
+            << std::max(sweep_options_difference(y, plain_y), sweep_options_difference(dx, plain_dx)) << "\n";
+
+        std::vector<std::vector<cl::tvalue>> first = loop_data(1);
+        std::unique_ptr<cl::tfunc<cl::tvalue>> plain_segment = loop_unrolled(x, first);
+        std::vector<cl::tvalue> plain_segment_y = plain_segment->forward(0, x);
+        std::vector<cl::tvalue> plain_segment_dx = plain_segment->reverse(1, w);
+
+        cl::tape_loop<cl::tvalue> segment("segment", 1, loop_body, { x[0] }, { x[1] }, first);
+        std::unique_ptr<cl::tfunc<cl::tvalue>> g = loop_function(segment, x);
+        y = g->forward(0, x);
+        dx = g->reverse(1, w);
+        out_str << "Segment difference from plain sweeps: "
+            << std::max(sweep_options_difference(y, plain_segment_y), sweep_options_difference(dx, plain_segment_dx)) << "\n\n";
+    }
+
+    inline void sweep_options_examples()
+    {
+        std::ofstream of("output/sweep_options_output.txt");
+        cl::tape_serializer<cl::tvalue> serializer(of);
+        serializer.precision(3);
+
+        lane_shards_example(serializer);
+        fusion_example(serializer);
+        optimize_example(serializer);
+        liveness_example(serializer);
+        arena_example(serializer);
+        untouched_partials_example(serializer);
+        forward_only_example(serializer);
+        recompute_example(serializer);
+        dynamic_example(serializer);
+        tape_cache_example(serializer);
+        tape_loop_example(serializer);
+        checkpoint_example(serializer);
+    }
+}
+
+#endif // cl_sweep_options_examples_hpp
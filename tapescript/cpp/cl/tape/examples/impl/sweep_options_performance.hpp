@@ -0,0 +1,176 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_sweep_options_performance_hpp
+#define cl_sweep_options_performance_hpp
+
+#define CL_BASE_SERIALIZER_OPEN
+#include <memory>
+#include <boost/timer.hpp>
+#include <cl/tape/tape.hpp>
+#include "impl/utils.hpp"
+#include "impl/sweep_options_examples.hpp"
+
+#if defined __GLIBC__
+#   include <malloc.h>
+#endif
+
+namespace cl
+{
+    // Records steps of y = y * x1 + 0.5 from y = x0, two elementwise operations by step.
+    inline std::unique_ptr<cl::tfunc<cl::tvalue>> sweep_options_chain(std::vector<cl::tvalue> const& x, size_t steps)
+    {
+        std::vector<cl::tobject> X = { x[0], x[1] };
+        cl::tape_start(X);
+
+        cl::tobject y = X[0];
+        for (size_t k = 0; k < steps; k++)
+        {
+            y = y * X[1] + 0.5;
+        }
+        std::vector<cl::tobject> Y = { y };
+        return std::unique_ptr<cl::tfunc<cl::tvalue>>(new cl::tfunc<cl::tvalue>(X, Y));
+    }
+
+    // Inputs of lanes in (0.5, 1) and (0.9, 1).
+    inline std::vector<cl::tvalue> sweep_options_lanes(size_t lanes)
+    {
+        std::valarray<double> x0(lanes);
+        std::valarray<double> x1(lanes);
+        for (size_t i = 0; i < lanes; i++)
+        {
+            x0[i] = 0.5 + 0.5 * i / lanes;
+            x1[i] = 0.9 + 0.1 * i / lanes;
+        }
+        return { cl::tvalue(x0), cl::tvalue(x1) };
+    }
+
+    // Arrays pooled after the Reverse(1) sweep of 100000 lanes of a tape of 266 steps,
+    // the partials which are alive at once, and the time of the sweeps.
+    inline void liveness_performance(std::ostream& out_stream = std::cout)
+    {
+        const size_t lanes = 100000;
+        const size_t steps = 266;
+        std::vector<cl::tvalue> x = sweep_options_lanes(lanes);
+        std::vector<cl::tvalue> w = { 1.0 };
+
+        std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_chain(x, steps);
+        out_str << "Liveness, " << lanes << " lanes, " << f->size_var() << " variables:\n";
+
+        boost::timer timer;
+        f->forward(0, x);
+        f->reverse(1, w);
+        out_str << "Forward(0) and Reverse(1) time: " << timer.elapsed() << "\n";
+        out_str << "Pooled arrays after Reverse(1): " << f->arena().size() << "\n\n";
+    }
+
+    // Bytes of heap in use, zero where it is not measured.
+    inline size_t sweep_options_heap()
+    {
+#if defined __GLIBC__ && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#else
+        return 0;
+#endif
+    }
+
+    // Time of the Forward(0) sweep of 2000 lanes of a tape of 10000 steps
+    // and the heap held by the recorded function after it, plain and forward-only.
+    inline void forward_only_performance(std::ostream& out_stream = std::cout)
+    {
+        const size_t lanes = 2000;
+        const size_t steps = 10000;
+        std::vector<cl::tvalue> x = sweep_options_lanes(lanes);
+
+        std::vector<cl::tvalue> results[2];
+        for (int forward_only = 0; forward_only < 2; forward_only++)
+        {
+            // the recording runs a zero order sweep, the heap is measured from its start
+            size_t heap = sweep_options_heap();
+            std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_chain(x, steps);
+            if (forward_only)
+            {
+                f->set_forward_only();
+            }
+            else
+            {
+                out_str << "Forward-only, " << lanes << " lanes, " << f->size_var() << " variables:\n";
+            }
+
+            boost::timer timer;
+            results[forward_only] = f->forward(0, x);
+            double elapsed = timer.elapsed();
+            size_t held = std::max(sweep_options_heap(), heap) - heap;
+            out_str << (forward_only ? "forward-only" : "plain") << " Forward(0) time: " << elapsed
+                << " heap held after the sweep (MB): " << held / double(1 << 20) << "\n";
+        }
+        out_str << "Difference: " << sweep_options_difference(results[0], results[1]) << "\n\n";
+    }
+
+    // Heap held by the function after the Forward(0) sweep of 4000 lanes of a tape
+    // of 4000 steps and the time of Forward(0) and Reverse(1) sweeps, storing all
+    // values and recomputing the linear or all cheap operations.
+    inline void recompute_performance(std::ostream& out_stream = std::cout)
+    {
+        const size_t lanes = 4000;
+        const size_t steps = 4000;
+        std::vector<cl::tvalue> x = sweep_options_lanes(lanes);
+        std::vector<cl::tvalue> w = { 1.0 };
+        out_str << "Recompute, " << lanes << " lanes, " << steps << " steps:\n";
+
+        std::vector<unsigned> classes = { cl::recompute_none, cl::recompute_linear, cl::recompute_all };
+        const char* names[] = { "store all", "linear", "all" };
+        std::vector<cl::tvalue> stored;
+        for (size_t k = 0; k < classes.size(); k++)
+        {
+            size_t heap = sweep_options_heap();
+            std::unique_ptr<cl::tfunc<cl::tvalue>> f = sweep_options_chain(x, steps);
+            f->set_recompute(classes[k]);
+
+            boost::timer timer;
+            std::vector<cl::tvalue> result = f->forward(0, x);
+            size_t held = std::max(sweep_options_heap(), heap) - heap;
+            std::vector<cl::tvalue> dx = f->reverse(1, w);
+            result.insert(result.end(), dx.begin(), dx.end());
+            double elapsed = timer.elapsed();
+            if (k == 0)
+            {
+                stored = result;
+            }
+            out_str << names[k] << " heap held after Forward(0) (MB): " << held / double(1 << 20)
+                << " Forward(0) and Reverse(1) time: " << elapsed
+                << " difference: " << sweep_options_difference(result, stored) << "\n";
+        }
+        out_str << "\n";
+    }
+
+    inline void sweep_options_performance()
+    {
+        std::ofstream of("output/performance/sweep_options_performance_output.txt");
+        cl::tape_serializer<cl::tvalue> serializer(of);
+
+        liveness_performance(serializer);
+        forward_only_performance(serializer);
+        recompute_performance(serializer);
+    }
+}
+
+#endif // cl_sweep_options_performance_hpp
@@ -90,6 +90,10 @@ struct test_stream
 #include "impl/linear_regression_examples.hpp"
 #include "impl/quadratic_regression_examples.hpp"
 #include "impl/amc_simulation_examples.hpp"
+#include "impl/sweep_options_examples.hpp"
+#include "impl/sweep_options_performance.hpp"
+#include "impl/recording_examples.hpp"
+#include "impl/array_backend_examples.hpp"
 
 //extern void performance_without_struct();
 
@@ -185,6 +189,23 @@ int main()
         tests.push_back({ "Run amc_simulation_examples see tape data in output/basic_examples_output.txt ..."
             , cl::amc_simulation_examples });
 
+        tests.push_back({ "Run sweep_options_examples see output in output/sweep_options_output.txt ..."
+            , cl::sweep_options_examples });
+
+        tests.push_back({ "Run sweep_options_performance see output in output/performance/sweep_options_performance_output.txt ..."
+            , cl::sweep_options_performance });
+
+        tests.push_back({ "Run recording_examples see output in output/recording_output.txt ..."
+            , cl::recording_examples });
+
+        tests.push_back({ "Run array_backend_examples see output in output/array_backend_output.txt ..."
+            , cl::array_backend_examples });
+
+#       if defined CL_SIMD_MATH_ENABLED
+        tests.push_back({ "Run simd_math_examples see output in output/simd_math_output.txt ..."
+            , cl::simd_math_examples });
+#       endif
+
 #       endif
 
         for (tests_type::value_type v : tests)
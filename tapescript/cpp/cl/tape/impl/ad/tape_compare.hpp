@@ -0,0 +1,76 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef cl_tape_impl_ad_tape_compare_hpp
+#define cl_tape_impl_ad_tape_compare_hpp
+
+#include <cstddef>
+#include <cl/tape/impl/detail/thread_local.hpp>
+
+namespace cl
+{
+    /// <summary>Counts the comparisons with a result different from the recording
+    /// which the atomic functions find while a zero order forward sweep of a tape
+    /// function calls them. The count of the innermost scope of the calling thread
+    /// is increased, a scope with no count stops the counting of the sweeps of
+    /// other orders.</summary>
+    template <class Base>
+    struct tape_compare_scope
+    {
+        explicit tape_compare_scope(size_t* count)
+            : count_(count)
+            , previous_(current())
+        {
+            current() = this;
+        }
+
+        ~tape_compare_scope()
+        {
+            current() = previous_;
+        }
+
+        // Adds number to the count of the calling thread, if any.
+        static void add(size_t number)
+        {
+            tape_compare_scope* scope = current();
+            if (scope != 0 && scope->count_ != 0)
+            {
+                *scope->count_ += number;
+            }
+        }
+
+        // Innermost scope of the calling thread, null if there is no one.
+        static tape_compare_scope*& current()
+        {
+            static CL_THREAD_LOCAL tape_compare_scope* scope = 0;
+            return scope;
+        }
+
+    private:
+        tape_compare_scope(tape_compare_scope const&) = delete;
+        tape_compare_scope& operator=(tape_compare_scope const&) = delete;
+
+        size_t* count_;
+        tape_compare_scope* previous_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_compare_hpp
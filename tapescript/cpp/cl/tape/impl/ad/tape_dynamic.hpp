@@ -0,0 +1,244 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_dynamic_hpp
+#define cl_tape_impl_ad_tape_dynamic_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cl/tape/impl/detail/thread_local.hpp>
+
+namespace cl
+{
+    /// <summary>Fields of CppAD::ADTape which are protected in this library.</summary>
+    template <class Base>
+    struct ad_tape_fields : CppAD::ADTape<Base>
+    {
+        static size_t id(CppAD::ADTape<Base>* tape) { return size_t(tape->*(&ad_tape_fields::id_)); }
+
+        // Records ParOp of the value, returns its variable index.
+        static size_t record_par(CppAD::ADTape<Base>* tape, const Base& value)
+        {
+            return (tape->*(&ad_tape_fields::RecordParOp))(value);
+        }
+    };
+
+    /// <summary>Dynamic parameters of a tape function, the values marked
+    /// at recording time which can be replaced without recording again.
+    /// They are recorded as ParOp variables, so the operations which use them
+    /// stay on the tape, and each of them is given its own parameter index
+    /// which is overwritten by new values. The derivatives with respect to
+    /// the dynamic parameters are zero.</summary>
+    template <class Base>
+    class dynamic_parameters
+    {
+    public:
+        typedef CppAD::AD<Base> ad_type;
+        typedef tapescript::ad_fields<Base> fields;
+
+        // Records the value of x as dynamic parameter of the recording on this thread.
+        static void record(ad_type& x)
+        {
+            CppAD::ADTape<Base>* tape = fields::tape();
+            if (tape == 0)
+            {
+                cl::throw_("Dynamic parameters are marked after the recording is started.");
+            }
+            if (CppAD::Variable(x))
+            {
+                cl::throw_("Dynamic parameter cannot depend on the independent variables.");
+            }
+
+            recording& rec = current();
+            size_t tape_id = ad_tape_fields<Base>::id(tape);
+            if (rec.tape_id != tape_id)
+            {
+                rec.tape_id = tape_id;
+                rec.variables.clear();
+            }
+
+            Base value = CppAD::Value(x);
+            size_t taddr = ad_tape_fields<Base>::record_par(tape, value);
+            rec.variables.push_back(taddr);
+            const ad_type& variable = fields(value, tape_id, taddr);
+            x = variable;
+        }
+
+        // Takes the dynamic parameters recorded on the tape with tape_id.
+        // The recorder shares the parameter indices of equal values,
+        // so each of them is moved to a new index.
+        void attach(CppAD::player<Base>& play, size_t tape_id)
+        {
+            index_.clear();
+            recording& rec = current();
+            if (rec.tape_id != tape_id)
+            {
+                return;
+            }
+
+            std::vector<size_t> variables;
+            variables.swap(rec.variables);
+            rec.tape_id = 0;
+            index_.assign(variables.size(), size_t(npos));
+
+            CppAD::OpCode op;
+            const CppAD::addr_t* arg;
+            size_t i_op;
+            size_t i_var;
+            play.forward_start(op, arg, i_op, i_var);
+            do
+            {
+                play.forward_next(op, arg, i_op, i_var);
+                if (op == CppAD::ParOp)
+                {
+                    // the variables are recorded in increasing order
+                    std::vector<size_t>::iterator it = std::lower_bound(variables.begin(), variables.end(), i_var);
+                    if (it != variables.end() && *it == i_var)
+                    {
+                        Base value = play.par_rec_[arg[0]];
+                        size_t index = play.par_rec_.extend(1);
+                        play.par_rec_[index] = value;
+                        const_cast<CppAD::addr_t*>(arg)[0] = CppAD::addr_t(index);
+                        index_[it - variables.begin()] = index;
+                    }
+                }
+            } while (op != CppAD::EndOp);
+        }
+
+        // Number of dynamic parameters.
+        size_t size() const { return index_.size(); }
+
+        // Parameter indices, the parameters removed by optimize are not included.
+        std::vector<size_t> indices() const
+        {
+            std::vector<size_t> result;
+            for (size_t index : index_)
+            {
+                if (index != npos)
+                {
+                    result.push_back(index);
+                }
+            }
+            return result;
+        }
+
+        // Replaces the values of the dynamic parameters.
+        template <class VectorBase>
+        void assign(CppAD::player<Base>& play, const VectorBase& p) const
+        {
+            if (size_t(p.size()) != index_.size())
+            {
+                cl::throw_("Number of values does not match the number of dynamic parameters.");
+            }
+            for (size_t k = 0; k < index_.size(); k++)
+            {
+                if (index_[k] != npos)
+                {
+                    play.par_rec_[index_[k]] = p[k];
+                }
+            }
+        }
+
+        // Replaces the values by NaN markers before optimize of CppAD,
+        // a NaN is not merged with other parameters by the recorder
+        // and the marker tells the dynamic parameter it belongs to.
+        void mark(CppAD::player<Base>& play)
+        {
+            values_.assign(index_.size(), Base());
+            for (size_t k = 0; k < index_.size(); k++)
+            {
+                if (index_[k] != npos)
+                {
+                    values_[k] = play.par_rec_[index_[k]];
+                    play.par_rec_[index_[k]] = Base(marker(k));
+                }
+            }
+        }
+
+        // Finds the marked parameters in the optimized tape and restores
+        // their values, the dynamic parameters which are not used are removed.
+        void unmark(CppAD::player<Base>& play)
+        {
+            std::fill(index_.begin(), index_.end(), size_t(npos));
+            for (size_t index = 0; index < play.par_rec_.size(); index++)
+            {
+                size_t k;
+                if (is_marker(play.par_rec_[index], k) && k < index_.size())
+                {
+                    index_[k] = index;
+                    play.par_rec_[index] = values_[k];
+                }
+            }
+            values_.clear();
+        }
+
+    private:
+        static const size_t npos = size_t(-1);
+
+        // Quiet NaN with the dynamic parameter in the low 32 bits.
+        static const std::uint64_t marker_bits = 0x7FF8D1A000000000ull;
+        static const std::uint64_t marker_mask = 0xFFFFFFFFull;
+
+        // Dynamic parameters of the recording on this thread.
+        struct recording
+        {
+            recording()
+                : tape_id(0)
+            {}
+
+            size_t tape_id;
+            std::vector<size_t> variables;
+        };
+
+        static recording& current()
+        {
+            return thread_instance<recording>();
+        }
+
+        static double marker(size_t k)
+        {
+            std::uint64_t bits = marker_bits | (std::uint64_t(k) & marker_mask);
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        static bool is_marker(const double& x, size_t& k)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            k = size_t(bits & marker_mask);
+            return (bits & ~marker_mask) == marker_bits;
+        }
+
+        template <class Array>
+        static bool is_marker(const tape_inner<Array>& x, size_t& k)
+        {
+            return x.is_scalar() && !x.is_broadcast() && is_marker(x.scalar_value_, k);
+        }
+
+        std::vector<size_t> index_;
+        std::vector<Base> values_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_dynamic_hpp
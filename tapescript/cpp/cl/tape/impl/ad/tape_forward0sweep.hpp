@@ -258,6 +258,17 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
         if (num_par > 0)
             parameter = play->GetPar();
 
+        // groups of elementwise operations which are evaluated at once
+        const cl::tape_fusion<Base>* fusion = cl::tape_fusion_scope<Base>::current();
+
+        // the storage of the Taylor coefficients of dead variables is given
+        // to the next results if the sweep is not followed by reverse
+        const cl::tape_liveness<Base>* forward_only = cl::tape_forward_only_scope<Base>::current();
+
+        // the results of cheap operations are dropped after their last read
+        // and recomputed by the reverse sweep
+        cl::tape_recompute<Base>* recompute = cl::tape_recompute_scope<Base>::current();
+
         // length of the text vector (used by CppAD assert macros)
         const size_t num_text = play->num_text_rec();
 
@@ -307,6 +318,35 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 CPPAD_ASSERT_UNKNOWN(i_op < play->num_op_rec());
             }
 
+            // the group of elementwise operations starting here is evaluated at once
+            if (fusion != CPPAD_NULL)
+            {
+                const typename cl::tape_fusion<Base>::group* group = fusion->starting_at(i_op);
+                if (group != CPPAD_NULL && forward_only != CPPAD_NULL)
+                {
+                    forward_only->forward_acquire(group->first_op_, group->last_op_, 0, J, taylor);
+                }
+                if (group != CPPAD_NULL && fusion->forward(*group, 0, 0, parameter, J, taylor))
+                {
+                    while (i_op < group->last_op_)
+                        play->forward_next(op, arg, i_op, i_var);
+                    if (forward_only != CPPAD_NULL)
+                    {
+                        forward_only->forward_release(group->first_op_, group->last_op_, 0, J, taylor);
+                    }
+                    else if (recompute != CPPAD_NULL)
+                    {
+                        recompute->drop(group->first_op_, group->last_op_, J, taylor);
+                    }
+                    continue;
+                }
+            }
+
+            if (forward_only != CPPAD_NULL)
+            {
+                forward_only->forward_acquire(i_op, i_op, 0, J, taylor);
+            }
+
             // action to take depends on the case
             switch (op)
             {
@@ -872,6 +912,15 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
             default:
                 CPPAD_ASSERT_UNKNOWN(false);
             }
+
+            if (forward_only != CPPAD_NULL)
+            {
+                forward_only->forward_release(i_op, i_op, 0, J, taylor);
+            }
+            else if (recompute != CPPAD_NULL)
+            {
+                recompute->drop(i_op, i_op, J, taylor);
+            }
 # if CPPAD_FORWARD0SWEEP_TRACE
             size_t  d = 0;
             if (user_state == user_trace)
@@ -309,6 +309,20 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
             if (num_par > 0)
                 parameter = play->GetPar();
 
+            // groups of elementwise operations which are evaluated at once,
+            // serialized tape has all operations
+            const cl::tape_fusion<Base>* fusion = cl::tape_fusion_scope<Base>::current();
+            bool fuse = true;
+# if defined CL_TAPE_TRACE_ENABLED
+            if (!cl::is_cout(s_out) && cl::is_io_text<Base>(s_out))
+                fuse = false;
+# endif
+
+            // the storage of the Taylor coefficients of dead variables is given
+            // to the next results if the sweep is not followed by reverse,
+            // serialized tape has all values
+            const cl::tape_liveness<Base>* forward_only = fuse ? cl::tape_forward_only_scope<Base>::current() : CPPAD_NULL;
+
             // length of the text vector (used by CppAD assert macros)
             const size_t num_text = play->num_text_rec();
 
@@ -362,6 +376,31 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                     CPPAD_ASSERT_UNKNOWN(i_op < play->num_op_rec());
                 }
 
+                // the group of elementwise operations starting here is evaluated at once
+                if (fusion != CPPAD_NULL)
+                {
+                    const typename cl::tape_fusion<Base>::group* group = fusion->starting_at(i_op);
+                    if (group != CPPAD_NULL && forward_only != CPPAD_NULL)
+                    {
+                        forward_only->forward_acquire(group->first_op_, group->last_op_, q, J, taylor);
+                    }
+                    if (group != CPPAD_NULL && fusion->forward(*group, p, q, parameter, J, taylor, fuse))
+                    {
+                        while (i_op < group->last_op_)
+                            play->forward_next(op, arg, i_op, i_var);
+                        if (forward_only != CPPAD_NULL)
+                        {
+                            forward_only->forward_release(group->first_op_, group->last_op_, q, J, taylor);
+                        }
+                        continue;
+                    }
+                }
+
+                if (forward_only != CPPAD_NULL)
+                {
+                    forward_only->forward_acquire(i_op, i_op, q, J, taylor);
+                }
+
                 // action depends on the operator
                 switch (op)
                 {
@@ -993,6 +1032,11 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 default:
                     CPPAD_ASSERT_UNKNOWN(0);
                 }
+
+                if (forward_only != CPPAD_NULL)
+                {
+                    forward_only->forward_release(i_op, i_op, q, J, taylor);
+                }
 # if CPPAD_FORWARD1SWEEP_TRACE
                 if (user_state == user_trace)
                 {
@@ -0,0 +1,513 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_fusion_hpp
+#define cl_tape_impl_ad_tape_fusion_hpp
+
+#include <map>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cl/tape/impl/inner/tape_arena.hpp>
+#include <cl/tape/impl/inner/lane_fusion.hpp>
+
+namespace cl
+{
+    /// <summary>Groups of elementwise operations of a recorded tape.
+    /// A group is a run of consecutive Add, Sub, Mul, Div, Exp, Log, Sqrt
+    /// and CondExp operations, the forward and reverse sweeps evaluate
+    /// the whole group by lane_fusion at once. The values which are used
+    /// inside the group only are not stored in the Taylor coefficients,
+    /// they are evaluated again if a sweep runs the operations one by one.</summary>
+    template <class Base>
+    class tape_fusion
+    {
+    public:
+        typedef lane_fusion<Base> kernel;
+
+        // Longest group, the block values of its operations stay in cache.
+        static const size_t max_group_ops = 64;
+
+        struct group
+        {
+            // Operation indices of the first and the last operation.
+            size_t first_op_;
+            size_t last_op_;
+
+            // Variable or parameter index of each input.
+            std::vector<size_t> inputs_;
+            std::vector<bool> input_variables_;
+
+            std::vector<fused_op> ops_;
+
+            // Variable index of each output.
+            std::vector<size_t> outputs_;
+
+            // Recorded operations and their result variables,
+            // they are replayed if the group is not fused.
+            std::vector<CppAD::OpCode> codes_;
+            std::vector<size_t> vars_;
+            std::vector<CppAD::addr_t> args_;
+        };
+
+        // Finds the groups of the operation sequence.
+        // The tape with conditional skips is not fused.
+        tape_fusion(CppAD::player<Base>& play, CppAD::vector<size_t> const& dep_taddr)
+            : num_par_(play.num_par_rec())
+        {
+            size_t num_var = play.num_var_rec();
+            first_.assign(play.num_op_rec(), 0);
+            last_.assign(play.num_op_rec(), 0);
+
+            // variables used by other operations or dependent, and the last
+            // elementwise operation using the variable
+            std::vector<bool> kept(num_var, false);
+            std::vector<size_t> last_use(num_var, 0);
+            for (size_t i = 0; i < dep_taddr.size(); i++)
+            {
+                kept[dep_taddr[i]] = true;
+            }
+
+            std::vector<record> records;
+            CppAD::OpCode op;
+            const CppAD::addr_t* arg;
+            size_t i_op;
+            size_t i_var;
+            play.forward_start(op, arg, i_op, i_var);
+            do
+            {
+                play.forward_next(op, arg, i_op, i_var);
+                record rec;
+                if (decode(op, arg, rec))
+                {
+                    rec.op_ = i_op;
+                    rec.var_ = i_var;
+                    for (size_t k = 0; k < 4; k++)
+                    {
+                        if (rec.variables_[k])
+                        {
+                            last_use[rec.operands_[k]] = i_op;
+                        }
+                    }
+                    records.push_back(rec);
+                }
+                else if (op == CppAD::CSkipOp)
+                {
+                    return;
+                }
+                else if (op == CppAD::CSumOp)
+                {
+                    for (size_t k = 3; k < size_t(3 + arg[0] + arg[1]); k++)
+                    {
+                        kept[arg[k]] = true;
+                    }
+                    play.forward_csum(op, arg, i_op, i_var);
+                }
+                else
+                {
+                    // the arguments which may be variables are kept
+                    for (size_t k = 0; k < CppAD::NumArg(op); k++)
+                    {
+                        if (size_t(arg[k]) < num_var)
+                        {
+                            kept[arg[k]] = true;
+                        }
+                    }
+                }
+            } while (op != CppAD::EndOp);
+
+            // runs of consecutive operations are split by max_group_ops
+            size_t begin = 0;
+            while (begin < records.size())
+            {
+                size_t end = begin + 1;
+                while (end < records.size() && end - begin < max_group_ops
+                    && records[end].op_ == records[end - 1].op_ + 1)
+                {
+                    end++;
+                }
+                add_group(records, begin, end, kept, last_use);
+                begin = end;
+            }
+        }
+
+        // Number of groups.
+        size_t size() const { return groups_.size(); }
+
+        // Group which starts at the operation, null if there is no one.
+        const group* starting_at(size_t i_op) const
+        {
+            return i_op < first_.size() && first_[i_op] ? &groups_[first_[i_op] - 1] : 0;
+        }
+
+        // Group which ends at the operation, null if there is no one.
+        const group* ending_at(size_t i_op) const
+        {
+            return i_op < last_.size() && last_[i_op] ? &groups_[last_[i_op] - 1] : 0;
+        }
+
+        // Evaluates orders p to q of the outputs of the group, returns false
+        // if the group is not fused and the operations have to run one by one.
+        // Zero order sweep and first order sweep are fused if fuse is true,
+        // for the other sweeps the lower orders of the values inside the group
+        // are evaluated.
+        bool forward(const group& g, size_t p, size_t q, const Base* parameter, size_t J, Base* taylor
+            , bool fuse = true) const
+        {
+            std::vector<const Base*>& x = operands(0, g, 0, parameter, J, taylor);
+            size_t n = kernel::lanes(g.ops_, x.data(), x.size());
+            if (n == 0)
+            {
+                // not fused by zero order sweep, all values are stored
+                return false;
+            }
+
+            if (fuse && q == 0)
+            {
+                kernel::forward(g.ops_, n, x.data(), x.size(), results(g, 0, J, taylor).data());
+                return true;
+            }
+
+            if (fuse && p == 1 && q == 1)
+            {
+                std::vector<const Base*>& dx = operands(1, g, 1, parameter, J, taylor);
+                if (kernel::fits(dx.data(), dx.size(), n))
+                {
+                    kernel::tangent(g.ops_, n, x.data(), dx.data(), x.size(), results(g, 1, J, taylor).data());
+                    return true;
+                }
+            }
+
+            if (p > 0)
+            {
+                replay(g, std::min<size_t>(p, 2) - 1, parameter, J, taylor);
+            }
+            return false;
+        }
+
+        // Adds the partials of order d of the inputs of the group, returns false
+        // if the group is not fused and the operations have to run one by one.
+        bool reverse(const group& g, size_t d, const Base* parameter, size_t J
+            , const Base* taylor, size_t K, Base* partial, bool fuse = true) const
+        {
+            std::vector<const Base*>& x = operands(0, g, 0, parameter, J, taylor);
+            size_t n = kernel::lanes(g.ops_, x.data(), x.size());
+            if (n == 0)
+            {
+                return false;
+            }
+
+            if (fuse && d == 0)
+            {
+                std::vector<const Base*>& py = operands(1, g, 0, 0, K, partial, true);
+                std::vector<Base*>& px = partials(g, K, partial);
+                if (kernel::fits(py.data(), py.size(), n) && kernel::fits_partials(px.data(), px.size(), n))
+                {
+                    kernel::reverse(g.ops_, n, x.data(), x.size(), py.data(), px.data());
+                    return true;
+                }
+            }
+
+            // the Taylor coefficients inside the group which the fused sweeps did not store,
+            // the partials are made again for them as before the sweep
+            replay(g, std::min<size_t>(d, 1), parameter, J, const_cast<Base*>(taylor));
+            for (size_t k = 0; k < g.ops_.size(); k++)
+            {
+                if (g.ops_[k].output_ == fused_op::npos)
+                {
+                    for (size_t j = 0; j < K; j++)
+                    {
+                        Base& pz = partial[g.vars_[k] * K + j];
+                        pz = Base(0.);
+                        tapescript::set_intrusive(pz, taylor[g.vars_[k] * J]);
+                        tapescript::arena_acquire(pz, taylor[g.vars_[k] * J]);
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Evaluates zero order of the values inside the fused groups,
+        // it is used before a sweep which does not know about the groups.
+        void restore(const Base* parameter, size_t J, Base* taylor) const
+        {
+            for (size_t i = 0; i < groups_.size(); i++)
+            {
+                const group& g = groups_[i];
+                std::vector<const Base*>& x = operands(0, g, 0, parameter, J, taylor);
+                if (kernel::lanes(g.ops_, x.data(), x.size()) > 0)
+                {
+                    replay(g, 0, parameter, J, taylor);
+                }
+            }
+        }
+
+    private:
+        // Decoded elementwise operation.
+        struct record
+        {
+            CppAD::OpCode code_;
+            size_t op_;
+            size_t var_;
+            CppAD::addr_t args_[6];
+            fused_op fused_;
+            size_t operands_[4];
+            bool variables_[4];
+        };
+
+        // Decodes the operation, returns false if it is not elementwise.
+        static bool decode(CppAD::OpCode op, const CppAD::addr_t* arg, record& rec)
+        {
+            using namespace CppAD;
+            rec.fused_.compare_ = CompareEq;
+            std::fill(rec.args_, rec.args_ + 6, 0);
+            size_t count = 2;
+            unsigned variables = 3;
+            switch (op)
+            {
+            case AddvvOp: rec.fused_.kind_ = fused_op::Add; break;
+            case AddpvOp: rec.fused_.kind_ = fused_op::Add; variables = 2; break;
+            case SubvvOp: rec.fused_.kind_ = fused_op::Sub; break;
+            case SubpvOp: rec.fused_.kind_ = fused_op::Sub; variables = 2; break;
+            case SubvpOp: rec.fused_.kind_ = fused_op::Sub; variables = 1; break;
+            case MulvvOp: rec.fused_.kind_ = fused_op::Mul; break;
+            case MulpvOp: rec.fused_.kind_ = fused_op::Mul; variables = 2; break;
+            case DivvvOp: rec.fused_.kind_ = fused_op::Div; break;
+            case DivpvOp: rec.fused_.kind_ = fused_op::Div; variables = 2; break;
+            case DivvpOp: rec.fused_.kind_ = fused_op::Div; variables = 1; break;
+            case ExpOp: rec.fused_.kind_ = fused_op::Exp; count = 1; variables = 1; break;
+            case LogOp: rec.fused_.kind_ = fused_op::Log; count = 1; variables = 1; break;
+            case SqrtOp: rec.fused_.kind_ = fused_op::Sqrt; count = 1; variables = 1; break;
+            case CExpOp:
+                rec.fused_.kind_ = fused_op::Cond;
+                rec.fused_.compare_ = CompareOp(arg[0]);
+                count = 4;
+                variables = unsigned(arg[1]);
+                break;
+            default:
+                return false;
+            }
+
+            rec.code_ = op;
+            std::copy(arg, arg + NumArg(op), rec.args_);
+            const addr_t* operands = op == CExpOp ? arg + 2 : arg;
+            for (size_t k = 0; k < 4; k++)
+            {
+                // unary operation takes x twice, the second operand is not used
+                size_t j = k < count ? k : 0;
+                rec.operands_[k] = size_t(operands[j]);
+                rec.variables_[k] = ((variables >> j) & 1) != 0;
+            }
+            return true;
+        }
+
+        // Adds the group of records from begin to end if it has
+        // two or more operations and some results are not stored.
+        void add_group(std::vector<record> const& records, size_t begin, size_t end
+            , std::vector<bool> const& kept, std::vector<size_t> const& last_use)
+        {
+            group g;
+            g.first_op_ = records[begin].op_;
+            g.last_op_ = records[end - 1].op_;
+
+            // results of the group are numbered after its inputs
+            std::map<size_t, size_t> results;
+            std::map<size_t, size_t> variables;
+            std::map<size_t, size_t> parameters;
+            for (size_t r = begin; r < end; r++)
+            {
+                results[records[r].var_] = r - begin;
+            }
+            for (size_t r = begin; r < end; r++)
+            {
+                record const& rec = records[r];
+                for (size_t k = 0; k < 4; k++)
+                {
+                    size_t index = rec.operands_[k];
+                    std::map<size_t, size_t>& inputs = rec.variables_[k] ? variables : parameters;
+                    if ((!rec.variables_[k] || !results.count(index)) && !inputs.count(index))
+                    {
+                        inputs[index] = g.inputs_.size();
+                        g.inputs_.push_back(index);
+                        g.input_variables_.push_back(rec.variables_[k]);
+                    }
+                }
+            }
+
+            size_t inside = 0;
+            for (size_t r = begin; r < end; r++)
+            {
+                record const& rec = records[r];
+                fused_op op = rec.fused_;
+                for (size_t k = 0; k < 4; k++)
+                {
+                    size_t index = rec.operands_[k];
+                    op.args_[k] = !rec.variables_[k] ? parameters[index]
+                        : results.count(index) ? g.inputs_.size() + results[index] : variables[index];
+                }
+
+                if (kept[rec.var_] || last_use[rec.var_] > g.last_op_)
+                {
+                    op.output_ = g.outputs_.size();
+                    g.outputs_.push_back(rec.var_);
+                }
+                else
+                {
+                    op.output_ = fused_op::npos;
+                    inside++;
+                }
+
+                g.ops_.push_back(op);
+                g.codes_.push_back(rec.code_);
+                g.vars_.push_back(rec.var_);
+                g.args_.insert(g.args_.end(), rec.args_, rec.args_ + 6);
+            }
+
+            if (g.ops_.size() < 2 || inside == 0)
+            {
+                return;
+            }
+
+            groups_.push_back(g);
+            first_[g.first_op_] = groups_.size();
+            last_[g.last_op_] = groups_.size();
+        }
+
+        // Pointers to the Taylor coefficients of order k of the inputs,
+        // with outputs true the coefficients of the outputs.
+        std::vector<const Base*>& operands(size_t index, const group& g, size_t k
+            , const Base* parameter, size_t J, const Base* taylor, bool outputs = false) const
+        {
+            struct tag;
+            static const Base zero = Base(0.);
+            std::vector<const Base*>& result = thread_instance<std::array<std::vector<const Base*>, 2>, tag>()[index];
+            result.clear();
+            if (outputs)
+            {
+                for (size_t j = 0; j < g.outputs_.size(); j++)
+                {
+                    result.push_back(&taylor[g.outputs_[j] * J + k]);
+                }
+                return result;
+            }
+
+            for (size_t j = 0; j < g.inputs_.size(); j++)
+            {
+                result.push_back(g.input_variables_[j] ? &taylor[g.inputs_[j] * J + k]
+                    : k == 0 ? &parameter[g.inputs_[j]] : &zero);
+            }
+            return result;
+        }
+
+        // Pointers to the Taylor coefficients of order k of the outputs.
+        std::vector<Base*>& results(const group& g, size_t k, size_t J, Base* taylor) const
+        {
+            struct tag;
+            std::vector<Base*>& result = thread_instance<std::vector<Base*>, tag>();
+            result.clear();
+            for (size_t j = 0; j < g.outputs_.size(); j++)
+            {
+                result.push_back(&taylor[g.outputs_[j] * J + k]);
+            }
+            return result;
+        }
+
+        // Pointers to the zero order partials of the inputs, null for parameters.
+        std::vector<Base*>& partials(const group& g, size_t K, Base* partial) const
+        {
+            struct tag;
+            std::vector<Base*>& result = thread_instance<std::vector<Base*>, tag>();
+            result.clear();
+            for (size_t j = 0; j < g.inputs_.size(); j++)
+            {
+                result.push_back(g.input_variables_[j] ? &partial[g.inputs_[j] * K] : 0);
+            }
+            return result;
+        }
+
+        // Evaluates orders zero to q of all operations of the group one by one.
+        void replay(const group& g, size_t q, const Base* parameter, size_t J, Base* taylor) const
+        {
+            using namespace CppAD;
+            for (size_t k = 0; k < g.codes_.size(); k++)
+            {
+                size_t i_z = g.vars_[k];
+                const addr_t* arg = &g.args_[k * 6];
+                switch (g.codes_[k])
+                {
+                case AddvvOp: forward_addvv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case AddpvOp: forward_addpv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case SubvvOp: forward_subvv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case SubpvOp: forward_subpv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case SubvpOp: forward_subvp_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case MulvvOp: forward_mulvv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case MulpvOp: forward_mulpv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case DivvvOp: forward_divvv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case DivpvOp: forward_divpv_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case DivvpOp: forward_divvp_op(0, q, i_z, arg, parameter, J, taylor); break;
+                case ExpOp: forward_exp_op(0, q, i_z, arg[0], J, taylor); break;
+                case LogOp: forward_log_op(0, q, i_z, arg[0], J, taylor); break;
+                case SqrtOp: forward_sqrt_op(0, q, i_z, arg[0], J, taylor); break;
+                case CExpOp: forward_cond_op(0, q, i_z, arg, num_par_, parameter, J, taylor); break;
+                default: break;
+                }
+            }
+        }
+
+        size_t num_par_;
+        std::vector<group> groups_;
+
+        // Group index + 1 by operation index, zero if no group starts or ends there.
+        std::vector<size_t> first_;
+        std::vector<size_t> last_;
+    };
+
+    /// <summary>Makes the fusion current for the calling thread
+    /// while a tape function runs its sweeps.</summary>
+    template <class Base>
+    struct tape_fusion_scope
+    {
+        explicit tape_fusion_scope(const tape_fusion<Base>* fusion)
+            : previous_(current())
+        {
+            current() = fusion;
+        }
+
+        ~tape_fusion_scope()
+        {
+            current() = previous_;
+        }
+
+        // Fusion of the calling thread, null if there is no one.
+        static const tape_fusion<Base>*& current()
+        {
+            static CL_THREAD_LOCAL const tape_fusion<Base>* fusion = 0;
+            return fusion;
+        }
+
+    private:
+        tape_fusion_scope(tape_fusion_scope const&) = delete;
+        tape_fusion_scope& operator=(tape_fusion_scope const&) = delete;
+
+        const tape_fusion<Base>* previous_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_fusion_hpp
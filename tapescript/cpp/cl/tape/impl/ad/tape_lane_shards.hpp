@@ -0,0 +1,309 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_lane_shards_hpp
+#define cl_tape_impl_ad_tape_lane_shards_hpp
+
+#include <memory>
+#include <vector>
+#include <ostream>
+#include <cl/tape/impl/inner/tape_arena.hpp>
+#include <cl/tape/impl/inner/lane_shard.hpp>
+#include <cl/tape/impl/ad/tape_fusion.hpp>
+#include <cl/tape/impl/ad/tape_compare.hpp>
+
+namespace cl
+{
+    /// <summary>Copies of a tape function which run forward and reverse sweeps
+    /// on contiguous shards of the lanes. Each shard has its own Taylor
+    /// coefficients and partials, the atomic functions which mix lanes
+    /// exchange their arguments through lane_shard_scope.
+    /// The shards run concurrently, the count is limited by CPPAD_MAX_NUM_THREADS.
+    /// A function swept by a shard of another function is not sharded,
+    /// the workers of the pool are busy with the shards of the other function.</summary>
+    template <class Base>
+    class tape_lane_shards
+    {
+    public:
+        typedef lane_shard_traits<Base> traits;
+        typedef std::vector<Base> shard_vector;
+
+        explicit tape_lane_shards(size_t count)
+            : count_(std::min<size_t>(count, CPPAD_MAX_NUM_THREADS))
+        {
+            if (count_ > 1 && !setup())
+            {
+                count_ = 1;
+            }
+        }
+
+        // Number of concurrent shards.
+        size_t size() const { return count_; }
+
+        // True if the last zero order forward sweep was sharded,
+        // the sweeps of the function itself are used otherwise.
+        bool active() const { return !offsets_.empty(); }
+
+        // Number of comparisons of the last zero order sweep of the shards
+        // with a result different from the recording.
+        size_t compare_change_number() const
+        {
+            size_t number = 0;
+            for (size_t k = 0; k + 1 < offsets_.size(); k++)
+            {
+                number += functions_[k]->compare_change_number();
+            }
+            return number;
+        }
+
+        // Forward sweep of order q, the shards are chosen by zero order sweep.
+        template <class VectorBase>
+        VectorBase forward(tape_function_base<Base>& f, size_t q, VectorBase const& x, std::ostream& s)
+        {
+            size_t n = f.Domain();
+            bool all_orders = size_t(x.size()) == n * (q + 1);
+            if (all_orders)
+            {
+                split(f, x, n, q + 1);
+            }
+            if (!active())
+            {
+                return f.Forward(q, x, s);
+            }
+
+            size_t count = offsets_.size() - 1;
+            std::vector<shard_vector> xs(count, shard_vector(x.size()));
+            for (size_t j = 0; j < size_t(x.size()); j++)
+            {
+                check_lanes(x[j]);
+                for (size_t k = 0; k < count; k++)
+                {
+                    xs[k][j] = traits::slice(x[j], offsets_[k], offsets_[k + 1]);
+                }
+            }
+
+            std::vector<shard_vector> ys(count);
+            sweep(count, [&](size_t k)
+            {
+                ys[k] = functions_[k]->Forward(q, xs[k], s);
+            });
+
+            size_t m = ys[0].size();
+            if (all_orders)
+            {
+                output_lanes_.assign(f.Range(), false);
+                for (size_t i = 0; i < f.Range(); i++)
+                {
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        output_lanes_[i] = output_lanes_[i] || traits::lane_count(ys[k][i * (q + 1)]) > 0;
+                    }
+                }
+            }
+
+            VectorBase y(m);
+            shard_vector parts(count);
+            for (size_t i = 0; i < m; i++)
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    parts[k] = ys[k][i];
+                }
+                y[i] = traits::join(parts, offsets_);
+            }
+            return y;
+        }
+
+        // Reverse sweep of order q. The weights of outputs without lanes are
+        // given to shard zero only, the partials of inputs without lanes
+        // are summed over shards.
+        template <class VectorBase>
+        VectorBase reverse(size_t q, VectorBase const& w)
+        {
+            size_t count = offsets_.size() - 1;
+            size_t m = output_lanes_.size();
+            size_t per_output = size_t(w.size()) == m ? 1 : q;
+            std::vector<shard_vector> ws(count, shard_vector(w.size()));
+            for (size_t i = 0; i < size_t(w.size()); i++)
+            {
+                check_lanes(w[i]);
+                bool lanes = output_lanes_[i / per_output];
+                for (size_t k = 0; k < count; k++)
+                {
+                    ws[k][i] = lanes ? traits::slice(w[i], offsets_[k], offsets_[k + 1])
+                        : k == 0 ? w[i] : Base(0.);
+                }
+            }
+
+            std::vector<shard_vector> dws(count);
+            sweep(count, [&](size_t k)
+            {
+                tape_arena_scope<Base> arena(arenas_[k]);
+                dws[k] = functions_[k]->Reverse(q, ws[k]);
+            });
+
+            VectorBase dw(dws[0].size());
+            shard_vector parts(count);
+            for (size_t j = 0; j < size_t(dw.size()); j++)
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    parts[k] = dws[k][j];
+                }
+                if (input_lanes_[j / q])
+                {
+                    dw[j] = traits::join(parts, offsets_);
+                }
+                else
+                {
+                    dw[j] = parts[0];
+                    for (size_t k = 1; k < count; k++)
+                    {
+                        dw[j] = dw[j] + parts[k];
+                    }
+                }
+            }
+            return dw;
+        }
+
+    private:
+        // Makes CppAD ready for sweeps in the lane thread pool. The pool is
+        // given to CppAD::thread_alloc once if the application has not made
+        // its own parallel setup, the shards are not run concurrently otherwise.
+        static bool setup()
+        {
+            static bool parallel = CppAD::thread_alloc::num_threads() == 1
+                && (CppAD::thread_alloc::parallel_setup(CPPAD_MAX_NUM_THREADS
+                    , &lane_thread_pool::in_parallel, &lane_thread_pool::thread_num), true);
+            if (parallel)
+            {
+                CppAD::parallel_ad<Base>();
+                CppAD::CheckSimpleVector<Base, shard_vector>();
+            }
+            return parallel;
+        }
+
+        // Splits the lanes of the inputs, the shards are not used
+        // if there are less lanes than shards or the calling thread runs
+        // a shard of another function.
+        template <class VectorBase>
+        void split(tape_function_base<Base>& f, VectorBase const& x, size_t n, size_t orders)
+        {
+            size_t lanes = 0;
+            input_lanes_.assign(n, false);
+            for (size_t j = 0; j < n; j++)
+            {
+                size_t count = traits::lane_count(x[j * orders]);
+                input_lanes_[j] = count > 0;
+                lanes = std::max(lanes, count);
+            }
+
+            offsets_.clear();
+            if (count_ > 1 && lanes >= count_ && !lane_thread_pool::running())
+            {
+                for (size_t k = 0; k <= count_; k++)
+                {
+                    offsets_.push_back(lanes * k / count_);
+                }
+            }
+
+            if (offsets_.empty())
+            {
+                return;
+            }
+
+            // Taylor coefficients are stored by the shards, so the coefficients
+            // of the function itself are freed before it is copied,
+            // the copies are made for the largest number of shards used.
+            f.capacity_order(0);
+            size_t count = offsets_.size() - 1;
+            while (functions_.size() < count)
+            {
+                functions_.emplace_back(new tape_function_base<Base>());
+                *functions_.back() = f;
+            }
+            arenas_.resize(std::max<size_t>(arenas_.size(), count));
+        }
+
+        void check_lanes(Base const& x) const
+        {
+            size_t count = traits::lane_count(x);
+            if (count > 0 && count != offsets_.back())
+            {
+                cl::throw_("Lane count of the argument does not match the lane count of the inputs.");
+            }
+        }
+
+        // Runs body(k) for each shard in the lane thread pool.
+        template <class Body>
+        void sweep(size_t count, Body body)
+        {
+            // the sweep was sharded by a zero order sweep on another thread, the shards
+            // would run serially here and wait for each other in the exchanges
+            if (lane_thread_pool::running())
+            {
+                cl::throw_("Sweep of lane-sharded function is not supported in a shard of another function.");
+            }
+
+            // the copies have the operation sequence of the function, so its fusion
+            // and liveness are used by the workers as well
+            const tape_fusion<Base>* fusion = tape_fusion_scope<Base>::current();
+            const tape_liveness<Base>* liveness = tape_liveness_scope<Base>::current();
+
+            // the comparisons changed in the atomic functions of each shard,
+            // added to the count of the calling thread after the sweep
+            std::vector<size_t> compare_change(count, 0);
+            lane_shard_sweep<Base> shared(offsets_);
+            lane_thread_pool::instance().run(count, [&](size_t k)
+            {
+                lane_shard_scope<Base> scope(shared, k);
+                tape_fusion_scope<Base> fused(fusion);
+                tape_liveness_scope<Base> live(liveness);
+                tape_compare_scope<Base> compare(&compare_change[k]);
+                try
+                {
+                    body(k);
+                }
+                catch (...)
+                {
+                    shared.abort();
+                    throw;
+                }
+                shared.finish();
+            });
+
+            size_t changed = 0;
+            for (size_t k = 0; k < count; k++)
+            {
+                changed += compare_change[k];
+            }
+            tape_compare_scope<Base>::add(changed);
+        }
+
+        size_t count_;
+        std::vector<std::unique_ptr<tape_function_base<Base>>> functions_;
+        std::vector<tape_arena<Base>> arenas_;
+        std::vector<size_t> offsets_;
+        std::vector<bool> input_lanes_;
+        std::vector<bool> output_lanes_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_lane_shards_hpp
@@ -0,0 +1,528 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_liveness_hpp
+#define cl_tape_impl_ad_tape_liveness_hpp
+
+#include <vector>
+#include <cl/tape/impl/inner/tape_arena.hpp>
+#include <cl/tape/impl/detail/thread_local.hpp>
+
+namespace cl
+{
+    /// <summary>Last use of the variables of a recorded tape for the reverse sweep.
+    /// The partial of a variable is written first by the reverse of its last use
+    /// and is not read after the reverse of the operation which makes it.
+    /// The partial takes array storage from the arena just before its first write
+    /// and gives it back after the operation which makes the variable, so the
+    /// storage of the sweep is the partials which are alive at once.
+    /// The arguments of the operations which are not decoded here take new storage.
+    /// If every operation of the tape is decoded or writes no partial, the sweep
+    /// can also start with untouched partials: a partial is made on its first write
+    /// and the operations whose results have untouched partials are skipped.
+    /// For the forward sweeps which are not followed by a reverse sweep the last
+    /// read of each variable is found as well, the Taylor coefficients of the
+    /// variable which is not dependent give their storage to the next results
+    /// after it. This is possible if every variable read of the tape is decoded.</summary>
+    template <class Base>
+    class tape_liveness
+    {
+    public:
+        explicit tape_liveness(CppAD::player<Base>& play
+            , CppAD::vector<size_t> const& dep_taddr = CppAD::vector<size_t>())
+        {
+            size_t num_op = play.num_op_rec();
+            size_t num_var = play.num_var_rec();
+            std::vector<size_t> last_use(num_var, size_t(npos));
+            std::vector<size_t> last_read(num_var, size_t(npos));
+            result_begin_.assign(num_op, 0);
+            result_end_.assign(num_op, 0);
+            use_first_.assign(num_op + 1, 0);
+            skip_.assign(num_op, false);
+            sparse_ = true;
+            forward_ = true;
+
+            CppAD::OpCode op;
+            const CppAD::addr_t* arg;
+            size_t i_op;
+            size_t i_var;
+            play.forward_start(op, arg, i_op, i_var);
+            do
+            {
+                play.forward_next(op, arg, i_op, i_var);
+                use_first_[i_op] = use_vars_.size();
+                bool decoded = uses(op, arg, [&](size_t var)
+                {
+                    last_use[var] = i_op;
+                    use_vars_.push_back(var);
+                });
+                sparse_ = sparse_ && (decoded || silent(op));
+                forward_ = forward_ && reads(op, arg, [&](size_t var) { last_read[var] = i_op; });
+                if (op == CppAD::CSumOp)
+                {
+                    play.forward_csum(op, arg, i_op, i_var);
+                }
+                else if (op == CppAD::CSkipOp)
+                {
+                    play.forward_cskip(op, arg, i_op, i_var);
+                }
+
+                // the variable which is not read is dead after its operation
+                size_t count = CppAD::NumRes(op);
+                for (size_t k = 0; k < count && op != CppAD::BeginOp; k++)
+                {
+                    if (last_read[i_var - k] == npos)
+                    {
+                        last_read[i_var - k] = i_op;
+                    }
+                }
+
+                // the partials of the independent variables are the result of the sweep
+                if (count > 0 && op != CppAD::InvOp && op != CppAD::BeginOp)
+                {
+                    result_begin_[i_op] = i_var + 1 - count;
+                    result_end_[i_op] = i_var + 1;
+                    skip_[i_op] = decoded;
+                }
+            } while (op != CppAD::EndOp);
+            use_first_[num_op] = use_vars_.size();
+
+            // variables by the operation of their last use
+            by_op(last_use, num_op, first_, vars_);
+
+            // the dependent variables are the result of the forward sweep
+            for (size_t i = 0; i < dep_taddr.size(); i++)
+            {
+                last_read[dep_taddr[i]] = npos;
+            }
+            by_op(last_read, num_op, dead_first_, dead_vars_);
+        }
+
+        // Gives storage to the partials first written by the reverse
+        // of the operations from first_op to last_op.
+        void acquire(size_t first_op, size_t last_op
+            , size_t J, const Base* taylor, size_t K, Base* partial) const
+        {
+            for (size_t k = first_[first_op]; k < first_[last_op + 1]; k++)
+            {
+                size_t var = vars_[k];
+                for (size_t j = 0; j < K; j++)
+                {
+                    tapescript::arena_acquire(partial[var * K + j], taylor[var * J]);
+                }
+            }
+        }
+
+        // Takes back the storage of the partials of the results
+        // of the operations from first_op to last_op.
+        void release(size_t first_op, size_t last_op, size_t K, Base* partial) const
+        {
+            for (size_t i = first_op; i <= last_op; i++)
+            {
+                tapescript::arena_release(partial + result_begin_[i] * K, partial + result_end_[i] * K);
+            }
+        }
+
+        // True if the sweep can start with untouched partials.
+        bool sparse() const { return sparse_; }
+
+        // True if the reverse of the operation can be skipped,
+        // the partials of its results are not touched.
+        bool skip(size_t i_op, std::vector<bool> const& touched) const
+        {
+            if (!skip_[i_op])
+            {
+                return false;
+            }
+            for (size_t var = result_begin_[i_op]; var < result_end_[i_op]; var++)
+            {
+                if (touched[var])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Makes the untouched partials of the arguments and the results
+        // of the operations from first_op to last_op before their reverse.
+        // The untouched partial is zero, it is made intrusive and given storage.
+        void touch(size_t first_op, size_t last_op, std::vector<bool>& touched
+            , size_t J, const Base* taylor, size_t K, Base* partial) const
+        {
+            for (size_t k = use_first_[first_op]; k < use_first_[last_op + 1]; k++)
+            {
+                touch(use_vars_[k], touched, J, taylor, K, partial);
+            }
+            for (size_t i = first_op; i <= last_op; i++)
+            {
+                for (size_t var = result_begin_[i]; var < result_end_[i]; var++)
+                {
+                    touch(var, touched, J, taylor, K, partial);
+                }
+            }
+        }
+
+        static void touch(size_t var, std::vector<bool>& touched
+            , size_t J, const Base* taylor, size_t K, Base* partial)
+        {
+            if (touched[var])
+            {
+                return;
+            }
+            touched[var] = true;
+            for (size_t j = 0; j < K; j++)
+            {
+                tapescript::set_intrusive(partial[var * K + j], taylor[var * J]);
+                tapescript::arena_acquire(partial[var * K + j], taylor[var * J]);
+            }
+        }
+
+        // True if the forward sweep can reuse the storage of dead variables.
+        bool forward() const { return forward_; }
+
+        // Gives the Taylor coefficients of orders up to q of the results
+        // of the operations from first_op to last_op the storage for the lane
+        // count of their first array argument, before the forward sweep writes them.
+        void forward_acquire(size_t first_op, size_t last_op, size_t q, size_t J, Base* taylor) const
+        {
+            for (size_t i = first_op; i <= last_op; i++)
+            {
+                for (size_t var = result_begin_[i]; var < result_end_[i]; var++)
+                {
+                    for (size_t k = use_first_[i]; k < use_first_[i + 1]; k++)
+                    {
+                        const Base* model = taylor + use_vars_[k] * J;
+                        if (tapescript::arena_acquire(taylor[var * J], model[0]))
+                        {
+                            for (size_t j = 1; j <= q; j++)
+                            {
+                                tapescript::arena_acquire(taylor[var * J + j], model[j]);
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Takes back the storage of the Taylor coefficients of orders up to q
+        // of the variables which are not read after the operations
+        // from first_op to last_op.
+        void forward_release(size_t first_op, size_t last_op, size_t q, size_t J, Base* taylor) const
+        {
+            for (size_t k = dead_first_[first_op]; k < dead_first_[last_op + 1]; k++)
+            {
+                Base* x = taylor + dead_vars_[k] * J;
+                tapescript::arena_discard(x, x + q + 1);
+            }
+        }
+
+        // Lists the variables by the operation in ops, npos is not listed.
+        static void by_op(std::vector<size_t> const& ops, size_t num_op
+            , std::vector<size_t>& first, std::vector<size_t>& vars)
+        {
+            first.assign(num_op + 1, 0);
+            for (size_t var = 0; var < ops.size(); var++)
+            {
+                if (ops[var] != npos)
+                {
+                    first[ops[var] + 1]++;
+                }
+            }
+            for (size_t i = 0; i < num_op; i++)
+            {
+                first[i + 1] += first[i];
+            }
+            vars.resize(first[num_op]);
+            std::vector<size_t> next(first.begin(), first.end() - 1);
+            for (size_t var = 0; var < ops.size(); var++)
+            {
+                if (ops[var] != npos)
+                {
+                    vars[next[ops[var]]++] = var;
+                }
+            }
+        }
+
+        // Calls f for each variable read by the forward sweep of the operation,
+        // returns false if the operation is not decoded.
+        template <class F>
+        static bool reads(CppAD::OpCode op, const CppAD::addr_t* arg, F f)
+        {
+            using namespace CppAD;
+            if (uses(op, arg, f))
+            {
+                return true;
+            }
+            switch (op)
+            {
+            case EqvvOp:
+            case LtvvOp:
+            case LevvOp:
+            case NevvOp:
+                f(arg[0]);
+                f(arg[1]);
+                break;
+
+            case EqpvOp:
+            case LtpvOp:
+            case LepvOp:
+            case NepvOp:
+            case DisOp:
+                f(arg[1]);
+                break;
+
+            case LtvpOp:
+            case LevpOp:
+            case ErfOp:
+                f(arg[0]);
+                break;
+
+            case PriOp:
+                if (arg[0] & 1)
+                {
+                    f(arg[1]);
+                }
+                if (arg[0] & 2)
+                {
+                    f(arg[3]);
+                }
+                break;
+
+            case BeginOp:
+            case EndOp:
+            case InvOp:
+            case ParOp:
+            case UserOp:
+            case UsrapOp:
+            case UsrrpOp:
+            case UsrrvOp:
+                break;
+
+            default:
+                return false;
+            }
+            return true;
+        }
+
+        // Calls f for each variable argument of the operation
+        // which has a partial written by its reverse,
+        // returns false if the operation is not decoded.
+        template <class F>
+        static bool uses(CppAD::OpCode op, const CppAD::addr_t* arg, F f)
+        {
+            using namespace CppAD;
+            switch (op)
+            {
+            case AddvvOp:
+            case SubvvOp:
+            case MulvvOp:
+            case DivvvOp:
+            case PowvvOp:
+                f(arg[0]);
+                f(arg[1]);
+                break;
+
+            case AddpvOp:
+            case SubpvOp:
+            case MulpvOp:
+            case DivpvOp:
+            case PowpvOp:
+                f(arg[1]);
+                break;
+
+            case SubvpOp:
+            case DivvpOp:
+            case PowvpOp:
+            case AbsOp:
+            case AcosOp:
+            case AsinOp:
+            case AtanOp:
+            case CosOp:
+            case CoshOp:
+            case ExpOp:
+            case LogOp:
+            case SignOp:
+            case SinOp:
+            case SinhOp:
+            case SqrtOp:
+            case TanOp:
+            case TanhOp:
+            case UsravOp:
+                f(arg[0]);
+                break;
+
+            case CExpOp:
+                for (size_t j = 0; j < 4; j++)
+                {
+                    if (arg[1] & (1 << j))
+                    {
+                        f(arg[2 + j]);
+                    }
+                }
+                break;
+
+            case CSumOp:
+                for (size_t j = 3; j < size_t(3 + arg[0] + arg[1]); j++)
+                {
+                    f(arg[j]);
+                }
+                break;
+
+            default:
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static const size_t npos = size_t(-1);
+
+        // True if the reverse of the operation writes no partial.
+        static bool silent(CppAD::OpCode op)
+        {
+            using namespace CppAD;
+            switch (op)
+            {
+            case BeginOp:
+            case EndOp:
+            case InvOp:
+            case ParOp:
+            case DisOp:
+            case PriOp:
+            case CSkipOp:
+            case EqpvOp:
+            case EqvvOp:
+            case LtpvOp:
+            case LtvpOp:
+            case LtvvOp:
+            case LepvOp:
+            case LevpOp:
+            case LevvOp:
+            case NepvOp:
+            case NevvOp:
+            case StppOp:
+            case StpvOp:
+            case StvpOp:
+            case StvvOp:
+            case UserOp:
+            case UsrapOp:
+            case UsrrpOp:
+            case UsrrvOp:
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+        std::vector<size_t> first_;
+        std::vector<size_t> vars_;
+        std::vector<size_t> result_begin_;
+        std::vector<size_t> result_end_;
+        std::vector<size_t> use_first_;
+        std::vector<size_t> use_vars_;
+        std::vector<bool> skip_;
+        bool sparse_;
+        std::vector<size_t> dead_first_;
+        std::vector<size_t> dead_vars_;
+        bool forward_;
+    };
+
+    /// <summary>Makes the liveness current for the calling thread
+    /// while a tape function runs its reverse sweep. The scope keeps
+    /// the partials touched by the sweep, a nested sweep has its own.</summary>
+    template <class Base>
+    struct tape_liveness_scope
+    {
+        explicit tape_liveness_scope(const tape_liveness<Base>* liveness)
+            : liveness_(liveness)
+            , previous_(top())
+        {
+            top() = this;
+        }
+
+        ~tape_liveness_scope()
+        {
+            top() = previous_;
+        }
+
+        // Liveness of the calling thread, null if there is no one.
+        static const tape_liveness<Base>* current()
+        {
+            return top() ? top()->liveness_ : 0;
+        }
+
+        // Touched partials of the sweep on the calling thread,
+        // null if the sweep starts with all partials made.
+        static std::vector<bool>* touched()
+        {
+            tape_liveness_scope* scope = top();
+            return scope && scope->liveness_ && scope->liveness_->sparse() ? &scope->touched_ : 0;
+        }
+
+    private:
+        tape_liveness_scope(tape_liveness_scope const&) = delete;
+        tape_liveness_scope& operator=(tape_liveness_scope const&) = delete;
+
+        static tape_liveness_scope*& top()
+        {
+            static CL_THREAD_LOCAL tape_liveness_scope* scope = 0;
+            return scope;
+        }
+
+        const tape_liveness<Base>* liveness_;
+        tape_liveness_scope* previous_;
+        std::vector<bool> touched_;
+    };
+
+    /// <summary>Makes the liveness current for the calling thread while
+    /// a tape function runs a forward sweep which is not followed by reverse.</summary>
+    template <class Base>
+    struct tape_forward_only_scope
+    {
+        explicit tape_forward_only_scope(const tape_liveness<Base>* liveness)
+            : previous_(current())
+        {
+            current() = liveness && liveness->forward() ? liveness : 0;
+        }
+
+        ~tape_forward_only_scope()
+        {
+            current() = previous_;
+        }
+
+        // Liveness of the forward-only sweep of the calling thread, null if there is no one.
+        static const tape_liveness<Base>*& current()
+        {
+            static CL_THREAD_LOCAL const tape_liveness<Base>* liveness = 0;
+            return liveness;
+        }
+
+    private:
+        tape_forward_only_scope(tape_forward_only_scope const&) = delete;
+        tape_forward_only_scope& operator=(tape_forward_only_scope const&) = delete;
+
+        const tape_liveness<Base>* previous_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_liveness_hpp
@@ -0,0 +1,336 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_optimizer_hpp
+#define cl_tape_impl_ad_tape_optimizer_hpp
+
+#include <vector>
+#include <algorithm>
+
+namespace cl
+{
+    /// <summary>Constant folding of a recorded tape which is run before
+    /// optimize of CppAD. The variables which do not depend on the independent
+    /// variables are found: products with a parameter which is zero in every lane,
+    /// parameters made variables, conditional expressions with the same
+    /// parameter in both branches and operations on such variables.
+    /// Where the using operation has a parameter form, the folded variable
+    /// is replaced by a parameter in place, so its own operation is removed
+    /// as dead code by optimize. The dynamic parameters are not folded.</summary>
+    template <class Base>
+    class tape_optimizer
+    {
+    public:
+        explicit tape_optimizer(CppAD::player<Base>& play
+            , std::vector<size_t> const& dynamic = std::vector<size_t>())
+            : play_(play)
+            , dynamic_(dynamic)
+        {}
+
+        // Folds the operation sequence, returns the number of folded variables.
+        size_t fold()
+        {
+            known_.assign(play_.num_var_rec(), size_t(npos));
+            values_.clear();
+            params_.clear();
+
+            CppAD::OpCode op;
+            const CppAD::addr_t* arg;
+            size_t i_op;
+            size_t i_var;
+            play_.forward_start(op, arg, i_op, i_var);
+            do
+            {
+                play_.forward_next(op, arg, i_op, i_var);
+
+                // the arguments are rewritten in place, op keeps the recorded code
+                // which the player expects on the next call
+                CppAD::addr_t* args = const_cast<CppAD::addr_t*>(arg);
+                switch (op)
+                {
+                case CppAD::AddvvOp:
+                case CppAD::AddpvOp:
+                case CppAD::SubvvOp:
+                case CppAD::SubpvOp:
+                case CppAD::SubvpOp:
+                case CppAD::MulvvOp:
+                case CppAD::MulpvOp:
+                case CppAD::DivvvOp:
+                case CppAD::DivpvOp:
+                case CppAD::DivvpOp:
+                case CppAD::PowvvOp:
+                case CppAD::PowpvOp:
+                case CppAD::PowvpOp:
+                    fold_binary(op, args, i_op, i_var);
+                    break;
+
+                case CppAD::AbsOp:
+                case CppAD::AcosOp:
+                case CppAD::AsinOp:
+                case CppAD::AtanOp:
+                case CppAD::CosOp:
+                case CppAD::CoshOp:
+                case CppAD::ExpOp:
+                case CppAD::LogOp:
+                case CppAD::SignOp:
+                case CppAD::SinOp:
+                case CppAD::SinhOp:
+                case CppAD::SqrtOp:
+                case CppAD::TanOp:
+                case CppAD::TanhOp:
+                    if (known(args[0]))
+                    {
+                        set_known(i_var, unary(op, value(args[0])));
+                    }
+                    break;
+
+                case CppAD::CExpOp:
+                    fold_cond(args, i_var);
+                    break;
+
+                case CppAD::ParOp:
+                    if (std::find(dynamic_.begin(), dynamic_.end(), size_t(args[0])) == dynamic_.end())
+                    {
+                        set_known(i_var, play_.GetPar(args[0]));
+                    }
+                    break;
+
+                case CppAD::UsravOp:
+                    if (known(args[0]))
+                    {
+                        args[0] = parameter(args[0]);
+                        play_.op_rec_[i_op] = CppAD::UsrapOp;
+                    }
+                    break;
+
+                case CppAD::CSumOp:
+                    play_.forward_csum(op, arg, i_op, i_var);
+                    break;
+
+                case CppAD::CSkipOp:
+                    play_.forward_cskip(op, arg, i_op, i_var);
+                    break;
+
+                default:
+                    // other operations keep using the folded variables
+                    break;
+                }
+            } while (op != CppAD::EndOp);
+
+            return values_.size();
+        }
+
+    private:
+        static const size_t npos = size_t(-1);
+
+        enum arithmetic { Add, Sub, Mul, Div, Pow };
+
+        // Folds binary operation, the folded operand is replaced by parameter.
+        void fold_binary(CppAD::OpCode op, CppAD::addr_t* args, size_t i_op, size_t i_var)
+        {
+            arithmetic kind;
+            bool left_var;
+            bool right_var;
+            decode(op, kind, left_var, right_var);
+
+            bool left_known = left_var && known(args[0]);
+            bool right_known = right_var && known(args[1]);
+            if ((!left_var || left_known) && (!right_var || right_known))
+            {
+                set_known(i_var, evaluate(kind, operand(left_var, args[0]), operand(right_var, args[1])));
+                return;
+            }
+
+            if (left_known)
+            {
+                args[0] = parameter(args[0]);
+                left_var = false;
+            }
+            else if (right_known)
+            {
+                args[1] = parameter(args[1]);
+                right_var = false;
+                if (kind == Add || kind == Mul)
+                {
+                    // only the parameter variable form is recorded
+                    std::swap(args[0], args[1]);
+                    std::swap(left_var, right_var);
+                }
+            }
+            if (left_known || right_known)
+            {
+                play_.op_rec_[i_op] = encode(kind, left_var);
+            }
+
+            // product with zero in every lane
+            if (!left_var && (kind == Mul || kind == Div) && zero(play_.GetPar(args[0])))
+            {
+                set_known(i_var, play_.GetPar(args[0]));
+            }
+        }
+
+        // Folds conditional expression, the folded operands are replaced
+        // by parameters unless all of them are folded.
+        void fold_cond(CppAD::addr_t* args, size_t i_var)
+        {
+            CppAD::addr_t flags = args[1];
+            CppAD::addr_t operands[4];
+            for (size_t j = 0; j < 4; j++)
+            {
+                operands[j] = args[2 + j];
+                if ((flags & (1 << j)) && known(operands[j]))
+                {
+                    operands[j] = parameter(operands[j]);
+                    flags &= ~(1 << j);
+                }
+            }
+
+            if (flags == 0)
+            {
+                set_known(i_var, CppAD::CondExpOp(CppAD::CompareOp(args[0])
+                    , play_.GetPar(operands[0]), play_.GetPar(operands[1])
+                    , play_.GetPar(operands[2]), play_.GetPar(operands[3])));
+                return;
+            }
+
+            args[1] = flags;
+            std::copy(operands, operands + 4, args + 2);
+            if (!(flags & 12) && CppAD::IdenticalEqualPar(play_.GetPar(operands[2]), play_.GetPar(operands[3])))
+            {
+                set_known(i_var, play_.GetPar(operands[2]));
+            }
+        }
+
+        static void decode(CppAD::OpCode op, arithmetic& kind, bool& left_var, bool& right_var)
+        {
+            switch (op)
+            {
+            case CppAD::AddvvOp: kind = Add; left_var = true; right_var = true; break;
+            case CppAD::AddpvOp: kind = Add; left_var = false; right_var = true; break;
+            case CppAD::SubvvOp: kind = Sub; left_var = true; right_var = true; break;
+            case CppAD::SubpvOp: kind = Sub; left_var = false; right_var = true; break;
+            case CppAD::SubvpOp: kind = Sub; left_var = true; right_var = false; break;
+            case CppAD::MulvvOp: kind = Mul; left_var = true; right_var = true; break;
+            case CppAD::MulpvOp: kind = Mul; left_var = false; right_var = true; break;
+            case CppAD::DivvvOp: kind = Div; left_var = true; right_var = true; break;
+            case CppAD::DivpvOp: kind = Div; left_var = false; right_var = true; break;
+            case CppAD::DivvpOp: kind = Div; left_var = true; right_var = false; break;
+            case CppAD::PowvvOp: kind = Pow; left_var = true; right_var = true; break;
+            case CppAD::PowpvOp: kind = Pow; left_var = false; right_var = true; break;
+            default: kind = Pow; left_var = true; right_var = false; break;
+            }
+        }
+
+        static CppAD::OpCode encode(arithmetic kind, bool left_var)
+        {
+            switch (kind)
+            {
+            case Add: return CppAD::AddpvOp;
+            case Sub: return left_var ? CppAD::SubvpOp : CppAD::SubpvOp;
+            case Mul: return CppAD::MulpvOp;
+            case Div: return left_var ? CppAD::DivvpOp : CppAD::DivpvOp;
+            default: return left_var ? CppAD::PowvpOp : CppAD::PowpvOp;
+            }
+        }
+
+        static Base evaluate(arithmetic kind, Base const& x, Base const& y)
+        {
+            switch (kind)
+            {
+            case Add: return x + y;
+            case Sub: return x - y;
+            case Mul: return x * y;
+            case Div: return x / y;
+            default: return CppAD::pow(x, y);
+            }
+        }
+
+        static Base unary(CppAD::OpCode op, Base const& x)
+        {
+            switch (op)
+            {
+            case CppAD::AbsOp: return CppAD::abs(x);
+            case CppAD::AcosOp: return CppAD::acos(x);
+            case CppAD::AsinOp: return CppAD::asin(x);
+            case CppAD::AtanOp: return CppAD::atan(x);
+            case CppAD::CosOp: return CppAD::cos(x);
+            case CppAD::CoshOp: return CppAD::cosh(x);
+            case CppAD::ExpOp: return CppAD::exp(x);
+            case CppAD::LogOp: return CppAD::log(x);
+            case CppAD::SignOp: return CppAD::sign(x);
+            case CppAD::SinOp: return CppAD::sin(x);
+            case CppAD::SinhOp: return CppAD::sinh(x);
+            case CppAD::SqrtOp: return CppAD::sqrt(x);
+            case CppAD::TanOp: return CppAD::tan(x);
+            default: return CppAD::tanh(x);
+            }
+        }
+
+        // True if every lane is zero, the value of an intrusive
+        // or an empty array is not known.
+        static bool zero(Base const& x)
+        {
+            return x == 0.;
+        }
+
+        bool known(size_t var) const
+        {
+            return known_[var] != npos;
+        }
+
+        const Base& value(size_t var) const
+        {
+            return values_[known_[var]];
+        }
+
+        const Base& operand(bool variable, size_t index) const
+        {
+            return variable ? value(index) : play_.par_rec_[index];
+        }
+
+        void set_known(size_t var, Base const& x)
+        {
+            known_[var] = values_.size();
+            values_.push_back(x);
+            params_.push_back(size_t(npos));
+        }
+
+        // Parameter index of the folded variable, the parameter
+        // is added once for each variable.
+        CppAD::addr_t parameter(size_t var)
+        {
+            size_t& index = params_[known_[var]];
+            if (index == npos)
+            {
+                index = play_.par_rec_.extend(1);
+                play_.par_rec_[index] = value(var);
+            }
+            return CppAD::addr_t(index);
+        }
+
+        CppAD::player<Base>& play_;
+        std::vector<size_t> dynamic_;
+        std::vector<size_t> known_;
+        std::vector<Base> values_;
+        std::vector<size_t> params_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_optimizer_hpp
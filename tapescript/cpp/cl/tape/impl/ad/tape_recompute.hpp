@@ -0,0 +1,342 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_ad_tape_recompute_hpp
+#define cl_tape_impl_ad_tape_recompute_hpp
+
+#include <new>
+#include <vector>
+#include <cl/tape/impl/ad/tape_liveness.hpp>
+#include <cl/tape/impl/detail/thread_local.hpp>
+
+namespace cl
+{
+    /// <summary>Classes of the operations which the reverse sweep can recompute.</summary>
+    enum tape_recompute_class
+    {
+        recompute_none = 0
+        // sums, differences, products and quotients by a parameter
+        , recompute_linear = 1 << 0
+        // products of two variables
+        , recompute_product = 1 << 1
+        // abs, exp, log, sign and sqrt
+        , recompute_unary = 1 << 2
+        , recompute_all = recompute_linear | recompute_product | recompute_unary
+    };
+
+    /// <summary>Store or recompute policy of a recorded tape. The results
+    /// of the cheap operations of the chosen classes are not stored by the zero
+    /// order forward sweep after their last read if they have at least min_lanes
+    /// lanes, the reverse sweep makes them again from their arguments before the
+    /// first operation which reads them and drops them after the operation which
+    /// makes them. The arguments of such operation are stored, so an operation
+    /// is not recomputed if its argument is recomputed. The values inside the fused
+    /// groups are not stored already, the operations of the groups are not chosen.
+    /// If an operation of the tape reads variables which are not decoded
+    /// all values are stored.</summary>
+    template <class Base>
+    class tape_recompute
+    {
+    public:
+        static const size_t default_min_lanes = 1024;
+
+        tape_recompute(CppAD::player<Base>& play, CppAD::vector<size_t> const& dep_taddr
+            , unsigned classes, size_t min_lanes = default_min_lanes
+            , const tape_fusion<Base>* fusion = 0)
+            : min_lanes_(min_lanes > 0 ? min_lanes : 1)
+        {
+            size_t num_op = play.num_op_rec();
+            size_t num_var = play.num_var_rec();
+            record_.assign(num_var, size_t(npos));
+            released_.assign(num_var, false);
+
+            std::vector<bool> dependent(num_var, false);
+            for (size_t i = 0; i < dep_taddr.size(); i++)
+            {
+                dependent[dep_taddr[i]] = true;
+            }
+
+            // the operations inside the fused groups
+            std::vector<bool> fused(num_op, false);
+            for (size_t i = 0; fusion != 0 && i < num_op; i++)
+            {
+                if (const typename tape_fusion<Base>::group* g = fusion->starting_at(i))
+                {
+                    std::fill(fused.begin() + g->first_op_, fused.begin() + g->last_op_ + 1, true);
+                }
+            }
+
+            // the recomputed variables and the operations which read them
+            std::vector<size_t> last_read(num_var, size_t(npos));
+            std::vector<size_t> read_ops;
+            std::vector<size_t> read_vars;
+            bool decoded = true;
+
+            CppAD::OpCode op;
+            const CppAD::addr_t* arg;
+            size_t i_op;
+            size_t i_var;
+            play.forward_start(op, arg, i_op, i_var);
+            do
+            {
+                play.forward_next(op, arg, i_op, i_var);
+                bool stored = true;
+                decoded = decoded && tape_liveness<Base>::reads(op, arg, [&](size_t var)
+                {
+                    if (record_[var] != npos)
+                    {
+                        last_read[var] = i_op;
+                        read_ops.push_back(i_op);
+                        read_vars.push_back(var);
+                    }
+                    stored = stored && record_[var] == npos;
+                });
+
+                if (stored && !fused[i_op] && !dependent[i_var] && chosen(op, classes))
+                {
+                    // the reverse of the operation can read its result
+                    record_[i_var] = records_.size();
+                    records_.push_back(record(op, arg, i_op));
+                    last_read[i_var] = i_op;
+                    read_ops.push_back(i_op);
+                    read_vars.push_back(i_var);
+                }
+
+                if (op == CppAD::CSumOp)
+                {
+                    play.forward_csum(op, arg, i_op, i_var);
+                }
+                else if (op == CppAD::CSkipOp)
+                {
+                    play.forward_cskip(op, arg, i_op, i_var);
+                }
+            } while (op != CppAD::EndOp);
+
+            if (!decoded)
+            {
+                records_.clear();
+                record_.assign(num_var, size_t(npos));
+                return;
+            }
+
+            tape_liveness<Base>::by_op(last_read, num_op, dead_first_, dead_vars_);
+
+            // the recomputed variables read by each operation
+            read_first_.assign(num_op + 1, 0);
+            for (size_t k = 0; k < read_ops.size(); k++)
+            {
+                read_first_[read_ops[k] + 1]++;
+            }
+            for (size_t i = 0; i < num_op; i++)
+            {
+                read_first_[i + 1] += read_first_[i];
+            }
+            read_vars_ = read_vars;
+        }
+
+        // Number of the operations which are recomputed.
+        size_t size() const { return records_.size(); }
+
+        // Drops the recomputed values which are not read after the operations
+        // from first_op to last_op of the zero order forward sweep.
+        void drop(size_t first_op, size_t last_op, size_t J, Base* taylor)
+        {
+            if (records_.empty())
+            {
+                return;
+            }
+            for (size_t k = dead_first_[first_op]; k < dead_first_[last_op + 1]; k++)
+            {
+                size_t var = dead_vars_[k];
+                if (lanes(taylor[var * J]) >= min_lanes_)
+                {
+                    free(taylor[var * J]);
+                    released_[var] = true;
+                }
+            }
+        }
+
+        // Makes again the dropped values read by the reverse
+        // of the operations from first_op to last_op.
+        void regenerate(size_t first_op, size_t last_op, const Base* parameter, size_t J, Base* taylor)
+        {
+            if (records_.empty())
+            {
+                return;
+            }
+            for (size_t k = read_first_[first_op]; k < read_first_[last_op + 1]; k++)
+            {
+                regenerate(read_vars_[k], parameter, J, taylor);
+            }
+        }
+
+        // Drops the value of the result of the operation after its reverse,
+        // no operation before it reads the value.
+        void drop_result(size_t i_op, size_t i_var, size_t J, Base* taylor)
+        {
+            if (i_var < record_.size() && record_[i_var] != npos && records_[record_[i_var]].op_ == i_op
+                && lanes(taylor[i_var * J]) >= min_lanes_)
+            {
+                free(taylor[i_var * J]);
+                released_[i_var] = true;
+            }
+        }
+
+        // Makes again all dropped values for a sweep which reads them without regeneration.
+        void restore(const Base* parameter, size_t J, Base* taylor)
+        {
+            for (size_t var = 0; var < record_.size(); var++)
+            {
+                regenerate(var, parameter, J, taylor);
+            }
+        }
+
+    private:
+        static const size_t npos = size_t(-1);
+
+        // Operation which makes the recomputed variable.
+        struct record
+        {
+            record(CppAD::OpCode code, const CppAD::addr_t* arg, size_t op)
+                : code_(code)
+                , op_(op)
+            {
+                arg_[0] = arg[0];
+                arg_[1] = CppAD::NumArg(code) > 1 ? arg[1] : 0;
+            }
+
+            CppAD::OpCode code_;
+            size_t op_;
+            CppAD::addr_t arg_[2];
+        };
+
+        static bool chosen(CppAD::OpCode op, unsigned classes)
+        {
+            using namespace CppAD;
+            switch (op)
+            {
+            case AddvvOp:
+            case AddpvOp:
+            case SubvvOp:
+            case SubpvOp:
+            case SubvpOp:
+            case MulpvOp:
+            case DivvpOp:
+                return (classes & recompute_linear) != 0;
+
+            case MulvvOp:
+                return (classes & recompute_product) != 0;
+
+            case AbsOp:
+            case ExpOp:
+            case LogOp:
+            case SignOp:
+            case SqrtOp:
+                return (classes & recompute_unary) != 0;
+
+            default:
+                return false;
+            }
+        }
+
+        void regenerate(size_t var, const Base* parameter, size_t J, Base* taylor)
+        {
+            if (!released_[var])
+            {
+                return;
+            }
+            released_[var] = false;
+
+            const record& r = records_[record_[var]];
+            switch (r.code_)
+            {
+            case CppAD::AddvvOp: CppAD::forward_addvv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::AddpvOp: CppAD::forward_addpv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::SubvvOp: CppAD::forward_subvv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::SubpvOp: CppAD::forward_subpv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::SubvpOp: CppAD::forward_subvp_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::MulpvOp: CppAD::forward_mulpv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::DivvpOp: CppAD::forward_divvp_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::MulvvOp: CppAD::forward_mulvv_op_0(var, r.arg_, parameter, J, taylor); break;
+            case CppAD::AbsOp: CppAD::forward_abs_op_0(var, r.arg_[0], J, taylor); break;
+            case CppAD::ExpOp: CppAD::forward_exp_op_0(var, r.arg_[0], J, taylor); break;
+            case CppAD::LogOp: CppAD::forward_log_op_0(var, r.arg_[0], J, taylor); break;
+            case CppAD::SignOp: CppAD::forward_sign_op_0(var, r.arg_[0], J, taylor); break;
+            default: CppAD::forward_sqrt_op_0(var, r.arg_[0], J, taylor); break;
+            }
+        }
+
+        // Frees the storage of the value.
+        static void free(Base& x)
+        {
+            x.~Base();
+            new (&x) Base();
+        }
+
+        static size_t lanes(const double&) { return 0; }
+
+        template <class Array>
+        static size_t lanes(const tape_inner<Array>& x)
+        {
+            return x.is_array() ? x.size() : 0;
+        }
+
+        size_t min_lanes_;
+        std::vector<record> records_;
+        std::vector<size_t> record_;
+        std::vector<bool> released_;
+        std::vector<size_t> dead_first_;
+        std::vector<size_t> dead_vars_;
+        std::vector<size_t> read_first_;
+        std::vector<size_t> read_vars_;
+    };
+
+    /// <summary>Makes the store or recompute policy current for the calling
+    /// thread while a tape function runs its sweeps.</summary>
+    template <class Base>
+    struct tape_recompute_scope
+    {
+        explicit tape_recompute_scope(tape_recompute<Base>* recompute)
+            : previous_(current())
+        {
+            current() = recompute;
+        }
+
+        ~tape_recompute_scope()
+        {
+            current() = previous_;
+        }
+
+        // Policy of the calling thread, null if there is no one.
+        static tape_recompute<Base>*& current()
+        {
+            static CL_THREAD_LOCAL tape_recompute<Base>* recompute = 0;
+            return recompute;
+        }
+
+    private:
+        tape_recompute_scope(tape_recompute_scope const&) = delete;
+        tape_recompute_scope& operator=(tape_recompute_scope const&) = delete;
+
+        tape_recompute<Base>* previous_;
+    };
+}
+
+#endif // cl_tape_impl_ad_tape_recompute_hpp
@@ -32,6 +32,7 @@ Copyright (C) 2003-15 Bradley M. Bell
 #define cl_tape_impl_ad_tape_reverse_hpp
 
 # include <cl/tape/impl/inner/tape_inner.hpp>
+# include <cl/tape/impl/inner/tape_arena.hpp>
 
 namespace CppAD
 {
@@ -134,13 +135,24 @@ namespace CppAD
             "Reverse mode for Forward(q, r, xq) with more than one direction"
             "\n(r > 1) is not yet supported for q > 1."
             );
-        // initialize entire Partial matrix to zero
-        for (i = 0; i < num_var_tape_; i++)
+        // initialize entire Partial matrix to zero, with liveness of the tape
+        // the partials take storage just before the first write, and if the sweep
+        // starts with untouched partials they are made on the first write
+        const cl::tape_liveness<Base>* liveness = cl::tape_liveness_scope<Base>::current();
+        std::vector<bool>* touched = cl::tape_liveness_scope<Base>::touched();
+        if (touched != CPPAD_NULL)
+            touched->assign(num_var_tape_, false);
+        else
         {
-            for (j = 0; j < q; j++)
+            for (i = 0; i < num_var_tape_; i++)
             {
-                Partial[i * q + j] = zero;
-                cl::tapescript::set_intrusive(Partial[i * q + j], taylor_[i * cap_order_taylor_]);
+                for (j = 0; j < q; j++)
+                {
+                    Partial[i * q + j] = zero;
+                    cl::tapescript::set_intrusive(Partial[i * q + j], taylor_[i * cap_order_taylor_]);
+                    if (liveness == CPPAD_NULL)
+                        cl::tapescript::arena_acquire(Partial[i * q + j], taylor_[i * cap_order_taylor_]);
+                }
             }
         }
 
@@ -149,6 +161,27 @@ namespace CppAD
         for (i = 0; i < m; i++)
         {
             CPPAD_ASSERT_UNKNOWN(dep_taddr_[i] < num_var_tape_);
+            if (touched != CPPAD_NULL)
+            {
+                // the dependent variables with zero weight stay untouched
+                bool seeded = false;
+                if (size_t(w.size()) == m)
+                    seeded = !IdenticalZero(w[i]);
+                else
+                {
+                    for (k = 0; k < q; k++)
+                        seeded = seeded || !IdenticalZero(w[i * q + k]);
+                }
+                if (!seeded)
+                    continue;
+                cl::tape_liveness<Base>::touch(dep_taddr_[i], *touched
+                    , cap_order_taylor_, taylor_.data(), q, Partial.data());
+            }
+            else if (liveness != CPPAD_NULL)
+            {
+                for (k = 0; k < q; k++)
+                    cl::tapescript::arena_acquire(Partial[dep_taddr_[i] * q + k], taylor_[dep_taddr_[i] * cap_order_taylor_]);
+            }
             if (size_t(w.size()) == m)
                 Partial[dep_taddr_[i] * q + q - 1] += w[i];
             else
@@ -210,6 +243,9 @@ namespace CppAD
         {
             cl::tapescript::set_not_intrusive(value[i]);
         }
+
+        // partial storage is kept by the arena for the next call
+        cl::tapescript::arena_release(Partial.data(), Partial.data() + Partial.size());
         return make_result<VectorBaseType>(value).get();
     }
 }
@@ -34,6 +34,8 @@ Copyright (C) 2003-15 Bradley M. Bell
 # ifndef TAPE_REVERSE_SWEEP_INCLUDED
 # define TAPE_REVERSE_SWEEP_INCLUDED
 
+# include <cl/tape/impl/inner/tape_arena.hpp>
+
 namespace CppAD { // BEGIN_CPPAD_NAMESPACE
     /*!
     \file reverse_sweep.hpp
@@ -148,6 +150,8 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
     is defined by
     \f$ u_j^{(k)} \f$ = \a Taylor [ j * J + k ]
     for j = 1 , ... , \a n, and for k = 0 , ... , \a d.
+    The zero order coefficients dropped by the forward sweep
+    are made again in \a Taylor before their first read.
 
     \param K
     Is the number of columns in the partial derivative matrix \a Partial.
@@ -199,7 +203,7 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
         , size_t                      numvar
         , player<Base>*               play
         , size_t                      J
-        , const Base*                 Taylor
+        , Base*                       Taylor
         , size_t                      K
         , Base*                       Partial
         , bool*                       cskip_op
@@ -225,6 +229,28 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
         if (num_par > 0)
             parameter = play->GetPar();
 
+        // groups of elementwise operations which are evaluated at once,
+        // serialized tape has all operations
+        const cl::tape_fusion<Base>* fusion = cl::tape_fusion_scope<Base>::current();
+        bool fuse = true;
+# if defined CL_TAPE_TRACE_ENABLED
+        if (!cl::is_cout(*s_out) && cl::is_io_text<Base>(*s_out))
+            fuse = false;
+# endif
+
+        // partials take array storage before their first write
+        // and give it back after the operation making the variable
+        const cl::tape_liveness<Base>* liveness = cl::tape_liveness_scope<Base>::current();
+
+        // partials which are not touched are made on the first write,
+        // the operations whose results have untouched partials are skipped
+        std::vector<bool>* touched = cl::tape_liveness_scope<Base>::touched();
+
+        // the results of cheap operations dropped by the forward sweep are made
+        // again before their first read and before the partials take storage
+        // for their lane counts
+        cl::tape_recompute<Base>* recompute = cl::tape_recompute_scope<Base>::current();
+
         // work space used by UserOp.
         const size_t user_k = d;    // highest order we are differentiating
         const size_t user_k1 = d + 1;  // number of orders for this calculation
@@ -281,6 +307,76 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 play->reverse_next(op, arg, i_op, i_var);
             }
 
+            // the group of elementwise operations ending here is evaluated at once
+            if (fusion != CPPAD_NULL)
+            {
+                const typename cl::tape_fusion<Base>::group* group = fusion->ending_at(i_op);
+                if (group != CPPAD_NULL && fuse && touched != CPPAD_NULL)
+                {
+                    bool untouched = true;
+                    for (size_t var : group->outputs_)
+                        untouched = untouched && !(*touched)[var];
+                    if (untouched)
+                    {
+                        while (i_op > group->first_op_)
+                            play->reverse_next(op, arg, i_op, i_var);
+                        continue;
+                    }
+                }
+                if (group != CPPAD_NULL && fuse && recompute != CPPAD_NULL)
+                {
+                    recompute->regenerate(group->first_op_, group->last_op_, parameter, J, Taylor);
+                }
+                if (group != CPPAD_NULL && fuse && touched != CPPAD_NULL)
+                {
+                    liveness->touch(group->first_op_, group->last_op_, *touched, J, Taylor, K, Partial);
+                }
+                else if (group != CPPAD_NULL && fuse && liveness != CPPAD_NULL)
+                {
+                    liveness->acquire(group->first_op_, group->last_op_, J, Taylor, K, Partial);
+                }
+                if (group != CPPAD_NULL && fusion->reverse(*group, d, parameter, J, Taylor, K, Partial, fuse))
+                {
+                    while (i_op > group->first_op_)
+                        play->reverse_next(op, arg, i_op, i_var);
+                    if (liveness != CPPAD_NULL)
+                    {
+                        liveness->release(group->first_op_, group->last_op_, K, Partial);
+                    }
+                    continue;
+                }
+            }
+
+            if (touched != CPPAD_NULL)
+            {
+                if (fuse && liveness->skip(i_op, *touched))
+                {
+                    if (op == CSumOp)
+                    {    // CSumOp has a variable number of arguments
+                        play->reverse_csum(op, arg, i_op, i_var);
+                    }
+                    if (recompute != CPPAD_NULL)
+                    {
+                        recompute->drop_result(i_op, i_var, J, Taylor);
+                    }
+                    continue;
+                }
+            }
+
+            if (recompute != CPPAD_NULL)
+            {
+                recompute->regenerate(i_op, i_op, parameter, J, Taylor);
+            }
+
+            if (touched != CPPAD_NULL)
+            {
+                liveness->touch(i_op, i_op, *touched, J, Taylor, K, Partial);
+            }
+            else if (liveness != CPPAD_NULL)
+            {
+                liveness->acquire(i_op, i_op, J, Taylor, K, Partial);
+            }
+
             // rest of informaiton depends on the case
 # if CPPAD_REVERSE_SWEEP_TRACE
             if (op == CSumOp)
@@ -412,8 +508,11 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 // CSkipOp has a variable number of arguments and
                 // forward_next thinks it one has one argument.
                 // we must inform reverse_next of this special case.
-# if ! CPPAD_REVERSE_SWEEP_TRACE && !defined CL_TAPE_TRACE_ENABLED
-                if (cl::is_cout(s_out) || !cl::is_io_text<Base>(s_out))
+# if ! CPPAD_REVERSE_SWEEP_TRACE
+#   if defined CL_TAPE_TRACE_ENABLED
+                // the arguments are corrected above if the tape is serialized
+                if (cl::is_cout(*s_out) || !cl::is_io_text<Base>(*s_out))
+#   endif
                     play->reverse_cskip(op, arg, i_op, i_var);
 # endif
                 break;
@@ -423,8 +522,11 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 // CSumOp has a variable number of arguments and
                 // reverse_next thinks it one has one argument.
                 // We must inform reverse_next of this special case.
-# if ! CPPAD_REVERSE_SWEEP_TRACE && !defined CL_TAPE_TRACE_ENABLED
-                if (cl::is_cout(s_out) || !cl::is_io_text<Base>(s_out))
+# if ! CPPAD_REVERSE_SWEEP_TRACE
+#   if defined CL_TAPE_TRACE_ENABLED
+                // the arguments are corrected above if the tape is serialized
+                if (cl::is_cout(*s_out) || !cl::is_io_text<Base>(*s_out))
+#   endif
                     play->reverse_csum(op, arg, i_op, i_var);
 # endif
                 reverse_csum_op(
@@ -705,11 +807,15 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                         user_ix.resize(user_n);
                     if (user_tx.size() != user_n * user_k1)
                     {
+                        cl::tapescript::arena_release(user_tx.data(), user_tx.data() + user_tx.size());
+                        cl::tapescript::arena_release(user_px.data(), user_px.data() + user_px.size());
                         user_tx.resize(user_n * user_k1);
                         user_px.resize(user_n * user_k1);
                     }
                     if (user_ty.size() != user_m * user_k1)
                     {
+                        cl::tapescript::arena_release(user_ty.data(), user_ty.data() + user_ty.size());
+                        cl::tapescript::arena_release(user_py.data(), user_py.data() + user_py.size());
                         user_ty.resize(user_m * user_k1);
                         user_py.resize(user_m * user_k1);
                     }
@@ -775,7 +881,7 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 --user_j;
                 user_ix[user_j] = arg[0];
                 for (ell = 0; ell < user_k1; ell++)
-                    user_tx[user_j*user_k1 + ell] = Taylor[arg[0] * J + ell];
+                    cl::tapescript::arena_assign(user_tx[user_j*user_k1 + ell], Taylor[arg[0] * J + ell]);
                 if (user_j == 0)
                     user_state = user_start;
                 break;
@@ -804,10 +910,10 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
                 --user_i;
                 for (ell = 0; ell < user_k1; ell++)
                 {
-                    user_py[user_i * user_k1 + ell] =
-                        Partial[i_var * K + ell];
-                    user_ty[user_i * user_k1 + ell] =
-                        Taylor[i_var * J + ell];
+                    cl::tapescript::arena_assign(user_py[user_i * user_k1 + ell],
+                        Partial[i_var * K + ell]);
+                    cl::tapescript::arena_assign(user_ty[user_i * user_k1 + ell],
+                        Taylor[i_var * J + ell]);
                 }
                 if (user_i == 0)
                     user_state = user_arg;
@@ -817,6 +923,15 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
             default:
                 CPPAD_ASSERT_UNKNOWN(false);
             }
+
+            if (liveness != CPPAD_NULL)
+            {
+                liveness->release(i_op, i_op, K, Partial);
+            }
+            if (recompute != CPPAD_NULL)
+            {
+                recompute->drop_result(i_op, i_var, J, Taylor);
+            }
         }
 # if CPPAD_REVERSE_SWEEP_TRACE
         std::cout << std::endl;
@@ -824,6 +939,12 @@ namespace CppAD { // BEGIN_CPPAD_NAMESPACE
         // values corresponding to BeginOp
         CPPAD_ASSERT_UNKNOWN(i_op == 0);
         CPPAD_ASSERT_UNKNOWN(i_var == 0);
+
+        // work space storage is kept by the arena for the next sweep
+        cl::tapescript::arena_release(user_tx.data(), user_tx.data() + user_tx.size());
+        cl::tapescript::arena_release(user_ty.data(), user_ty.data() + user_ty.size());
+        cl::tapescript::arena_release(user_px.data(), user_px.data() + user_px.size());
+        cl::tapescript::arena_release(user_py.data(), user_py.data() + user_py.size());
     }
 
 } // END_CPPAD_NAMESPACE
@@ -23,6 +23,7 @@ limitations under the License.
 
 #include <cl/tape/impl/atomics/dense_atomic.hpp>
 #include <cl/tape/impl/inner/base_tape_inner.hpp>
+#include <cl/tape/impl/inner/lane_shard.hpp>
 
 namespace cl
 {
@@ -35,9 +36,11 @@ namespace cl
 
             static inline inner_type sum_vec(const inner_type& x)
             {
+                if (x.is_broadcast())
+                    return inner_type(x.sum());
                 if (x.is_scalar())
                     return x;
-                return std::accumulate(begin(x.array_value_), end(x.array_value_), 0.0);
+                return std::accumulate(std::begin(x.array_value_), std::end(x.array_value_), 0.0);
             }
 
             struct atomic_sum_vec : dense_atomic<inner_type>
@@ -60,15 +63,26 @@ namespace cl
                     vy = vx;
                     for (size_t i = p; i <= q; i++)
                     {
-                        if (tx[i].is_scalar() && tx[0].is_array())
+                        if (tx[i].is_scalar() && !tx[i].is_broadcast()
+                            && (tx[0].is_array() || tx[0].is_broadcast()))
                         {
-                            ty[i] = tx[i] * tx[0].array_value_.size();
+                            ty[i] = tx[i] * tx[0].size();
                         }
                         else
                         {
                             ty[i] = sum_vec(tx[i]);
                         }
                     }
+
+                    // In lane-sharded sweep the sums of shard lanes are summed over shards.
+                    lane_shard_scope<inner_type>* shard = lane_shard_scope<inner_type>::current();
+                    if (shard && (tx[0].is_array() || tx[0].is_broadcast()))
+                    {
+                        for (size_t i = p; i <= q; i++)
+                        {
+                            ty[i] = shard->sum(ty[i]);
+                        }
+                    }
                     return true;
                 }
 
@@ -79,11 +93,18 @@ namespace cl
                           vector<Base>&       px ,
                     const vector<Base>&       py )
                 {
+                    // In lane-sharded sweep the weight of the sum is summed over shards.
+                    lane_shard_scope<inner_type>* shard = lane_shard_scope<inner_type>::current();
+                    if (!(tx[0].is_array() || tx[0].is_broadcast()))
+                    {
+                        shard = 0;
+                    }
+
                     for (size_t i = 0; i < py.size(); i++)
                     {
                         CL_ASSERT(py[i].is_scalar(), "Sum of vector have to be a scalar."
                             " Check that intrusive scalars work in reverse sweep.");
-                        px[i] = py[i].scalar_value_;
+                        px[i] = shard ? shard->sum(inner_type(py[i].scalar_value_)) : inner_type(py[i].scalar_value_);
                     }
                     return true;
                 }
@@ -124,6 +145,10 @@ namespace cl
 
             static inline size_t size(const inner_type& x)
             {
+                if (x.is_broadcast())
+                {
+                    return x.size();
+                }
                 if (x.is_scalar())
                 {
                     return 1;
@@ -151,7 +176,7 @@ namespace cl
                 {
                     return &(x.scalar_value_);
                 }
-                return std::begin(x.array_value_);
+                return cl::array_data(x.array_value_);
             }
 
             static inline const scalar_type* end(const inner_type& x)
@@ -180,6 +205,7 @@ namespace cl
                     const vector<Base>&      tx ,
                           vector<Base>&      ty )
                 {
+                    check_not_lane_sharded<inner_type>("Concatenation");
                     if( vx.size() > 0 )
                     {
                         vy[0] = std::accumulate(vx.data(), vx.data() + vx.size(), false, std::logical_or<bool>());
@@ -225,12 +251,23 @@ namespace cl
                           vector<Base>&       px ,
                     const vector<Base>&       py )
                 {
+                    check_not_lane_sharded<inner_type>("Concatenation");
                     CL_ASSERT(py.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
                     CL_ASSERT(ty.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
 
                     for (size_t i = 0; i <= q; i++)
                     {
-                        if (py[i].is_scalar())
+                        if (py[i].is_broadcast())
+                        {
+                            // py[i] has lanes, each part gets the lanes of its origin.
+                            for (size_t j = i; j < tx.size(); j += q + 1)
+                            {
+                                auto& origin = tx[j - j % (q + 1)];
+                                px[j] = inner_type::broadcast(py[i].scalar_value_
+                                    , origin.is_array() || origin.is_broadcast() ? origin.size() : 0);
+                            }
+                        }
+                        else if (py[i].is_scalar())
                         {
                             // case1: py[i] represent an array with all coefficients equal,
                             //        so it is cut to representation of arrays with all coefficients equal
@@ -252,7 +289,7 @@ namespace cl
                                 // Zero order taylor coefficient (value)
                                 auto& origin = tx[j - j % (q + 1)];
                                 // Copy from source to px[j] of size and mode of origin.
-                                if (origin.is_scalar())
+                                if (origin.is_scalar() && !origin.is_broadcast())
                                 {
                                     px[j] = *source++;
                                 }
@@ -329,13 +366,19 @@ namespace cl
 
             static inline inner_type sum_vec(const inner_type& x)
             {
+                if (x.is_broadcast())
+                    return inner_type(x.sum());
                 if (x.is_scalar())
                     return x;
-                return std::accumulate(begin(x.array_value_), end(x.array_value_), 0.0);
+                return std::accumulate(std::begin(x.array_value_), std::end(x.array_value_), 0.0);
             }
 
             static inline size_t size(const inner_type& x)
             {
+                if (x.is_broadcast())
+                {
+                    return x.size();
+                }
                 if (x.is_scalar())
                 {
                     return 1;
@@ -343,6 +386,20 @@ namespace cl
                 return x.array_value_.size();
             }
 
+            // In lane-sharded sweep the constructed array has the lanes of the shard.
+            static inline size_t lane_count(size_t count)
+            {
+                if (lane_shard_scope<inner_type>* shard = lane_shard_scope<inner_type>::current())
+                {
+                    if (count != shard->total_lanes())
+                    {
+                        cl::throw_("Size of constructed array have to be equal to the lane count in lane-sharded sweep.");
+                    }
+                    return shard->lanes();
+                }
+                return count;
+            }
+
             struct atomic_make_vec : dense_atomic<inner_type>
             {
                 typedef typename dense_atomic<inner_type>::Base Base;
@@ -372,7 +429,10 @@ namespace cl
                         // array size
                         auto& right = tx[q + 1];
                         CL_ASSERT(left.is_scalar(), "Constructed array have to be filled with scalar value.");
-                        ty[i] = inner_type(left.scalar_value_, CppAD::Integer(right));
+                        // the array is not stored until an elementwise operation needs its lanes
+                        size_t count = lane_count(CppAD::Integer(right));
+                        ty[i] = count > 0 ? inner_type::broadcast(left.scalar_value_, count)
+                            : inner_type(left.scalar_value_, count);
                     }
                     return true;
                 }
@@ -388,11 +448,15 @@ namespace cl
                     CL_ASSERT(ty.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
 
                     // size of the constructed array.
-                    size_t res_size = CppAD::Integer(tx[q + 1]);
+                    size_t res_size = lane_count(CppAD::Integer(tx[q + 1]));
                     for (size_t i = 0; i <= q; i++)
                     {
                         CL_ASSERT(tx[i].is_scalar(), "Constructed array have to be filled with scalar value.");
-                        if (py[i].is_scalar())
+                        if (py[i].is_broadcast())
+                        {
+                            px[i] = inner_type(py[i].sum());
+                        }
+                        else if (py[i].is_scalar())
                         {
                             // py[i] represents an array of size res_size.
                             px[i] = py[i] * res_size;
@@ -458,6 +522,7 @@ namespace cl
                     const vector<Base>&      tx,
                     vector<Base>&      ty)
                 {
+                    check_not_lane_sharded<inner_type>("Unpack");
                     // Size of unpacked array / number of output variables (n);
                     size_t m = tx[0].size();
 
@@ -486,15 +551,17 @@ namespace cl
                     vector<Base>&       px,
                     const vector<Base>&       py)
                 {
+                    check_not_lane_sharded<inner_type>("Unpack");
                     size_t m = tx[0].size();
 
                     for (size_t i = 0; i <= q; i++)
                     {
                         px[i].resize(m);
+                        auto pz = begin(px[i]);
                         for (size_t j = i, k = 0; k < m; j += q + 1, k++)
                         {
                             CL_ASSERT(py[j].is_scalar(), "Unpacked variables have to be scalars. So does its weights.");
-                            px[i].array_value_[k] = py[j].scalar_value_;
+                            pz[k] = py[j].scalar_value_;
                         }
                     }
                     return true;
@@ -554,6 +621,7 @@ namespace cl
                     const vector<Base>&      tx,
                     vector<Base>&      ty)
                 {
+                    check_not_lane_sharded<inner_type>("Pack");
                     CL_ASSERT(ty.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
                     CL_ASSERT(tx.size() % (q + 1) == 0, "Invalid vector size.");
 
@@ -567,10 +635,11 @@ namespace cl
                     for (size_t i = p; i <= q; i++)
                     {
                         ty[i].resize(n);
+                        auto tz = begin(ty[i]);
                         for (size_t j = i, k = 0; j < tx.size(); j += q + 1, k++)
                         {
                             CL_ASSERT(tx[j].is_scalar(), "Packed variables have to be scalars.");
-                            ty[i].array_value_[k] = tx[j].scalar_value_;
+                            tz[k] = tx[j].scalar_value_;
                         }
                     }
                     return true;
@@ -583,6 +652,7 @@ namespace cl
                     vector<Base>&       px,
                     const vector<Base>&       py)
                 {
+                    check_not_lane_sharded<inner_type>("Pack");
                     CL_ASSERT(ty.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
                     CL_ASSERT(py.size() == q + 1, "Invalid vector size. Number of output variables (m) have to be 1.");
                     CL_ASSERT(tx.size() % (q + 1) == 0, "Invalid vector size.");
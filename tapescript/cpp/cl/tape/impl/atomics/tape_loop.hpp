@@ -0,0 +1,414 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_atomics_tape_loop_hpp
+#define cl_tape_impl_atomics_tape_loop_hpp
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cl/tape/impl/atomics/dense_atomic.hpp>
+#include <cl/tape/impl/ad/tape_compare.hpp>
+#include <cl/tape/impl/detail/utils.hpp>
+
+#if defined CL_TAPE_CPPAD
+
+namespace cl
+{
+    /// <summary>Loop of identical bodies which is recorded as one operation.
+    /// The body is recorded once on its own tape, it maps the carried state,
+    /// the loop invariant values and the data of the iteration to the next state.
+    /// The forward sweep runs the body tape count times, the reverse sweep
+    /// checkpoints the carried state of each iteration by forward run and then
+    /// runs the body backwards, so the tape using the loop keeps one operation
+    /// instead of count bodies. The data of the iterations are constants, the
+    /// control flow of the body is the recorded one for all iterations, the
+    /// branches which differ by iteration are recorded by conditional expressions.
+    /// The memory of the reverse sweep is limited by set_checkpoints or
+    /// set_memory_budget, then only some carried states are stored and the
+    /// iterations between them are run again by the binomial schedule.
+    /// A segment of the computation is checkpointed as a loop of count one.
+    /// The loop is made before the recording which uses it is started
+    /// and has to outlive the tapes using it.</summary>
+    template <class Base>
+    class tape_loop : public tapescript::dense_atomic<Base>
+    {
+    public:
+        typedef tape_wrapper<Base> tape_type;
+        typedef std::vector<tape_type> tape_vector;
+        template <class T> using vector = CppAD::vector<T>;
+
+        // Records new_state = body(state, invariant, data) with the given
+        // values, data has count rows or is empty if the body uses no data.
+        template <class Body>
+        tape_loop(std::string const& name, size_t count, Body body
+            , std::vector<Base> const& state, std::vector<Base> const& invariant
+            , std::vector<std::vector<Base>> const& data = std::vector<std::vector<Base>>())
+            : tapescript::dense_atomic<Base>(name)
+            , count_(count)
+            , state_size_(state.size())
+            , invariant_size_(invariant.size())
+            , data_size_(data.empty() ? 0 : data[0].size())
+            , data_(data)
+            , compare_change_(0)
+            , checkpoints_(0)
+            , memory_budget_(0)
+        {
+            if (!data_.empty() && data_.size() != count_)
+            {
+                cl::throw_("Loop data have to have a row for each iteration.");
+            }
+
+            tape_vector x;
+            append(x, state);
+            append(x, invariant);
+            if (!data_.empty())
+            {
+                append(x, data_[0]);
+            }
+            tape_start(x);
+
+            // the recording is aborted if the body or the size check throws,
+            // so the next recording of the thread can start
+            try
+            {
+                tape_vector s(x.begin(), x.begin() + state_size_);
+                tape_vector c(x.begin() + state_size_, x.begin() + state_size_ + invariant_size_);
+                tape_vector d(x.begin() + state_size_ + invariant_size_, x.end());
+                tape_vector y = body(s, c, d);
+                if (y.size() != state_size_)
+                {
+                    cl::throw_("Loop body has to return the state it is given.");
+                }
+                body_.Dependent(x, y);
+            }
+            catch (...)
+            {
+                CppAD::AD<Base>::abort_recording();
+                throw;
+            }
+            body_.optimize();
+        }
+
+        // Records the loop, returns the state after count iterations.
+        tape_vector operator()(tape_vector const& state, tape_vector const& invariant)
+        {
+            if (state.size() != state_size_ || invariant.size() != invariant_size_)
+            {
+                cl::throw_("Loop is called with sizes different from the recording.");
+            }
+
+            vector<CppAD::AD<Base>> ax(state_size_ + invariant_size_);
+            for (size_t j = 0; j < state_size_; j++)
+            {
+                ax[j] = get_ad_value(state[j]);
+            }
+            for (size_t j = 0; j < invariant_size_; j++)
+            {
+                ax[state_size_ + j] = get_ad_value(invariant[j]);
+            }
+
+            vector<CppAD::AD<Base>> ay(state_size_);
+            CppAD::atomic_base<Base>::operator()(ax, ay);
+            return tape_vector(ay.data(), ay.data() + ay.size());
+        }
+
+        // Number of iterations.
+        size_t size() const { return count_; }
+
+        // Number of body operations.
+        size_t size_body() const { return body_.size_op(); }
+
+        // Number of iterations of the last zero order sweep of the loop
+        // in which a comparison of the body has a result different from
+        // the recording, they are added to the count of the calling tape.
+        size_t compare_change() const { return compare_change_; }
+
+        bool forward(
+            size_t                    p ,
+            size_t                    q ,
+            const vector<bool>&      vx ,
+                  vector<bool>&      vy ,
+            const vector<Base>&      tx ,
+                  vector<Base>&      ty )
+        {
+            if (vx.size() > 0)
+            {
+                bool variable = false;
+                for (size_t j = 0; j < vx.size(); j++)
+                {
+                    variable = variable || vx[j];
+                }
+                for (size_t i = 0; i < vy.size(); i++)
+                {
+                    vy[i] = variable;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<Base> xb;
+            std::vector<Base> state(tx.data(), tx.data() + state_size_ * (q + 1));
+            if (p == 0)
+            {
+                compare_change_ = 0;
+            }
+            for (size_t k = 0; k < count_; k++)
+            {
+                input(k, q, state, tx, xb);
+                state = body_.forward(q, xb);
+                if (p == 0 && body_.compare_change() > 0)
+                {
+                    compare_change_++;
+                }
+            }
+            if (p == 0)
+            {
+                tape_compare_scope<Base>::add(compare_change_);
+            }
+
+            for (size_t i = 0; i < state_size_; i++)
+            {
+                for (size_t l = p; l <= q; l++)
+                {
+                    ty[i * (q + 1) + l] = state[i * (q + 1) + l];
+                }
+            }
+            return true;
+        }
+
+        bool reverse(
+            size_t                    q  ,
+            const vector<Base>&       tx ,
+            const vector<Base>&          ,
+                  vector<Base>&       px ,
+            const vector<Base>&       py )
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const size_t orders = q + 1;
+
+            sweep_state sweep(q, tx);
+            sweep.weight.assign(py.data(), py.data() + py.size());
+            sweep.partial.assign(invariant_size_ * orders, Base(0.0));
+
+            std::vector<Base> state(tx.data(), tx.data() + state_size_ * orders);
+            size_t snapshots = checkpoints(state);
+            if (snapshots + 1 >= count_)
+            {
+                // carried state of each iteration
+                std::vector<std::vector<Base>> states(count_);
+                for (size_t k = 0; k < count_; k++)
+                {
+                    states[k] = state;
+                    advance(sweep, k, k + 1, state);
+                }
+                for (size_t k = count_; k-- > 0;)
+                {
+                    step_back(sweep, k, states[k]);
+                }
+            }
+            else
+            {
+                reverse_range(sweep, 0, count_, state, snapshots);
+            }
+
+            for (size_t j = 0; j < sweep.weight.size(); j++)
+            {
+                px[j] = sweep.weight[j];
+            }
+            for (size_t j = 0; j < sweep.partial.size(); j++)
+            {
+                px[state_size_ * orders + j] = sweep.partial[j];
+            }
+            return true;
+        }
+
+        /// limit the carried states stored by the reverse sweep to count,
+        /// the iterations between them are run again by the binomial schedule,
+        /// zero removes the limit
+        void set_checkpoints(size_t count)
+        {
+            checkpoints_ = count;
+        }
+
+        /// limit the memory of the carried states stored by the reverse sweep
+        /// to bytes of values, at least one state is stored, zero removes the limit
+        void set_memory_budget(size_t bytes)
+        {
+            memory_budget_ = bytes;
+        }
+
+    private:
+        // Taylor coefficients of the sweep and the adjoints carried back.
+        struct sweep_state
+        {
+            sweep_state(size_t order, const vector<Base>& coefficients)
+                : q(order)
+                , tx(coefficients)
+            {}
+
+            size_t q;
+            const vector<Base>& tx;
+            std::vector<Base> xb;
+            std::vector<Base> weight;
+            std::vector<Base> partial;
+        };
+
+        // Number of carried states the reverse sweep can store.
+        size_t checkpoints(std::vector<Base> const& state) const
+        {
+            size_t count = checkpoints_ > 0 ? checkpoints_ : count_;
+            if (memory_budget_ > 0)
+            {
+                size_t bytes = 0;
+                for (Base const& x : state)
+                {
+                    bytes += std::max<size_t>(tapescript::simplify_traits<Base>::lanes(x), 1) * sizeof(double);
+                }
+                count = std::min(count, std::max<size_t>(memory_budget_ / std::max<size_t>(bytes, 1), 1));
+            }
+            return count;
+        }
+
+        // Number of iterations which are reversed with snapshots stored states
+        // and each iteration run forward at most repetitions times, C(s + t, s).
+        static double binomial(size_t snapshots, size_t repetitions)
+        {
+            double result = 1;
+            for (size_t t = 1; t <= repetitions; t++)
+            {
+                result = result * double(snapshots + t) / double(t);
+            }
+            return result;
+        }
+
+        // Runs iterations [begin, end) forward from state.
+        void advance(sweep_state& sweep, size_t begin, size_t end, std::vector<Base>& state)
+        {
+            for (size_t k = begin; k < end; k++)
+            {
+                input(k, sweep.q, state, sweep.tx, sweep.xb);
+                state = body_.forward(sweep.q, sweep.xb);
+            }
+        }
+
+        // Reverse sweep of iteration k with the carried state before it.
+        void step_back(sweep_state& sweep, size_t k, std::vector<Base> const& state)
+        {
+            const size_t orders = sweep.q + 1;
+            input(k, sweep.q, state, sweep.tx, sweep.xb);
+            body_.forward(sweep.q, sweep.xb);
+            std::vector<Base> dw = body_.reverse(orders, sweep.weight);
+
+            sweep.weight.assign(dw.begin(), dw.begin() + state_size_ * orders);
+            for (size_t j = 0; j < sweep.partial.size(); j++)
+            {
+                sweep.partial[j] += dw[state_size_ * orders + j];
+            }
+        }
+
+        // Reverses iterations [begin, end) from the state before begin
+        // by the binomial schedule of revolve: the state after m iterations
+        // is stored, the right part is reversed with one snapshot less
+        // and the left part with the snapshot freed.
+        void reverse_range(sweep_state& sweep, size_t begin, size_t end
+            , std::vector<Base> const& state, size_t snapshots)
+        {
+            while (end > begin)
+            {
+                size_t length = end - begin;
+                if (length == 1)
+                {
+                    step_back(sweep, begin, state);
+                    return;
+                }
+                if (snapshots == 0)
+                {
+                    for (size_t k = end; k-- > begin;)
+                    {
+                        std::vector<Base> current(state);
+                        advance(sweep, begin, k, current);
+                        step_back(sweep, k, current);
+                    }
+                    return;
+                }
+
+                size_t repetitions = 1;
+                while (binomial(snapshots, repetitions) < double(length))
+                {
+                    repetitions++;
+                }
+                double right = binomial(snapshots - 1, repetitions);
+                size_t middle = double(length) > right ? size_t(double(length) - right) : 1;
+                middle = std::min(std::max<size_t>(middle, 1), length - 1);
+
+                std::vector<Base> checkpoint(state);
+                advance(sweep, begin, begin + middle, checkpoint);
+                reverse_range(sweep, begin + middle, end, checkpoint, snapshots - 1);
+                end = begin + middle;
+            }
+        }
+
+        static void append(tape_vector& x, std::vector<Base> const& values)
+        {
+            for (Base const& value : values)
+            {
+                x.push_back(tape_type(value));
+            }
+        }
+
+        // Taylor coefficients of the body inputs of iteration k,
+        // the data have zero coefficients of positive orders.
+        void input(size_t k, size_t q, std::vector<Base> const& state
+            , const vector<Base>& tx, std::vector<Base>& xb) const
+        {
+            const size_t orders = q + 1;
+            xb.resize((state_size_ + invariant_size_ + data_size_) * orders);
+            std::copy(state.begin(), state.end(), xb.begin());
+            std::copy(tx.data() + state_size_ * orders, tx.data() + (state_size_ + invariant_size_) * orders
+                , xb.begin() + state_size_ * orders);
+            for (size_t j = 0; j < data_size_; j++)
+            {
+                size_t offset = (state_size_ + invariant_size_ + j) * orders;
+                xb[offset] = data_[k][j];
+                std::fill(xb.begin() + offset + 1, xb.begin() + offset + orders, Base(0.0));
+            }
+        }
+
+        size_t count_;
+        size_t state_size_;
+        size_t invariant_size_;
+        size_t data_size_;
+        std::vector<std::vector<Base>> data_;
+        tape_function<Base> body_;
+        size_t compare_change_;
+        size_t checkpoints_;
+        size_t memory_budget_;
+
+        // the body tape keeps the coefficients of one sweep,
+        // the lane shards run the loop one at a time
+        std::mutex mutex_;
+    };
+}
+
+#endif
+
+#endif // cl_tape_impl_atomics_tape_loop_hpp
@@ -774,12 +774,20 @@ namespace cl
         tape_function()
             : tape_function_base<Base>()
             , serializability()
+            , forward_only_(false)
+            , recompute_classes_(recompute_none)
+            , recompute_lanes_(tape_recompute<Base>::default_min_lanes)
+            , atomic_compare_change_(0)
         { }
 
         template <typename Serializer>
         tape_function(Serializer& serializer)
             : tape_function_base<Base>()
             , serializability()
+            , forward_only_(false)
+            , recompute_classes_(recompute_none)
+            , recompute_lanes_(tape_recompute<Base>::default_min_lanes)
+            , atomic_compare_change_(0)
         {
             serializer & *this;
         }
@@ -790,7 +798,12 @@ namespace cl
                 , Serializer& serializer)
                         : tape_function_base<Base>(tapescript::adapt(x), tapescript::adapt(y))
                         , serializability(tapescript::adapt(x))
+                        , forward_only_(false)
+                        , recompute_classes_(recompute_none)
+                        , recompute_lanes_(tape_recompute<Base>::default_min_lanes)
+                        , atomic_compare_change_(0)
         {
+            attach_dynamic(x);
             serializer & *this;
         }
 
@@ -799,7 +812,16 @@ namespace cl
         tape_function(tapescript::tape_ref_vector const& x, tapescript::tape_ref_vector const& y)
             : tape_function_base<Base>(x.vec_, y.vec_)
             , serializability(x.vec_)
-        { }
+            , forward_only_(false)
+            , recompute_classes_(recompute_none)
+            , recompute_lanes_(tape_recompute<Base>::default_min_lanes)
+            , atomic_compare_change_(0)
+        {
+            if (!x.vec_.empty())
+            {
+                dynamic_.attach(this->play_, tapescript::ad_fields<Base>::tape_id(x.vec_[0]));
+            }
+        }
 
 #       endif
 
@@ -807,12 +829,24 @@ namespace cl
         tape_function(std::vector<cl::tape_wrapper<Inner>> const& x, std::vector<cl::tape_wrapper<Inner>> const& y)
             : tape_function_base<Base>(tapescript::adapt(x), tapescript::adapt(y))
             , serializability(tapescript::adapt(x))
-        { }
+            , forward_only_(false)
+            , recompute_classes_(recompute_none)
+            , recompute_lanes_(tape_recompute<Base>::default_min_lanes)
+            , atomic_compare_change_(0)
+        {
+            attach_dynamic(x);
+        }
 
         template<typename Vector, typename Serializer>
         inline Vector
         reverse(size_t q, Vector const& v, Serializer& s)
         {
+            check_not_sharded("Serialized reverse sweep");
+            check_not_forward_only("Reverse sweep");
+            tape_arena_scope<Base> scope(arena_);
+            tape_fusion_scope<Base> fusion(fusion_.get());
+            tape_liveness_scope<Base> live(liveness());
+            tape_recompute_scope<Base> recompute(recompute_.get());
             return this->Reverse(q, std::make_pair(v, &s)).first;
         }
 
@@ -820,17 +854,157 @@ namespace cl
         inline Vector
         reverse(size_t q, Vector const& v)
         {
+            check_not_forward_only("Reverse sweep");
+            tape_liveness_scope<Base> live(liveness());
+            if (shards_ && shards_->active())
+            {
+                tape_fusion_scope<Base> fusion(fusion_.get());
+                tape_recompute_scope<Base> recompute(CPPAD_NULL);
+                return shards_->reverse(q, v);
+            }
+            tape_arena_scope<Base> scope(arena_);
+            tape_fusion_scope<Base> fusion(fusion_.get());
+            tape_recompute_scope<Base> recompute(recompute_.get());
             return this->Reverse(q, v);
         }
 
-        /// assign a new operation sequence
+        /// storage pool of the reverse mode work objects
+        tape_arena<Base>& arena()
+        {
+            return arena_;
+        }
+
+        /// split lanes of the array values into count contiguous shards,
+        /// forward and reverse sweeps of the shards run concurrently
+        /// in the lane thread pool, count 1 turns the sharding off.
+        /// Concatenation, pack and unpack of arrays are not supported by the shards,
+        /// the shards do not take the recompute policy.
+        /// The first concurrent shards give the pool to CppAD::thread_alloc
+        /// by parallel_setup, if the application has made its own parallel
+        /// setup before, the sharding is off.
+        void set_lane_shards(size_t count)
+        {
+            if (count > 1)
+            {
+                check_not_recomputed("Lane shards");
+            }
+            shards_.reset(count > 1 ? new tape_lane_shards<Base>(count) : 0);
+            if (shards_ && shards_->size() == 1)
+            {
+                shards_.reset();
+            }
+        }
+
+        /// number of lane shards
+        size_t lane_shards() const
+        {
+            return shards_ ? shards_->size() : 1;
+        }
+
+        /// fuse runs of elementwise operations of the tape into groups which
+        /// the forward and reverse sweeps of array values evaluate block by block
+        /// of lanes, the values used inside a group only are not stored,
+        /// false turns the fusion off. The sweeps have to be run by this class.
+        void set_fusion(bool fuse = true)
+        {
+            restore_recompute();
+            fusion_.reset(fuse ? new tape_fusion<Base>(this->play_, this->dep_taddr_) : 0);
+            reset_recompute();
+        }
+
+        /// do not store the results of the cheap operations of the classes
+        /// given by tape_recompute_class after their last read by the zero order
+        /// forward sweep if they have at least min_lanes lanes, the reverse
+        /// sweep makes them again from their stored arguments. It trades
+        /// the memory of the stored values for the operations made twice,
+        /// recompute_none turns the policy off. The sweeps have to be run
+        /// by this class without lane shards.
+        void set_recompute(unsigned classes = recompute_linear
+            , size_t min_lanes = tape_recompute<Base>::default_min_lanes)
+        {
+            if (classes != recompute_none)
+            {
+                check_not_sharded("Recompute policy");
+            }
+            restore_recompute();
+            recompute_classes_ = classes;
+            recompute_lanes_ = min_lanes;
+            reset_recompute();
+        }
+
+        /// number of the operations which are recomputed by the reverse sweep
+        size_t recomputed() const
+        {
+            return recompute_ ? recompute_->size() : 0;
+        }
+
+        /// run the forward sweeps which are not followed by reverse sweep:
+        /// the Taylor coefficients of a variable give their storage to the next
+        /// results after its last read, so only the live values are stored
+        /// and the dependent variables keep their values. Each forward sweep
+        /// starts from zero order, false turns the mode off. The stored Taylor
+        /// coefficients are dropped when the mode changes.
+        /// Base without arrays has no storage to reuse.
+        void set_forward_only(bool forward_only = true)
+        {
+            if (forward_only != forward_only_)
+            {
+                this->capacity_order(0);
+                arena_.clear();
+            }
+            forward_only_ = forward_only;
+        }
+
+        /// true if the forward sweeps are not followed by reverse sweep
+        bool forward_only() const
+        {
+            return forward_only_;
+        }
+
+        /// number of fused groups
+        size_t fused_groups() const
+        {
+            return fusion_ ? fusion_->size() : 0;
+        }
+
+        /// fold the variables which do not depend on the independent variables
+        /// into parameters, then remove the operations not used by the dependent
+        /// variables and merge common subexpressions by optimize of CppAD.
+        /// Conditional skips are not added, the comparison differs by lanes.
+        void optimize()
+        {
+            dynamic_.mark(this->play_);
+            tape_optimizer<Base>(this->play_, dynamic_.indices()).fold();
+            base::optimize("no_conditional_skip");
+            dynamic_.unmark(this->play_);
+            reset_shards();
+        }
+
+        /// number of the dynamic parameters marked by tape_dynamic
+        /// while the operation sequence was recorded
+        size_t size_dynamic() const
+        {
+            return dynamic_.size();
+        }
+
+        /// replace the values of the dynamic parameters, in the order they
+        /// were marked, the next forward sweep uses them without recording again.
+        /// The derivatives with respect to the dynamic parameters are zero.
+        template <typename VectorBase>
+        void new_dynamic(const VectorBase& p)
+        {
+            dynamic_.assign(this->play_, p);
+            reset_shards();
+        }
+
+        /// assign a new operation sequence with its dynamic parameters
         template <typename ADvector>
         void dependent(const ADvector &x, const ADvector &y)
         {
             this->Dependent(x,y);
         }
 
-        /// assign a new operation sequence
+        /// assign a new operation sequence with its dynamic parameters
         template <typename ADvector>
         void tape_read(const ADvector &x, const ADvector &y)
         {
@@ -842,6 +1016,13 @@ namespace cl
         template <typename VectorBase>
         inline VectorBase forward(size_t q, size_t r, const VectorBase& x)
         {
+            check_not_sharded("Multiple direction forward sweep");
+            check_not_forward_only("Multiple direction forward sweep");
+            if (fusion_)
+            {
+                fusion_->restore(this->play_.GetPar(), this->cap_order_taylor_, this->taylor_.data());
+            }
+            restore_recompute();
             return this->Forward(q,r,x);
         }
 
@@ -850,15 +1031,168 @@ namespace cl
         inline VectorBase forward(size_t q,
             const VectorBase& x, std::ostream& s = std::cout)
         {
+            tape_fusion_scope<Base> fusion(fusion_.get());
+
+            // the comparisons changed in the atomic functions are counted by zero order sweeps
+            bool zero_order = size_t(x.size()) == this->Domain() * (q + 1);
+            if (zero_order)
+            {
+                atomic_compare_change_ = 0;
+            }
+            tape_compare_scope<Base> compare(zero_order ? &atomic_compare_change_ : CPPAD_NULL);
+
+            // the sweep of an atomic function called by a forward-only sweep stores all values
+            tape_forward_only_scope<Base> stored(CPPAD_NULL);
+
+            // the dropped values are read by the sweeps of higher orders
+            if (q > 0)
+            {
+                restore_recompute();
+            }
+            tape_recompute_scope<Base> recompute(q == 0 && !shards_ && !forward_only_ ? recompute_.get() : CPPAD_NULL);
+            if (forward_only_)
+            {
+                check_not_sharded("Forward-only sweep");
+                if (!zero_order)
+                {
+                    cl::throw_("Forward-only sweep has to start from zero order.");
+                }
+                VectorBase y;
+                {
+                    tape_arena_scope<Base> scope(arena_);
+                    tape_forward_only_scope<Base> live(liveness());
+                    y = this->Forward(q, x, s);
+                }
+
+                // the storage of the dead values is freed, the next sweep
+                // takes storage for its live values only
+                arena_.clear();
+                return y;
+            }
+            if (shards_)
+            {
+                return shards_->forward(*this, q, x, s);
+            }
             return this->Forward(q,x,s);
         }
 
-        /// Dependent function forward to the adjoint library
+        /// number of comparisons of the last zero order forward sweep with
+        /// a result different from the recording, the lane shards and
+        /// the atomic functions called by the sweep included
+        size_t compare_change() const
+        {
+            if (shards_ && shards_->active())
+            {
+                return shards_->compare_change_number() + atomic_compare_change_;
+            }
+            return this->compare_change_number() + atomic_compare_change_;
+        }
+
+        /// Dependent function forward to the adjoint library,
+        /// the dynamic parameters of the recording are taken
         template <typename Inner>
         void Dependent(std::vector<cl::tape_wrapper<Inner>> const& x, std::vector<cl::tape_wrapper<Inner>> const& y)
         {
             tape_function_base<Base>::Dependent(tapescript::adapt(x), tapescript::adapt(y));
+            attach_dynamic(x);
+            reset_shards();
+        }
+
+    private:
+        /// take the dynamic parameters of the recording of x
+        template <typename Inner>
+        void attach_dynamic(std::vector<cl::tape_wrapper<Inner>> const& x)
+        {
+            if (!x.empty())
+            {
+                dynamic_.attach(this->play_, tapescript::ad_fields<Base>::tape_id(tapescript::cvalue(x[0])));
+            }
+        }
+
+        /// last use of the variables for the reverse sweep and last read for
+        /// the forward-only sweep, it is found once for the operation sequence,
+        /// Base without arrays has no storage to reuse
+        const tape_liveness<Base>* liveness()
+        {
+            if (!liveness_ && !std::is_arithmetic<Base>::value)
+            {
+                liveness_.reset(new tape_liveness<Base>(this->play_, this->dep_taddr_));
+            }
+            return liveness_.get();
+        }
+
+        /// the shards copy the operation sequence and the groups and the last
+        /// uses are found in it, so they are made again
+        void reset_shards()
+        {
+            liveness_.reset();
+            recompute_.reset();
+            if (shards_)
+            {
+                shards_.reset(new tape_lane_shards<Base>(shards_->size()));
+            }
+            if (fusion_)
+            {
+                set_fusion();
+            }
+            else
+            {
+                reset_recompute();
+            }
+        }
+
+        /// the operations to recompute are chosen out of the fused groups,
+        /// Base without arrays stores all values
+        void reset_recompute()
+        {
+            recompute_.reset(recompute_classes_ != recompute_none && !std::is_arithmetic<Base>::value
+                ? new tape_recompute<Base>(this->play_, this->dep_taddr_, recompute_classes_, recompute_lanes_, fusion_.get())
+                : 0);
+        }
+
+        /// make again the values dropped by the last zero order forward sweep
+        void restore_recompute()
+        {
+            if (recompute_ && this->cap_order_taylor_ > 0)
+            {
+                recompute_->restore(this->play_.GetPar(), this->cap_order_taylor_, this->taylor_.data());
+            }
+        }
+
+        void check_not_sharded(const char* name) const
+        {
+            if (shards_)
+            {
+                cl::throw_(std::string(name) + " is not supported with lane shards.");
+            }
+        }
+
+        void check_not_recomputed(const char* name) const
+        {
+            if (recompute_classes_ != recompute_none)
+            {
+                cl::throw_(std::string(name) + " are not supported with the recompute policy.");
+            }
         }
+
+        void check_not_forward_only(const char* name) const
+        {
+            if (forward_only_)
+            {
+                cl::throw_(std::string(name) + " is not supported in forward-only mode.");
+            }
+        }
+
+        tape_arena<Base> arena_;
+        std::unique_ptr<tape_lane_shards<Base>> shards_;
+        std::unique_ptr<tape_fusion<Base>> fusion_;
+        std::unique_ptr<tape_liveness<Base>> liveness_;
+        std::unique_ptr<tape_recompute<Base>> recompute_;
+        dynamic_parameters<Base> dynamic_;
+        bool forward_only_;
+        unsigned recompute_classes_;
+        size_t recompute_lanes_;
+        size_t atomic_compare_change_;
     };
 
     template <typename Inner>
@@ -928,6 +1262,21 @@ namespace cl
         ext::Independent(av);
     }
 
+    /// mark the values of v_tape as dynamic parameters of the recording
+    /// started by tape_start, tape_function::new_dynamic replaces them later
+    template <class Inner>
+    inline void
+    tape_dynamic(std::vector<cl::tape_wrapper<Inner>>& v_tape)
+    {
+        static_assert(cl::is_implemented<cl::compatibl_ad_enabled>::value
+            , "Tapescript must be compiled in this scope.");
+
+        for (cl::tape_wrapper<Inner>& x : v_tape)
+        {
+            dynamic_parameters<Inner>::record(cl::tapescript::value(x));
+        }
+    }
+
     template <typename Type>
     inline void print_type()
     {
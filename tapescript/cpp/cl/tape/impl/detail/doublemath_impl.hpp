@@ -390,7 +390,7 @@ namespace cl
             CL_CHECK(std::pow(v_(x), v_(y))
                 == (cl::tape_wrapper<Base>)CppAD::pow(x.value(), y.value()));
 
-            return CppAD::pow(x.value(), y.value());
+            return cl::tapescript::ad_simplify<Base>::pow(x.value(), y.value());
 #elif CL_TAPE_ADOLC
             cl::throw_("Not implemented"); return x;
 #else
@@ -23,6 +23,7 @@ limitations under the License.
 
 #include <cl/tape/impl/atomics/dense_atomic.hpp>
 #include <cl/tape/impl/inner/base_tape_inner.hpp>
+#include <cl/tape/impl/inner/lane_shard.hpp>
 
 namespace cl
 {
@@ -38,7 +39,7 @@ namespace cl
                 if (x.is_scalar())
                     return x;
                 int n = x.array_value_.size();
-                typename inner_type::array_type temp(n);
+                typename inner_type::array_type temp = inner_type::traits::make(0.0, n);
                 temp[0] = x[0];
                 for (int i = 1; i < n; i++)
                 {
@@ -52,7 +53,7 @@ namespace cl
                 if (x.is_scalar())
                     return x;
                 int n = x.array_value_.size();
-                typename inner_type::array_type temp(n);
+                typename inner_type::array_type temp = inner_type::traits::make(0.0, n);
                 temp[0] = x[0];
                 for (int i = 1; i < n; i++)
                 {
@@ -84,7 +85,7 @@ namespace cl
                 {
                     vy = vx;
                     for (size_t i = p; i <= q; i++)
-                        ty[i] = movingaverage_vec(tx[i], w_);
+                        ty[i] = apply(tx[0], tx[i], &movingaverage_vec);
                     return true;
                 }
 
@@ -96,15 +97,28 @@ namespace cl
                     const vector<Base>&       py)
                 {
 #ifndef NDEBUG
-                    for (size_t i = 0; i < tx.size(); i++)
+                    for (size_t i = 0; i < tx.size() && !lane_shard_scope<inner_type>::current(); i++)
                         assert(ty[i] == movingaverage_vec(tx[i], w_));
 #endif
                     for (size_t i = 0; i < py.size(); i++)
                     {
-                        px[i] = movingaverage_vec_reverse(py[i], w_);
+                        px[i] = apply(tx[0], py[i], &movingaverage_vec_reverse);
                     }
                     return true;
                 }
+
+                // In lane-sharded sweep the lanes are joined from all shards.
+                inner_type apply(const inner_type& value, const inner_type& x
+                    , inner_type (*func)(const inner_type&, double)) const
+                {
+                    lane_shard_scope<inner_type>* shard = lane_shard_scope<inner_type>::current();
+                    if (shard && (value.is_array() || value.is_broadcast()))
+                    {
+                        const double w = w_;
+                        return shard->transform(x, [func, w](const inner_type& y) { return func(y, w); });
+                    }
+                    return func(x, w_);
+                }
             };
 
             CppAD::AD<inner_type> operator()(const CppAD::AD<inner_type>& x, double w)
@@ -23,6 +23,7 @@ limitations under the License.
 
 #include <cl/tape/impl/atomics/dense_atomic.hpp>
 #include <cl/tape/impl/inner/base_tape_inner.hpp>
+#include <cl/tape/impl/inner/lane_shard.hpp>
 
 namespace cl
 {
@@ -37,8 +38,8 @@ namespace cl
             {
                 if (x.is_scalar())
                     return x;
-                typename inner_type::array_type temp(x.array_value_.size());
-                std::reverse_copy(begin(x.array_value_), end(x.array_value_), begin(temp));
+                typename inner_type::array_type temp = inner_type::traits::make(0.0, x.array_value_.size());
+                std::reverse_copy(std::begin(x.array_value_), std::end(x.array_value_), std::begin(temp));
                 return temp;
             }
 
@@ -61,7 +62,7 @@ namespace cl
                 {
                     vy = vx;
                     for (size_t i = p; i <= q; i++)
-                        ty[i] = reverse_vec(tx[i]);
+                        ty[i] = apply(tx[0], tx[i]);
                     return true;
                 }
 
@@ -73,13 +74,22 @@ namespace cl
                     const vector<Base>&       py )
                 {
     #ifndef NDEBUG
-                    for (size_t i = 0; i < tx.size(); i++)
+                    for (size_t i = 0; i < tx.size() && !lane_shard_scope<inner_type>::current(); i++)
                         assert(tx[i] == reverse_vec(ty[i]));
     #endif
                     for (size_t i = 0; i < py.size(); i++)
-                        px[i] = reverse_vec(py[i]);
+                        px[i] = apply(tx[0], py[i]);
                     return true;
                 }
+
+                // In lane-sharded sweep the lanes are joined from all shards.
+                static inner_type apply(const inner_type& value, const inner_type& x)
+                {
+                    lane_shard_scope<inner_type>* shard = lane_shard_scope<inner_type>::current();
+                    if (shard && (value.is_array() || value.is_broadcast()))
+                        return shard->transform(x, &reverse_vec);
+                    return reverse_vec(x);
+                }
             };
 
             CppAD::AD<inner_type> operator()(const CppAD::AD<inner_type>& x)
@@ -78,7 +78,8 @@ limitations under the License.
             rtype                                                                                    \
             op_3(tape_wrapper<Base> const &this_, tape_wrapper<Base> const& r)                       \
             {                                                                                        \
-                return this_.tdouble_() OPERATOR r.tdouble_();                                       \
+                return cl::tapescript::ad_simplify<Base>(this_.tdouble_())                           \
+                    OPERATOR cl::tapescript::ad_simplify<Base>(r.tdouble_());                        \
             }                                                                                        \
         };                                                                                           \
                                                                                                      \
@@ -287,13 +288,14 @@ namespace cl
             typename tape_wrapper<Base>::tape_type
             op_2(tape_wrapper<Base> const &this_, tape_wrapper<Base> const& r)
             {
-                return this_.tdouble_() OPERATOR r.double_();
+                return cl::tapescript::ad_simplify<Base>::div(this_.tdouble_()
+                    , typename tape_wrapper<Base>::tdouble_type(r.double_()));
             }
 
             typename tape_wrapper<Base>::tape_type
             op_3(tape_wrapper<Base> const &this_, tape_wrapper<Base> const& r)
             {
-                return this_.tdouble_() OPERATOR r.tdouble_();
+                return cl::tapescript::ad_simplify<Base>::div(this_.tdouble_(), r.tdouble_());
             }
         };
 
@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_detail_thread_local_hpp
+#define cl_tape_impl_detail_thread_local_hpp
+
+// Thread storage of pointers and integers. Visual C++ 2013 has no thread_local,
+// its __declspec(thread) takes constant initialized POD variables only.
+#if defined _MSC_VER && _MSC_VER < 1900
+#   define CL_THREAD_LOCAL __declspec(thread)
+#else
+#   define CL_THREAD_LOCAL thread_local
+#endif
+
+namespace cl
+{
+    /// <summary>Object of the calling thread made by the default constructor
+    /// on the first call of the thread, one for each Tag. With __declspec(thread)
+    /// the object is made on the heap and is not destroyed at the thread exit.</summary>
+    template <class T, class Tag = T>
+    inline T& thread_instance()
+    {
+#if defined _MSC_VER && _MSC_VER < 1900
+        static __declspec(thread) T* instance = 0;
+        if (instance == 0)
+        {
+            instance = new T();
+        }
+        return *instance;
+#else
+        static thread_local T instance;
+        return instance;
+#endif
+    }
+}
+
+#endif // cl_tape_impl_detail_thread_local_hpp
@@ -22,6 +22,7 @@ limitations under the License.
 #define cl_tape_impl_doubleoperators_hpp
 
 //#include <cl/tape/impl/double.hpp>
+#include <cmath>
 #include <cl/tape/impl/tape_fwd.hpp>
 
 #if !defined(CL_NO_BOOST_NUMERIC)
@@ -69,6 +70,216 @@ namespace cl
     inline std::istream& operator>>(std::istream& input, cl::tape_wrapper<Base>& v) { input >> cl::tapescript::value(v); return input; }
 }
 
+//!! Record time simplification of tape_wrapper operations
+namespace cl
+{
+    namespace tapescript
+    {
+        /// <summary>Lanes of the values of Base used by ad_simplify,
+        /// the values of other types are not simplified.</summary>
+        template <class Base>
+        struct simplify_traits
+        {
+            // Number of lanes, zero for a scalar.
+            static size_t lanes(const Base&) { return 0; }
+
+            // True if every lane of x has the same value.
+            static bool uniform(const Base&, double&) { return false; }
+
+            // True if every lane of x is finite.
+            static bool finite(const Base&) { return false; }
+        };
+
+        template <>
+        struct simplify_traits<double>
+        {
+            static size_t lanes(const double&) { return 0; }
+
+            static bool uniform(const double& x, double& value)
+            {
+                value = x;
+                return true;
+            }
+
+            static bool finite(const double& x) { return x - x == 0.; }
+        };
+
+        /// <summary>Fields of CppAD::AD which are protected in this library.</summary>
+        template <class Base>
+        struct ad_fields : CppAD::AD<Base>
+        {
+            // Variable of the tape with the given address.
+            ad_fields(const Base& value, size_t tape_id, size_t taddr)
+            {
+                this->value_ = value;
+                this->tape_id_ = CppAD::tape_id_t(tape_id);
+                this->taddr_ = CppAD::addr_t(taddr);
+            }
+
+            static const Base& value(const CppAD::AD<Base>& x) { return x.*(&ad_fields::value_); }
+
+            static size_t tape_id(const CppAD::AD<Base>& x) { return size_t(x.*(&ad_fields::tape_id_)); }
+
+            // Tape of the recording on this thread, null if there is no recording.
+            static CppAD::ADTape<Base>* tape() { return ad_fields::tape_ptr(); }
+        };
+
+        /// <summary>Simplifies the operations of tape_wrapper before they are recorded.
+        /// The operations with a parameter which is 0 or 1 in every lane are not
+        /// recorded if the result has the lanes of the variable, division by a power
+        /// of two is recorded as exact multiplication by its reciprocal and pow with
+        /// a small integer exponent as repeated multiplication. The rewrites look
+        /// at the operands only, so the recorded tape gives the same values for
+        /// all inputs. The operands are wrapped to use the operators of this class.</summary>
+        template <class Base>
+        class ad_simplify
+        {
+        public:
+            typedef CppAD::AD<Base> ad_type;
+            typedef simplify_traits<Base> traits;
+            typedef ad_fields<Base> fields;
+
+            // Largest exponent of pow recorded as multiplication.
+            static const int max_exponent = 16;
+
+            explicit ad_simplify(const ad_type& x)
+                : x_(x)
+            {}
+
+            friend ad_type operator+(const ad_simplify& x, const ad_simplify& y) { return add(x.x_, y.x_); }
+            friend ad_type operator-(const ad_simplify& x, const ad_simplify& y) { return sub(x.x_, y.x_); }
+            friend ad_type operator*(const ad_simplify& x, const ad_simplify& y) { return mul(x.x_, y.x_); }
+            friend ad_type operator/(const ad_simplify& x, const ad_simplify& y) { return div(x.x_, y.x_); }
+
+            friend bool operator==(const ad_simplify& x, const ad_simplify& y) { return x.x_ == y.x_; }
+            friend bool operator!=(const ad_simplify& x, const ad_simplify& y) { return x.x_ != y.x_; }
+            friend bool operator>=(const ad_simplify& x, const ad_simplify& y) { return x.x_ >= y.x_; }
+            friend bool operator<=(const ad_simplify& x, const ad_simplify& y) { return x.x_ <= y.x_; }
+            friend bool operator>(const ad_simplify& x, const ad_simplify& y) { return x.x_ > y.x_; }
+            friend bool operator<(const ad_simplify& x, const ad_simplify& y) { return x.x_ < y.x_; }
+
+            static ad_type add(const ad_type& x, const ad_type& y)
+            {
+                double c;
+                if (constant(y, x, c) && c == 0. && covers(x, y))
+                {
+                    return x;
+                }
+                if (constant(x, y, c) && c == 0. && covers(y, x))
+                {
+                    return y;
+                }
+                return x + y;
+            }
+
+            static ad_type sub(const ad_type& x, const ad_type& y)
+            {
+                double c;
+                if (constant(y, x, c) && c == 0. && covers(x, y))
+                {
+                    return x;
+                }
+                return x - y;
+            }
+
+            static ad_type mul(const ad_type& x, const ad_type& y)
+            {
+                double c;
+                if (constant(y, x, c))
+                {
+                    if (c == 1. && covers(x, y))
+                    {
+                        return x;
+                    }
+                    if (c == 0. && covers(y, x))
+                    {
+                        return y;
+                    }
+                }
+                if (constant(x, y, c))
+                {
+                    if (c == 1. && covers(y, x))
+                    {
+                        return y;
+                    }
+                    if (c == 0. && covers(x, y))
+                    {
+                        return x;
+                    }
+                }
+                return x * y;
+            }
+
+            static ad_type div(const ad_type& x, const ad_type& y)
+            {
+                double c;
+                if (constant(y, x, c))
+                {
+                    if (c == 1. && covers(x, y))
+                    {
+                        return x;
+                    }
+
+                    // the reciprocal of a power of two is exact
+                    int exponent;
+                    if (c != 0. && std::abs(std::frexp(c, &exponent)) == 0.5 && traits::finite(1. / c))
+                    {
+                        return x * ad_type(Base(1.) / fields::value(y));
+                    }
+                }
+                return x / y;
+            }
+
+            static ad_type pow(const ad_type& x, const ad_type& y)
+            {
+                double c;
+                if (constant(y, x, c) && covers(x, y)
+                    && c == std::floor(c) && c != 0. && std::abs(c) <= max_exponent)
+                {
+                    // binary powering, the result has the lanes of x
+                    unsigned int n = static_cast<unsigned int>(std::abs(c));
+                    ad_type power = x;
+                    ad_type result;
+                    bool first = true;
+                    for (;;)
+                    {
+                        if ((n & 1) != 0)
+                        {
+                            result = first ? power : result * power;
+                            first = false;
+                        }
+                        if ((n >>= 1) == 0)
+                        {
+                            break;
+                        }
+                        power = power * power;
+                    }
+                    return c < 0 ? ad_type(Base(1.)) / result : result;
+                }
+                return CppAD::pow(x, y);
+            }
+
+        private:
+            // True if p is parameter with the same value c in every lane
+            // and x is variable.
+            static bool constant(const ad_type& p, const ad_type& x, double& c)
+            {
+                return CppAD::Parameter(p) && CppAD::Variable(x)
+                    && traits::uniform(fields::value(p), c);
+            }
+
+            // True if the result of an operation on x and y has the lanes of x.
+            static bool covers(const ad_type& x, const ad_type& y)
+            {
+                size_t lanes = traits::lanes(fields::value(y));
+                return lanes == 0 || lanes == traits::lanes(fields::value(x));
+            }
+
+            const ad_type& x_;
+        };
+    }
+}
+
 //!! Supporting code for double operators, in progress
 namespace cl_ext
 {
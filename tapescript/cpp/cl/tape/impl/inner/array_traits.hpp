@@ -29,7 +29,14 @@ limitations under the License.
 #   include <Eigen/Dense>
 #endif
 
+#if defined CL_SIMD_MATH_ENABLED
+#   include <cl/tape/impl/inner/simd_math.hpp>
+#endif
+
 #include <cl/tape/impl/tape_fwd.hpp>
+#include <cl/tape/impl/inner/small_array.hpp>
+#include <cl/tape/impl/inner/shared_array.hpp>
+#include <cl/tape/impl/inner/fixed_array.hpp>
 
 namespace cl
 {
@@ -38,10 +45,32 @@ namespace cl
     typedef tape_inner<Eigen::ArrayXd> tape_valueXd;
 #endif
 
+    typedef tape_inner<small_array<double>> tape_valueSmall;
+    typedef tape_inner<shared_array<double>> tape_valueShared;
+
+    // Lane count is a compile time constant, the lanes are stored inline.
+    template <size_t N>
+    using tape_valueFixed = tape_inner<std::array<double, N>>;
+
     /// <summary>Traits of array type for using it as tape_inner template parameter.</summary>
     template <class Array>
     struct array_traits;
 
+    // Returns the elements of the array for writing, the kernels take
+    // the pointer once before the loop over the lanes.
+    template <class Array>
+    inline typename Array::value_type* array_data(Array& x)
+    {
+        return x.size() > 0 ? &x[0] : nullptr;
+    }
+
+    // The payload of shared_array is copied here if it is shared.
+    template <class Scalar>
+    inline Scalar* array_data(shared_array<Scalar>& x)
+    {
+        return x.mutable_data();
+    }
+
 #define CL_INNER_ARRAY_FUNCTION_TRAITS(Qualifier, Name)     \
     static inline array_type Name(const array_type& x)      \
     {                                                       \
@@ -53,6 +82,24 @@ namespace cl
     {                                                                       \
         cl::throw_("The function " #Name " is not implemented for " Array); \
         return x;                                                           \
+    }                                                                       \
+                                                                            \
+    static inline void Name(array_type& result, const array_type& x)        \
+    {                                                                       \
+        cl::throw_("The function " #Name " is not implemented for " Array); \
+    }
+
+    // Writes the function value to result, storage of result is reused
+    // if its size is not changed.
+#define CL_INNER_ARRAY_FUNCTION_TO_TRAITS(Qualifier, Name)                  \
+    static inline void Name(array_type& result, const array_type& x)        \
+    {                                                                       \
+        resize(result, x.size());                                           \
+        scalar_type* z = array_data(result);                                \
+        for (size_type i = 0; i < x.size(); i++)                            \
+        {                                                                   \
+            z[i] = Qualifier Name(x[i]);                                    \
+        }                                                                   \
     }
 
     /// <summary>Array traits of std::valaray.</summary>
@@ -73,6 +120,15 @@ namespace cl
             return std::valarray<scalar_type>(ptr, count);
         }
 
+        // Resizes the array, storage is kept if the size is not changed.
+        static inline void resize(array_type& x, size_t count)
+        {
+            if (x.size() != count)
+            {
+                x.resize(count);
+            }
+        }
+
         template <class Ty1, class Ty2>
         static inline bool operator_Ne(Ty1&& x, Ty2&& y)
         {
@@ -111,6 +167,20 @@ namespace cl
         CL_INNER_ARRAY_FUNCTION_TRAITS(std::, tan)
         CL_INNER_ARRAY_FUNCTION_TRAITS(std::, tanh)
 
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, abs)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, acos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sqrt)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, asin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, atan)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, cos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, cosh)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sinh)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, exp)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, log)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, tan)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, tanh)
+
         static inline array_type sign(const array_type& x)
         {
             auto sign_func = [](const scalar_type& v)
@@ -125,6 +195,16 @@ namespace cl
             return x.apply(sign_func);
         }
 
+        static inline void sign(array_type& result, const array_type& x)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = x[i] > 0. ? scalar_type(1.0)
+                    : (x[i] == 0. ? scalar_type(0.0) : scalar_type(-1.0));
+            }
+        }
 
         template <class Ty1, class Ty2>
         static inline array_type pow(const Ty1& x, const Ty2& y)
@@ -132,6 +212,36 @@ namespace cl
             return std::pow(x, y);
         }
 
+        static inline void pow(array_type& result, const array_type& x, const scalar_type& y)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = std::pow(x[i], y);
+            }
+        }
+
+        static inline void pow(array_type& result, const scalar_type& x, const array_type& y)
+        {
+            resize(result, y.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < y.size(); i++)
+            {
+                z[i] = std::pow(x, y[i]);
+            }
+        }
+
+        static inline void pow(array_type& result, const array_type& x, const array_type& y)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = std::pow(x[i], y[i]);
+            }
+        }
+
     private:
         static inline bool all_true(std::valarray<bool> const& val)
         {
@@ -166,6 +276,12 @@ namespace cl
             return array_type(Eigen::Map<const array_type>(il.begin(), il.size()));
         }
 
+        // Resizes the array, Eigen keeps storage if the size is not changed.
+        static inline void resize(array_type& x, size_t count)
+        {
+            x.resize(count);
+        }
+
         template <class Ty1, class Ty2>
         static inline bool operator_Ne(Ty1&& x, Ty2&& y)
         {
@@ -200,6 +316,16 @@ namespace cl
         CL_INNER_ARRAY_FUNCTION_TRAITS(Eigen::, log)
         CL_INNER_ARRAY_FUNCTION_TRAITS(Eigen::, tan)
 
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, abs)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, acos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sqrt)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, asin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, cos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, exp)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, log)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, tan)
+
         CL_INNER_ARRAY_FUNCTION_NOT_DEF("Eigen::Array", atan)
         CL_INNER_ARRAY_FUNCTION_NOT_DEF("Eigen::Array", cosh)
         CL_INNER_ARRAY_FUNCTION_NOT_DEF("Eigen::Array", sinh)
@@ -215,8 +341,376 @@ namespace cl
         {
             return Eigen::exp(std::log(x) * y);
         }
+
+        template <class Ty>
+        static inline void pow(array_type& result, const array_type& x, const Ty& y)
+        {
+            result = Eigen::pow(x, y);
+        }
+
+        static inline void pow(array_type& result, const scalar_type& x, const array_type& y)
+        {
+            result = Eigen::exp(std::log(x) * y);
+        }
+
+        static inline void sign(array_type& result, const array_type& x)
+        {
+            result = x.sign();
+        }
     };
 #endif // CL_EIGEN_ENABLED
+
+    /// <summary>Array traits of the arrays which have size, operator[],
+    /// resize and the valarray constructors or fixed size, the functions
+    /// are evaluated elementwise.</summary>
+    template <class Array>
+    struct sequence_array_traits
+    {
+        typedef typename Array::value_type scalar_type;
+        typedef Array array_type;
+        typedef size_t size_type;
+
+        static inline array_type make(scalar_type const& val, size_t count)
+        {
+            return array_type(val, count);
+        }
+
+        static inline array_type make(const scalar_type* ptr, size_t count)
+        {
+            return array_type(ptr, count);
+        }
+
+        // Resizes the array, storage is kept if the size is not changed
+        // and the storage is not shared with other arrays.
+        static inline void resize(array_type& x, size_t count)
+        {
+            if (x.size() != count || shared(x))
+            {
+                reset(x, count);
+            }
+        }
+
+        template <class Ty1, class Ty2>
+        static inline bool operator_Ne(const Ty1& x, const Ty2& y)
+        {
+            return all_of(x, y, [](const scalar_type& l, const scalar_type& r) { return l != r; });
+        }
+
+        template <class Ty1, class Ty2>
+        static inline bool operator_Eq(const Ty1& x, const Ty2& y)
+        {
+            return all_of(x, y, [](const scalar_type& l, const scalar_type& r) { return l == r; });
+        }
+
+        template <class Ty1, class Ty2>
+        static inline bool operator_Lt(const Ty1& x, const Ty2& y)
+        {
+            return all_of(x, y, [](const scalar_type& l, const scalar_type& r) { return l < r; });
+        }
+
+        template <class Ty1, class Ty2>
+        static inline bool operator_Le(const Ty1& x, const Ty2& y)
+        {
+            return all_of(x, y, [](const scalar_type& l, const scalar_type& r) { return l <= r; });
+        }
+
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, abs)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, acos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sqrt)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, asin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, atan)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, cos)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sin)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, cosh)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, sinh)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, exp)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, log)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, tan)
+        CL_INNER_ARRAY_FUNCTION_TO_TRAITS(std::, tanh)
+
+        // Returns the function value computed by the in-place version.
+#define CL_INNER_ARRAY_FUNCTION_BY_RESULT(Name)                             \
+        static inline array_type Name(const array_type& x)                  \
+        {                                                                   \
+            array_type result;                                              \
+            Name(result, x);                                                \
+            return result;                                                  \
+        }
+
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(abs)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(acos)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(sqrt)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(asin)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(atan)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(cos)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(sin)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(cosh)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(sinh)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(exp)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(log)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(tan)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(tanh)
+        CL_INNER_ARRAY_FUNCTION_BY_RESULT(sign)
+#undef CL_INNER_ARRAY_FUNCTION_BY_RESULT
+
+        static inline void sign(array_type& result, const array_type& x)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = x[i] > 0. ? scalar_type(1.0)
+                    : (x[i] == 0. ? scalar_type(0.0) : scalar_type(-1.0));
+            }
+        }
+
+        template <class Ty1, class Ty2>
+        static inline array_type pow(const Ty1& x, const Ty2& y)
+        {
+            array_type result;
+            pow(result, x, y);
+            return result;
+        }
+
+        static inline void pow(array_type& result, const array_type& x, const scalar_type& y)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = std::pow(x[i], y);
+            }
+        }
+
+        static inline void pow(array_type& result, const scalar_type& x, const array_type& y)
+        {
+            resize(result, y.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < y.size(); i++)
+            {
+                z[i] = std::pow(x, y[i]);
+            }
+        }
+
+        static inline void pow(array_type& result, const array_type& x, const array_type& y)
+        {
+            resize(result, x.size());
+            scalar_type* z = array_data(result);
+            for (size_type i = 0; i < x.size(); i++)
+            {
+                z[i] = std::pow(x[i], y[i]);
+            }
+        }
+
+    private:
+        template <class Ty>
+        static inline bool shared(const Ty&) { return false; }
+
+        template <class Scalar>
+        static inline bool shared(const shared_array<Scalar>& x) { return !x.unique(); }
+
+        template <class Ty>
+        static inline void reset(Ty& x, size_t count) { x.resize(count); }
+
+        template <class Scalar, size_t N>
+        static inline void reset(std::array<Scalar, N>&, size_t)
+        {
+            cl::throw_("Lane count of fixed size array cannot be changed.");
+        }
+
+        static inline size_t lanes(const array_type& x) { return x.size(); }
+        static inline size_t lanes(const scalar_type&) { return 0; }
+
+        static inline const scalar_type& at(const array_type& x, size_t i) { return x[i]; }
+        static inline const scalar_type& at(const scalar_type& x, size_t) { return x; }
+
+        // Returns true if pred is true for all lanes.
+        template <class Ty1, class Ty2, class Pred>
+        static inline bool all_of(const Ty1& x, const Ty2& y, Pred pred)
+        {
+            const size_t n = std::max(lanes(x), lanes(y));
+            bool result = true;
+            for (size_t i = 0; i < n; i++)
+            {
+                result &= pred(at(x, i), at(y, i));
+            }
+            return result;
+        }
+    };
+
+    /// <summary>Array traits of small_array.</summary>
+    template <class Scalar, size_t N>
+    struct array_traits<small_array<Scalar, N>>
+        : sequence_array_traits<small_array<Scalar, N>>
+    {};
+
+    /// <summary>Array traits of shared_array.</summary>
+    template <class Scalar>
+    struct array_traits<shared_array<Scalar>>
+        : sequence_array_traits<shared_array<Scalar>>
+    {};
+
+    /// <summary>Array traits of std::array, the lane count
+    /// of tape_inner have to be equal to N.</summary>
+    template <class Scalar, size_t N>
+    struct array_traits<std::array<Scalar, N>>
+        : sequence_array_traits<std::array<Scalar, N>>
+    {
+        typedef Scalar scalar_type;
+        typedef std::array<Scalar, N> array_type;
+
+        static inline array_type make(scalar_type const& val, size_t count)
+        {
+            check(count);
+            array_type result;
+            result.fill(val);
+            return result;
+        }
+
+        static inline array_type make(const scalar_type* ptr, size_t count)
+        {
+            check(count);
+            array_type result;
+            std::copy(ptr, ptr + N, result.begin());
+            return result;
+        }
+
+    private:
+        static inline void check(size_t count)
+        {
+            if (count != N)
+            {
+                cl::throw_("Lane count does not match the size of fixed size array.");
+            }
+        }
+    };
+
+#if defined CL_SIMD_MATH_ENABLED
+    /// <summary>std::valarray which math functions are evaluated
+    /// by the vectorized simd_math kernels.</summary>
+    template <class Scalar>
+    struct simd_valarray : std::valarray<Scalar>
+    {
+        typedef std::valarray<Scalar> base;
+
+        simd_valarray() : base() {}
+        explicit simd_valarray(size_t count) : base(count) {}
+        simd_valarray(const Scalar& val, size_t count) : base(val, count) {}
+        simd_valarray(const Scalar* ptr, size_t count) : base(ptr, count) {}
+        simd_valarray(std::initializer_list<Scalar> il) : base(il) {}
+        simd_valarray(const base& other) : base(other) {}
+        simd_valarray(base&& other) : base(std::move(other)) {}
+
+        // Conversion from valarray expressions.
+        template <class Expr, class = typename std::enable_if<
+            std::is_convertible<Expr, base>::value>::type>
+        simd_valarray(const Expr& expr) : base(expr) {}
+
+        simd_valarray(const simd_valarray&) = default;
+        simd_valarray(simd_valarray&&) = default;
+        simd_valarray& operator=(const simd_valarray&) = default;
+        simd_valarray& operator=(simd_valarray&&) = default;
+    };
+
+    typedef tape_inner<simd_valarray<double>> tape_valueSimd;
+
+    /// <summary>Array traits of simd_valarray, exp, log, sqrt, sin, cos, tanh
+    /// and pow use simd_math kernels, other functions are the same as for std::valarray.</summary>
+    template <>
+    struct array_traits<simd_valarray<double>>
+        : array_traits<std::valarray<double>>
+    {
+        typedef array_traits<std::valarray<double>> valarray_traits;
+        typedef simd_valarray<double> array_type;
+
+        static inline array_type make(scalar_type const& val, size_t count)
+        {
+            return array_type(val, count);
+        }
+
+        static inline array_type make(const scalar_type* ptr, size_t count)
+        {
+            return array_type(ptr, count);
+        }
+
+#define CL_INNER_ARRAY_FUNCTION_SIMD(Name)                                  \
+        static inline void Name(array_type& result, const array_type& x)    \
+        {                                                                   \
+            resize(result, x.size());                                       \
+            if (x.size() > 0)                                               \
+            {                                                               \
+                simd_math::Name(&result[0], &x[0], x.size());               \
+            }                                                               \
+        }                                                                   \
+                                                                            \
+        static inline array_type Name(const array_type& x)                  \
+        {                                                                   \
+            array_type result;                                              \
+            Name(result, x);                                                \
+            return result;                                                  \
+        }
+
+        CL_INNER_ARRAY_FUNCTION_SIMD(exp)
+        CL_INNER_ARRAY_FUNCTION_SIMD(log)
+        CL_INNER_ARRAY_FUNCTION_SIMD(sqrt)
+        CL_INNER_ARRAY_FUNCTION_SIMD(sin)
+        CL_INNER_ARRAY_FUNCTION_SIMD(cos)
+        CL_INNER_ARRAY_FUNCTION_SIMD(tanh)
+#undef CL_INNER_ARRAY_FUNCTION_SIMD
+
+#define CL_INNER_ARRAY_FUNCTION_VALARRAY(Name)                              \
+        static inline array_type Name(const array_type& x)                  \
+        {                                                                   \
+            return valarray_traits::Name(x);                                \
+        }                                                                   \
+        using valarray_traits::Name;
+
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(abs)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(acos)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(asin)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(atan)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(cosh)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(sinh)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(tan)
+        CL_INNER_ARRAY_FUNCTION_VALARRAY(sign)
+#undef CL_INNER_ARRAY_FUNCTION_VALARRAY
+
+        static inline void pow(array_type& result, const array_type& x, const scalar_type& y)
+        {
+            resize(result, x.size());
+            if (x.size() > 0)
+            {
+                simd_math::pow(&result[0], &x[0], 1, &y, 0, x.size());
+            }
+        }
+
+        static inline void pow(array_type& result, const scalar_type& x, const array_type& y)
+        {
+            resize(result, y.size());
+            if (y.size() > 0)
+            {
+                simd_math::pow(&result[0], &x, 0, &y[0], 1, y.size());
+            }
+        }
+
+        static inline void pow(array_type& result, const array_type& x, const array_type& y)
+        {
+            resize(result, x.size());
+            if (x.size() > 0)
+            {
+                simd_math::pow(&result[0], &x[0], 1, &y[0], 1, x.size());
+            }
+        }
+
+        template <class Ty1, class Ty2>
+        static inline array_type pow(const Ty1& x, const Ty2& y)
+        {
+            array_type result;
+            pow(result, x, y);
+            return result;
+        }
+    };
+#endif // CL_SIMD_MATH_ENABLED
 }
 
 #endif // cl_tape_impl_tape_inner_traits_hpp
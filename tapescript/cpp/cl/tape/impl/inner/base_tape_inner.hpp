@@ -23,61 +23,190 @@ limitations under the License.
 
 #include <limits>
 #include <cl/tape/impl/inner/tape_inner.hpp>
+#include <cl/tape/impl/inner/tape_inner_expr.hpp>
+#include <cl/tape/impl/inner/lane_select.hpp>
+#include <cl/tape/impl/inner/simd_math.hpp>
 
 namespace CppAD
 {
+#define CL_INNER_ARRAY_COND_EXP(Name, Op)                                                       \
+    template <class Array>                                                                      \
+    inline void Name(                                                                           \
+        cl::tape_inner<Array>&             result,                                              \
+        const cl::tape_inner<Array>&       left,                                                \
+        const cl::tape_inner<Array>&       right,                                               \
+        const cl::tape_inner<Array>&       exp_if_true,                                         \
+        const cl::tape_inner<Array>&       exp_if_false)                                        \
+    {                                                                                           \
+        if (left.is_scalar() && right.is_scalar())                                              \
+        {                                                                                       \
+            result = (left.scalar_value_ Op right.scalar_value_)                                \
+                ? exp_if_true : exp_if_false;                                                   \
+            size_t count = cl::tape_inner<Array>::broadcast_size(left, right);                  \
+            if (count == 0)                                                                     \
+            {                                                                                   \
+                count = cl::tape_inner<Array>::broadcast_size(exp_if_true, exp_if_false);       \
+            }                                                                                   \
+            result.set_broadcast(count);                                                        \
+            return;                                                                             \
+        }                                                                                       \
+                                                                                                \
+        typedef typename cl::tape_inner<Array>::scalar_type scalar_type;                        \
+        size_t size = left.is_array() ? left.size() : right.size();                             \
+                                                                                                \
+        result.make_array(size);                                                                \
+        scalar_type* z = cl::array_data(result.array_value_);                                   \
+        cl::select_lanes(size, cl::lanes_of(left), cl::lanes_of(right)                          \
+            , cl::lanes_of(exp_if_true), cl::lanes_of(exp_if_false)                             \
+            , [](const scalar_type& l, const scalar_type& r) { return l Op r; }                 \
+            , [z](size_t i, const scalar_type& v) { z[i] = v; });                               \
+    }                                                                                           \
+                                                                                                \
+    /* Adds the selected value to result without a temporary. */                                \
+    template <class Array>                                                                      \
+    inline void Name##Add(                                                                      \
+        cl::tape_inner<Array>&             result,                                              \
+        const cl::tape_inner<Array>&       left,                                                \
+        const cl::tape_inner<Array>&       right,                                               \
+        const cl::tape_inner<Array>&       exp_if_true,                                         \
+        const cl::tape_inner<Array>&       exp_if_false)                                        \
+    {                                                                                           \
+        if (left.is_scalar() && right.is_scalar())                                              \
+        {                                                                                       \
+            const cl::tape_inner<Array>& value = (left.scalar_value_ Op right.scalar_value_)    \
+                ? exp_if_true : exp_if_false;                                                   \
+            size_t count = cl::tape_inner<Array>::broadcast_size(left, right);                  \
+            if (count == 0)                                                                     \
+            {                                                                                   \
+                count = cl::tape_inner<Array>::broadcast_size(exp_if_true, exp_if_false);       \
+            }                                                                                   \
+            if (count > 0 && value.is_scalar() && !value.is_broadcast())                        \
+            {                                                                                   \
+                result += cl::tape_inner<Array>::broadcast(value.scalar_value_, count);         \
+                return;                                                                         \
+            }                                                                                   \
+            result += value;                                                                    \
+            return;                                                                             \
+        }                                                                                       \
+                                                                                                \
+        typedef typename cl::tape_inner<Array>::scalar_type scalar_type;                        \
+        size_t size = left.is_array() ? left.size() : right.size();                             \
+        auto cmp = [](const scalar_type& l, const scalar_type& r) { return l Op r; };           \
+                                                                                                \
+        if (result.is_intrusive())                                                              \
+        {                                                                                       \
+            scalar_type sum = 0.0;                                                              \
+            cl::select_lanes(size, cl::lanes_of(left), cl::lanes_of(right)                      \
+                , cl::lanes_of(exp_if_true), cl::lanes_of(exp_if_false), cmp                    \
+                , [&sum](size_t, const scalar_type& v) { sum += v; });                          \
+            result.scalar_value_ += sum;                                                        \
+            return;                                                                             \
+        }                                                                                       \
+                                                                                                \
+        if (result.is_scalar())                                                                 \
+        {                                                                                       \
+            const scalar_type value = result.scalar_value_;                                     \
+            result.make_array(size);                                                            \
+            scalar_type* values = cl::array_data(result.array_value_);                          \
+            std::fill(values, values + size, value);                                            \
+        }                                                                                       \
+        scalar_type* z = cl::array_data(result.array_value_);                                   \
+        cl::select_lanes(size, cl::lanes_of(left), cl::lanes_of(right)                          \
+            , cl::lanes_of(exp_if_true), cl::lanes_of(exp_if_false), cmp                        \
+            , [z](size_t i, const scalar_type& v) { z[i] += v; });                              \
+    }                                                                                           \
+                                                                                                \
+    template <class Array>                                                                      \
+    inline cl::tape_inner<Array> Name(                                                          \
+        const cl::tape_inner<Array>&       left,                                                \
+        const cl::tape_inner<Array>&       right,                                               \
+        const cl::tape_inner<Array>&       exp_if_true,                                         \
+        const cl::tape_inner<Array>&       exp_if_false)                                        \
+    {                                                                                           \
+        cl::tape_inner<Array> result;                                                           \
+        Name(result, left, right, exp_if_true, exp_if_false);                                   \
+        return result;                                                                          \
+    }
+
     // Conditional equal expression.
+    CL_INNER_ARRAY_COND_EXP(CondExpOpEq, ==)
+
+    // Conditional less expression.
+    CL_INNER_ARRAY_COND_EXP(CondExpOpLt, <)
+#undef CL_INNER_ARRAY_COND_EXP
+
+    // Conditional expression, the result is written to result.
     template <class Array>
-    inline cl::tape_inner<Array> CondExpOpEq(
-        const cl::tape_inner<Array>&       left,
-        const cl::tape_inner<Array>&       right,
-        const cl::tape_inner<Array>&       exp_if_true,
-        const cl::tape_inner<Array>&       exp_if_false)
+    inline void CondExpOp(
+        cl::tape_inner<Array>&             result       ,
+        enum CompareOp                      cop          ,
+        const cl::tape_inner<Array>&       left         ,
+        const cl::tape_inner<Array>&       right        ,
+        const cl::tape_inner<Array>&       exp_if_true  ,
+        const cl::tape_inner<Array>&       exp_if_false )
     {
-        if (left.is_scalar() && right.is_scalar())
+        switch (cop)
         {
-            return (left.scalar_value_ == right.scalar_value_)
-                ? exp_if_true : exp_if_false;
-        }
+        case CompareLt:
+            CondExpOpLt(result, left, right, exp_if_true, exp_if_false);
+            break;
+
+        case CompareLe:
+            CondExpOpLt(result, right, left, exp_if_false, exp_if_true);
+            break;
 
-        size_t size = left.is_array() ? left.size() : right.size();
+        case CompareGe:
+            CondExpOpLt(result, left, right, exp_if_false, exp_if_true);
+            break;
 
-        typename cl::tape_inner<Array>::array_type result(size);
+        case CompareGt:
+            CondExpOpLt(result, right, left, exp_if_true, exp_if_false);
+            break;
 
-        for (size_t i = 0; i < size; i++)
-        {
-            result[i] = left.element_at(i) == right.element_at(i)
-                ? exp_if_true.element_at(i) : exp_if_false.element_at(i);
-        }
+        case CompareEq:
+            CondExpOpEq(result, left, right, exp_if_true, exp_if_false);
+            break;
 
-        return result;
+        default:
+            cl::throw_("Unknown compare operation.");
+        }
     }
 
-    // Conditional less expression.
+    // Adds the conditional expression to result.
     template <class Array>
-    inline cl::tape_inner<Array> CondExpOpLt(
-        const cl::tape_inner<Array>&       left,
-        const cl::tape_inner<Array>&       right,
-        const cl::tape_inner<Array>&       exp_if_true,
-        const cl::tape_inner<Array>&       exp_if_false)
+    inline void CondExpOpAdd(
+        cl::tape_inner<Array>&             result       ,
+        enum CompareOp                      cop          ,
+        const cl::tape_inner<Array>&       left         ,
+        const cl::tape_inner<Array>&       right        ,
+        const cl::tape_inner<Array>&       exp_if_true  ,
+        const cl::tape_inner<Array>&       exp_if_false )
     {
-        if (left.is_scalar() && right.is_scalar())
+        switch (cop)
         {
-            return (left.scalar_value_ < right.scalar_value_)
-                ? exp_if_true : exp_if_false;
-        }
+        case CompareLt:
+            CondExpOpLtAdd(result, left, right, exp_if_true, exp_if_false);
+            break;
 
-        size_t size = left.is_array() ? left.size() : right.size();
+        case CompareLe:
+            CondExpOpLtAdd(result, right, left, exp_if_false, exp_if_true);
+            break;
 
-        typename cl::tape_inner<Array>::array_type result(size);
+        case CompareGe:
+            CondExpOpLtAdd(result, left, right, exp_if_false, exp_if_true);
+            break;
 
-        for (size_t i = 0; i < size; i++)
-        {
-            result[i] = left.element_at(i) < right.element_at(i)
-                ? exp_if_true.element_at(i) : exp_if_false.element_at(i);
-        }
+        case CompareGt:
+            CondExpOpLtAdd(result, right, left, exp_if_true, exp_if_false);
+            break;
+
+        case CompareEq:
+            CondExpOpEqAdd(result, left, right, exp_if_true, exp_if_false);
+            break;
 
-        return result;
+        default:
+            cl::throw_("Unknown compare operation.");
+        }
     }
 
     // Conditional expression.
@@ -128,13 +257,13 @@ namespace CppAD
     template <class Array>
     inline bool IdenticalZero(const cl::tape_inner<Array>& x)
     {
-        return x.is_scalar() && x == 0.0;
+        return x.is_scalar() && !x.is_broadcast() && x == 0.0;
     }
 
     template <class Array>
     inline bool IdenticalOne(const cl::tape_inner<Array>& x)
     {
-        return x.is_scalar() && x == 1.0;
+        return x.is_scalar() && !x.is_broadcast() && x == 1.0;
     }
 
     template <class Array>
@@ -142,7 +271,9 @@ namespace CppAD
     {
         if (x.is_scalar() && y.is_scalar())
         {
-            return x == y;
+            return x.is_broadcast() == y.is_broadcast()
+                && (!x.is_broadcast() || x.size() == y.size())
+                && x == y;
         }
         if (x.is_array() && y.is_array())
         {
@@ -257,14 +388,84 @@ namespace CppAD
         return numeric_limits<cl::tape_value>::epsilon();
     }
 
+    // Hash code of operation used by optimize to find common subexpressions.
+    // The bytes of tape_inner hold the pointer to the lanes, so the parameter
+    // operand is hashed by value and the operation is coded as in CppAD.
+    // The parameter count of the CppAD signature is not used.
     template <class Array>
-    inline unsigned short hash_code(const cl::tape_inner<Array>& value)
+    inline unsigned short hash_code(OpCode op, const addr_t* arg, size_t, const cl::tape_inner<Array>* par)
     {
-        if (value.is_scalar())
+        addr_t operands[2] = { arg[0], NumArg(op) > 1 ? arg[1] : 0 };
+        unsigned short value = 0;
+        switch (op)
         {
-            return hash_code(value.scalar_value_);
+        case AddpvOp:
+        case DivpvOp:
+        case MulpvOp:
+        case PowpvOp:
+        case SubpvOp:
+            value = hash_code(par[arg[0]]);
+            operands[0] = 0;
+            break;
+
+        case DivvpOp:
+        case PowvpOp:
+        case SubvpOp:
+            value = hash_code(par[arg[1]]);
+            operands[1] = 0;
+            break;
+
+        default:
+            break;
         }
-        return hash_code(value.array_value_[0]);
+        return hash_code<unsigned short>(op, operands, 1, &value);
+    }
+}
+
+namespace cl
+{
+    // Hash code of parameter used by the recorder to store each value once.
+    // All lanes are hashed, so the equal arrays recorded many times
+    // are found in the parameter table. The recorder of CppAD is defined
+    // before this file, so the overload is found by argument dependent lookup.
+    template <class Array>
+    inline unsigned short hash_code(const tape_inner<Array>& value)
+    {
+        std::uint64_t code = value.is_scalar()
+            ? simd_math::hash(&value.scalar_value_, 1)
+            : value.size() > 0 ? simd_math::hash(value.begin(), value.size()) : 0;
+        return static_cast<unsigned short>(code % CPPAD_HASH_TABLE_SIZE);
+    }
+
+    namespace tapescript
+    {
+        /// <summary>Arrays and broadcasts have lanes for ad_simplify,
+        /// the value of an empty array is not known.</summary>
+        template <class Array>
+        struct simplify_traits<tape_inner<Array>>
+        {
+            typedef tape_inner<Array> inner_type;
+
+            static size_t lanes(const inner_type& x)
+            {
+                return x.is_array() || x.is_broadcast() ? x.size() : 0;
+            }
+
+            static bool uniform(const inner_type& x, double& value)
+            {
+                if (x.is_array() && x.size() == 0)
+                {
+                    return false;
+                }
+                value = x.element_at(0);
+                return x == value;
+            }
+
+            static bool finite(const inner_type& x)
+            {
+                return x - x == 0.;
+            }
+        };
     }
 }
 
@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_fixed_array_hpp
+#define cl_tape_impl_inner_fixed_array_hpp
+
+#include <cstddef>
+#include <array>
+
+// Elementwise arithmetic of std::array used as Array parameter of tape_inner.
+// The operators are declared in namespace cl before tape_inner, so they are
+// found by the unqualified lookup from tape_inner operations. The lane count
+// is a compile time constant, so the loops are unrolled and vectorized.
+namespace cl
+{
+#define CL_FIXED_ARRAY_OPERATOR(Op)                                                             \
+    template <class Scalar, size_t N>                                                           \
+    inline std::array<Scalar, N> operator Op(                                                   \
+        const std::array<Scalar, N>& x                                                          \
+        , const std::array<Scalar, N>& y)                                                       \
+    {                                                                                           \
+        std::array<Scalar, N> result;                                                           \
+        for (size_t i = 0; i < N; i++)                                                          \
+        {                                                                                       \
+            result[i] = x[i] Op y[i];                                                           \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar, size_t N>                                                           \
+    inline std::array<Scalar, N> operator Op(                                                   \
+        const std::array<Scalar, N>& x                                                          \
+        , const typename std::array<Scalar, N>::value_type& y)                                  \
+    {                                                                                           \
+        std::array<Scalar, N> result;                                                           \
+        for (size_t i = 0; i < N; i++)                                                          \
+        {                                                                                       \
+            result[i] = x[i] Op y;                                                              \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar, size_t N>                                                           \
+    inline std::array<Scalar, N> operator Op(                                                   \
+        const typename std::array<Scalar, N>::value_type& x                                     \
+        , const std::array<Scalar, N>& y)                                                       \
+    {                                                                                           \
+        std::array<Scalar, N> result;                                                           \
+        for (size_t i = 0; i < N; i++)                                                          \
+        {                                                                                       \
+            result[i] = x Op y[i];                                                              \
+        }                                                                                       \
+        return result;                                                                          \
+    }
+
+    CL_FIXED_ARRAY_OPERATOR(-)
+    CL_FIXED_ARRAY_OPERATOR(*)
+    CL_FIXED_ARRAY_OPERATOR(/)
+    CL_FIXED_ARRAY_OPERATOR(+)
+#undef CL_FIXED_ARRAY_OPERATOR
+
+    template <class Scalar, size_t N>
+    inline std::array<Scalar, N> operator-(const std::array<Scalar, N>& x)
+    {
+        std::array<Scalar, N> result;
+        for (size_t i = 0; i < N; i++)
+        {
+            result[i] = -x[i];
+        }
+        return result;
+    }
+}
+
+#endif // cl_tape_impl_inner_fixed_array_hpp
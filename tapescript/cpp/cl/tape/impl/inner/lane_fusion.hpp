@@ -0,0 +1,526 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_lane_fusion_hpp
+#define cl_tape_impl_inner_lane_fusion_hpp
+
+#include <cmath>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cl/tape/impl/detail/thread_local.hpp>
+#include <cl/tape/impl/inner/tape_inner.hpp>
+#include <cl/tape/impl/inner/lane_select.hpp>
+
+namespace cl
+{
+    /// <summary>Elementwise operation of a fused group. Operand index below
+    /// the input count of the group is the index of its input, operand index
+    /// input count + k is the result of operation k of the group.</summary>
+    struct fused_op
+    {
+        enum kind_type { Add, Sub, Mul, Div, Exp, Log, Sqrt, Cond };
+
+        // Result is used inside the group only.
+        static const size_t npos = size_t(-1);
+
+        kind_type kind_;
+
+        // Comparison of Cond, its operands are left, right, if true and if false.
+        CppAD::CompareOp compare_;
+
+        size_t args_[4];
+
+        // Index of the result among the outputs of the group, npos if there is no one.
+        size_t output_;
+    };
+
+    /// <summary>Evaluation of fused group lane by lane.
+    /// Base without lanes is not fused.</summary>
+    template <class Base>
+    struct lane_fusion
+    {
+        typedef std::vector<fused_op> ops_type;
+
+        // Lane count of the group inputs, zero if the group is not fused.
+        static size_t lanes(const ops_type&, const Base* const*, size_t) { return 0; }
+
+        // True if each not null value is a scalar or it has n lanes.
+        static bool fits(const Base* const*, size_t, size_t) { return false; }
+
+        // True if each not null partial can take n lanes.
+        static bool fits_partials(Base* const*, size_t, size_t) { return false; }
+
+        static void forward(const ops_type&, size_t
+            , const Base* const*, size_t, Base* const*) {}
+
+        static void tangent(const ops_type&, size_t
+            , const Base* const*, const Base* const*, size_t, Base* const*) {}
+
+        static void reverse(const ops_type&, size_t
+            , const Base* const*, size_t, const Base* const*, Base* const*) {}
+    };
+
+    /// <summary>Evaluation of fused group of tape_inner values.
+    /// The lanes are taken by blocks, each operation of the group runs one loop
+    /// over the block, the results which are used inside the group only
+    /// are kept in block buffers which stay in cache and are not stored.</summary>
+    template <class Array>
+    struct lane_fusion<tape_inner<Array>>
+    {
+        typedef tape_inner<Array> inner_type;
+        typedef typename inner_type::scalar_type scalar_type;
+        typedef lane_ref<scalar_type> ref_type;
+        typedef std::vector<fused_op> ops_type;
+
+        // Lanes of block, the buffers of a group of 64 operations take 128K.
+        static const size_t block_lanes = 256;
+
+        // Lane count of the group inputs, zero if they have different lane counts
+        // or the result of some operation is not an array when it runs alone,
+        // the comparison of Cond has to take an array for this.
+        static size_t lanes(const ops_type& ops, const inner_type* const* x, size_t count)
+        {
+            size_t n = 0;
+            std::vector<bool>& arrays = flags(count + ops.size());
+            for (size_t j = 0; j < count; j++)
+            {
+                arrays[j] = x[j]->is_array();
+                if (arrays[j] && n == 0)
+                {
+                    n = x[j]->size();
+                }
+            }
+
+            for (size_t k = 0; k < ops.size(); k++)
+            {
+                const size_t* args = ops[k].args_;
+                arrays[count + k] = arrays[args[0]] || arrays[args[1]];
+                if (!arrays[count + k])
+                {
+                    return 0;
+                }
+            }
+            return n > 0 && fits(x, count, n) ? n : 0;
+        }
+
+        // True if each not null value is a scalar or it has n lanes.
+        static bool fits(const inner_type* const* x, size_t count, size_t n)
+        {
+            for (size_t j = 0; j < count; j++)
+            {
+                if (x[j] && (x[j]->is_intrusive() || (has_lanes(*x[j]) && x[j]->size() != n)))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // True if each not null partial can take n lanes, the intrusive
+        // partials of scalar values take the sum over lanes.
+        static bool fits_partials(inner_type* const* px, size_t count, size_t n)
+        {
+            for (size_t j = 0; j < count; j++)
+            {
+                if (px[j] && has_lanes(*px[j]) && px[j]->size() != n)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Writes the values of the outputs of the group.
+        static void forward(const ops_type& ops, size_t n
+            , const inner_type* const* x, size_t inputs, inner_type* const* y)
+        {
+            std::vector<scalar_type>& values = buffer(0, ops.size() * block_lanes);
+            std::vector<ref_type>& r = refs(0, inputs + ops.size());
+            std::vector<scalar_type*>& out = outputs(0, ops, y, n);
+
+            for (size_t begin = 0; begin < n; begin += block_lanes)
+            {
+                size_t count = std::min(size_t(block_lanes), n - begin);
+                bind(r, x, inputs, begin);
+                for (size_t k = 0; k < ops.size(); k++)
+                {
+                    scalar_type* z = destination(ops[k], out, begin, &values[k * block_lanes]);
+                    r[inputs + k] = ref_type{ z, 1 };
+                    value(ops[k], count, r.data(), z);
+                }
+            }
+        }
+
+        // Writes the first order coefficients of the outputs of the group.
+        static void tangent(const ops_type& ops, size_t n
+            , const inner_type* const* x, const inner_type* const* dx, size_t inputs, inner_type* const* dy)
+        {
+            std::vector<scalar_type>& values = buffer(0, ops.size() * block_lanes);
+            std::vector<scalar_type>& tangents = buffer(1, ops.size() * block_lanes);
+            std::vector<ref_type>& r = refs(0, inputs + ops.size());
+            std::vector<ref_type>& dr = refs(1, inputs + ops.size());
+            std::vector<scalar_type*>& out = outputs(0, ops, dy, n);
+
+            for (size_t begin = 0; begin < n; begin += block_lanes)
+            {
+                size_t count = std::min(size_t(block_lanes), n - begin);
+                bind(r, x, inputs, begin);
+                bind(dr, dx, inputs, begin);
+                for (size_t k = 0; k < ops.size(); k++)
+                {
+                    scalar_type* z = &values[k * block_lanes];
+                    scalar_type* dz = destination(ops[k], out, begin, &tangents[k * block_lanes]);
+                    value(ops[k], count, r.data(), z);
+                    tangent(ops[k], count, r.data(), dr.data(), z, dz);
+                    r[inputs + k] = ref_type{ z, 1 };
+                    dr[inputs + k] = ref_type{ dz, 1 };
+                }
+            }
+        }
+
+        // Adds the partials of the inputs, px is null for parameters.
+        // The values inside the group are evaluated again block by block.
+        static void reverse(const ops_type& ops, size_t n
+            , const inner_type* const* x, size_t inputs, const inner_type* const* py, inner_type* const* px)
+        {
+            std::vector<scalar_type>& values = buffer(0, ops.size() * block_lanes);
+            std::vector<scalar_type>& partials = buffer(1, (inputs + ops.size()) * block_lanes);
+            std::vector<ref_type>& r = refs(0, inputs + ops.size());
+            std::vector<ref_type>& pr = refs(1, 0);
+            for (size_t k = 0; k < ops.size(); k++)
+            {
+                if (ops[k].output_ != fused_op::npos)
+                {
+                    pr.push_back(lanes_of(*py[ops[k].output_]));
+                }
+            }
+
+            // partials of the values with lanes get all lanes
+            for (size_t j = 0; j < inputs; j++)
+            {
+                if (px[j] && !px[j]->is_array() && !px[j]->is_intrusive())
+                {
+                    const scalar_type value = px[j]->scalar_value_;
+                    px[j]->make_array(n);
+                    std::fill(px[j]->begin(), px[j]->end(), value);
+                }
+            }
+
+            for (size_t begin = 0; begin < n; begin += block_lanes)
+            {
+                size_t count = std::min(size_t(block_lanes), n - begin);
+                bind(r, x, inputs, begin);
+                for (size_t k = 0; k < ops.size(); k++)
+                {
+                    scalar_type* z = &values[k * block_lanes];
+                    value(ops[k], count, r.data(), z);
+                    r[inputs + k] = ref_type{ z, 1 };
+                }
+
+                std::fill(partials.begin(), partials.begin() + (inputs + ops.size()) * block_lanes, scalar_type());
+                for (size_t k = 0; k < ops.size(); k++)
+                {
+                    if (ops[k].output_ != fused_op::npos)
+                    {
+                        const ref_type& p = pr[ops[k].output_];
+                        scalar_type* pz = &partials[(inputs + k) * block_lanes];
+                        for (size_t i = 0; i < count; i++)
+                        {
+                            pz[i] = p[begin + i];
+                        }
+                    }
+                }
+
+                for (size_t k = ops.size(); k-- > 0;)
+                {
+                    partial(ops[k], count, r.data(), r[inputs + k].ptr_
+                        , &partials[(inputs + k) * block_lanes], partials.data());
+                }
+
+                for (size_t j = 0; j < inputs; j++)
+                {
+                    if (px[j])
+                    {
+                        add_partial(*px[j], begin, count, &partials[j * block_lanes]);
+                    }
+                }
+            }
+        }
+
+    private:
+        static bool has_lanes(const inner_type& x)
+        {
+            return x.is_array() || x.is_broadcast();
+        }
+
+        // Thread local buffer of at least size elements.
+        static std::vector<scalar_type>& buffer(size_t index, size_t size)
+        {
+            struct tag;
+            std::array<std::vector<scalar_type>, 2>& buffers = thread_instance<std::array<std::vector<scalar_type>, 2>, tag>();
+            if (buffers[index].size() < size)
+            {
+                buffers[index].resize(size);
+            }
+            return buffers[index];
+        }
+
+        // Thread local flags of the operands.
+        static std::vector<bool>& flags(size_t size)
+        {
+            struct tag;
+            std::vector<bool>& flags = thread_instance<std::vector<bool>, tag>();
+            flags.resize(size);
+            return flags;
+        }
+
+        // Thread local operand references.
+        static std::vector<ref_type>& refs(size_t index, size_t size)
+        {
+            struct tag;
+            std::array<std::vector<ref_type>, 2>& refs = thread_instance<std::array<std::vector<ref_type>, 2>, tag>();
+            refs[index].resize(size);
+            return refs[index];
+        }
+
+        // Lanes of the outputs, they are made arrays of n lanes.
+        static std::vector<scalar_type*>& outputs(size_t index, const ops_type& ops, inner_type* const* y, size_t n)
+        {
+            struct tag;
+            std::vector<scalar_type*>& result = thread_instance<std::array<std::vector<scalar_type*>, 1>, tag>()[index];
+            result.clear();
+            for (size_t k = 0; k < ops.size(); k++)
+            {
+                if (ops[k].output_ != fused_op::npos)
+                {
+                    y[ops[k].output_]->make_array(n);
+                    result.push_back(y[ops[k].output_]->begin());
+                }
+            }
+            return result;
+        }
+
+        // Result of operation is written to the output or to its block buffer.
+        static scalar_type* destination(const fused_op& op, std::vector<scalar_type*>& out, size_t begin, scalar_type* buffer)
+        {
+            return op.output_ != fused_op::npos ? out[op.output_] + begin : buffer;
+        }
+
+        // References to the block of the inputs.
+        static void bind(std::vector<ref_type>& r, const inner_type* const* x, size_t inputs, size_t begin)
+        {
+            for (size_t j = 0; j < inputs; j++)
+            {
+                ref_type lanes = lanes_of(*x[j]);
+                r[j] = ref_type{ lanes.ptr_ + begin * lanes.stride_, lanes.stride_ };
+            }
+        }
+
+        // Calls func(i, holds) for each lane, holds is true if if_true operand of Cond is taken,
+        // the comparisons are made as by CondExpOp for tape_inner.
+        template <class Func>
+        static void compare_lanes(CppAD::CompareOp compare, size_t count
+            , const ref_type& left, const ref_type& right, Func func)
+        {
+            switch (compare)
+            {
+            case CppAD::CompareLt:
+                for (size_t i = 0; i < count; i++) func(i, left[i] < right[i]);
+                break;
+            case CppAD::CompareLe:
+                for (size_t i = 0; i < count; i++) func(i, !(right[i] < left[i]));
+                break;
+            case CppAD::CompareGe:
+                for (size_t i = 0; i < count; i++) func(i, !(left[i] < right[i]));
+                break;
+            case CppAD::CompareGt:
+                for (size_t i = 0; i < count; i++) func(i, right[i] < left[i]);
+                break;
+            case CppAD::CompareEq:
+                for (size_t i = 0; i < count; i++) func(i, left[i] == right[i]);
+                break;
+            default:
+                cl::throw_("Unknown compare operation.");
+            }
+        }
+
+        // z = op(x, y) for the lanes of block.
+        static void value(const fused_op& op, size_t count, const ref_type* r, scalar_type* z)
+        {
+            const ref_type& x = r[op.args_[0]];
+            const ref_type& y = r[op.args_[1]];
+            switch (op.kind_)
+            {
+            case fused_op::Add:
+                for (size_t i = 0; i < count; i++) z[i] = x[i] + y[i];
+                break;
+            case fused_op::Sub:
+                for (size_t i = 0; i < count; i++) z[i] = x[i] - y[i];
+                break;
+            case fused_op::Mul:
+                for (size_t i = 0; i < count; i++) z[i] = x[i] * y[i];
+                break;
+            case fused_op::Div:
+                for (size_t i = 0; i < count; i++) z[i] = x[i] / y[i];
+                break;
+            case fused_op::Exp:
+                for (size_t i = 0; i < count; i++) z[i] = std::exp(x[i]);
+                break;
+            case fused_op::Log:
+                for (size_t i = 0; i < count; i++) z[i] = std::log(x[i]);
+                break;
+            case fused_op::Sqrt:
+                for (size_t i = 0; i < count; i++) z[i] = std::sqrt(x[i]);
+                break;
+            case fused_op::Cond:
+            {
+                const ref_type& t = r[op.args_[2]];
+                const ref_type& f = r[op.args_[3]];
+                compare_lanes(op.compare_, count, x, y, [&](size_t i, bool holds)
+                {
+                    const scalar_type tv = t[i];
+                    const scalar_type fv = f[i];
+                    z[i] = holds ? tv : fv;
+                });
+                break;
+            }
+            }
+        }
+
+        // First order coefficient dz of z = op(x, y) for the lanes of block.
+        static void tangent(const fused_op& op, size_t count, const ref_type* r, const ref_type* dr
+            , const scalar_type* z, scalar_type* dz)
+        {
+            const ref_type& x = r[op.args_[0]];
+            const ref_type& y = r[op.args_[1]];
+            const ref_type& dx = dr[op.args_[0]];
+            const ref_type& dy = dr[op.args_[1]];
+            switch (op.kind_)
+            {
+            case fused_op::Add:
+                for (size_t i = 0; i < count; i++) dz[i] = dx[i] + dy[i];
+                break;
+            case fused_op::Sub:
+                for (size_t i = 0; i < count; i++) dz[i] = dx[i] - dy[i];
+                break;
+            case fused_op::Mul:
+                for (size_t i = 0; i < count; i++) dz[i] = x[i] * dy[i] + dx[i] * y[i];
+                break;
+            case fused_op::Div:
+                for (size_t i = 0; i < count; i++) dz[i] = (dx[i] - z[i] * dy[i]) / y[i];
+                break;
+            case fused_op::Exp:
+                for (size_t i = 0; i < count; i++) dz[i] = dx[i] * z[i];
+                break;
+            case fused_op::Log:
+                for (size_t i = 0; i < count; i++) dz[i] = dx[i] / x[i];
+                break;
+            case fused_op::Sqrt:
+                for (size_t i = 0; i < count; i++) dz[i] = dx[i] / scalar_type(2) / z[i];
+                break;
+            case fused_op::Cond:
+            {
+                const ref_type& dt = dr[op.args_[2]];
+                const ref_type& df = dr[op.args_[3]];
+                compare_lanes(op.compare_, count, x, y, [&](size_t i, bool holds)
+                {
+                    const scalar_type tv = dt[i];
+                    const scalar_type fv = df[i];
+                    dz[i] = holds ? tv : fv;
+                });
+                break;
+            }
+            }
+        }
+
+        // Adds the partial pz of z = op(x, y) to the block partials of the operands,
+        // the block partial of operand j is partials + j * block_lanes.
+        static void partial(const fused_op& op, size_t count, const ref_type* r
+            , const scalar_type* z, const scalar_type* pz, scalar_type* partials)
+        {
+            const ref_type& x = r[op.args_[0]];
+            const ref_type& y = r[op.args_[1]];
+            scalar_type* px = partials + op.args_[0] * block_lanes;
+            scalar_type* py = partials + op.args_[1] * block_lanes;
+            switch (op.kind_)
+            {
+            case fused_op::Add:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i];
+                for (size_t i = 0; i < count; i++) py[i] += pz[i];
+                break;
+            case fused_op::Sub:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i];
+                for (size_t i = 0; i < count; i++) py[i] -= pz[i];
+                break;
+            case fused_op::Mul:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i] * y[i];
+                for (size_t i = 0; i < count; i++) py[i] += pz[i] * x[i];
+                break;
+            case fused_op::Div:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i] / y[i];
+                for (size_t i = 0; i < count; i++) py[i] -= pz[i] * z[i] / y[i];
+                break;
+            case fused_op::Exp:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i] * z[i];
+                break;
+            case fused_op::Log:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i] / x[i];
+                break;
+            case fused_op::Sqrt:
+                for (size_t i = 0; i < count; i++) px[i] += pz[i] / scalar_type(2) / z[i];
+                break;
+            case fused_op::Cond:
+            {
+                scalar_type* pt = partials + op.args_[2] * block_lanes;
+                scalar_type* pf = partials + op.args_[3] * block_lanes;
+                compare_lanes(op.compare_, count, x, y, [&](size_t i, bool holds)
+                {
+                    (holds ? pt : pf)[i] += pz[i];
+                });
+                break;
+            }
+            }
+        }
+
+        // Adds the block partial to the lanes of px or to the sum of intrusive px.
+        static void add_partial(inner_type& px, size_t begin, size_t count, const scalar_type* p)
+        {
+            if (px.is_intrusive())
+            {
+                scalar_type sum = scalar_type();
+                for (size_t i = 0; i < count; i++)
+                {
+                    sum += p[i];
+                }
+                px.scalar_value_ += sum;
+                return;
+            }
+
+            scalar_type* a = px.begin() + begin;
+            for (size_t i = 0; i < count; i++)
+            {
+                a[i] += p[i];
+            }
+        }
+    };
+}
+
+#endif // cl_tape_impl_inner_lane_fusion_hpp
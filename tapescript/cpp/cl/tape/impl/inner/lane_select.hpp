@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_lane_select_hpp
+#define cl_tape_impl_inner_lane_select_hpp
+
+#include <cl/tape/impl/inner/tape_inner.hpp>
+
+namespace cl
+{
+    /// <summary>Lanes of tape_inner operand as pointer and stride,
+    /// stride is zero for scalar and broadcast operands.</summary>
+    template <class Scalar>
+    struct lane_ref
+    {
+        const Scalar* ptr_;
+        size_t stride_;
+
+        const Scalar& operator[](size_t i) const { return ptr_[i * stride_]; }
+    };
+
+    // Returns lanes of x, the mode of x is checked once for all lanes.
+    template <class Array>
+    inline lane_ref<typename tape_inner<Array>::scalar_type> lanes_of(const tape_inner<Array>& x)
+    {
+        typedef typename tape_inner<Array>::scalar_type scalar_type;
+        if (x.is_array() && x.size() > 0)
+        {
+            return lane_ref<scalar_type>{ &x.array_value_[0], 1 };
+        }
+        return lane_ref<scalar_type>{ &x.scalar_value_, 0 };
+    }
+
+    // Passes cmp(left[i], right[i]) ? if_true[i] : if_false[i] to sink(i, value)
+    // for each of n lanes. Both values are loaded before the comparison,
+    // so the selection has no data dependent branch and it is vectorized as blend.
+    // The loop with unit strides is separated, it is the case of array operands.
+    template <class Scalar, class Compare, class Sink>
+    inline void select_lanes(
+        size_t n
+        , const lane_ref<Scalar>& left
+        , const lane_ref<Scalar>& right
+        , const lane_ref<Scalar>& if_true
+        , const lane_ref<Scalar>& if_false
+        , Compare cmp
+        , Sink sink)
+    {
+        if (left.stride_ == 1 && right.stride_ == 1 && if_true.stride_ == 1 && if_false.stride_ == 1)
+        {
+            const Scalar* l = left.ptr_;
+            const Scalar* r = right.ptr_;
+            const Scalar* t = if_true.ptr_;
+            const Scalar* f = if_false.ptr_;
+            for (size_t i = 0; i < n; i++)
+            {
+                const Scalar tv = t[i];
+                const Scalar fv = f[i];
+                sink(i, cmp(l[i], r[i]) ? tv : fv);
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const Scalar tv = if_true[i];
+            const Scalar fv = if_false[i];
+            sink(i, cmp(left[i], right[i]) ? tv : fv);
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_lane_select_hpp
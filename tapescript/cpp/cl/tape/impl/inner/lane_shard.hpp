@@ -0,0 +1,481 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_lane_shard_hpp
+#define cl_tape_impl_inner_lane_shard_hpp
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <cl/tape/impl/detail/thread_local.hpp>
+#include <cl/tape/impl/inner/tape_inner.hpp>
+
+namespace cl
+{
+    /// <summary>Process wide pool of threads which run the shards of sweeps.
+    /// The shard i is always run by the worker i, the calling thread runs
+    /// shard zero, so the memory taken by a shard in parallel mode
+    /// is returned by the same thread. Runs are serialized, a run made
+    /// by a task of the pool runs its tasks on the calling thread.</summary>
+    class lane_thread_pool
+    {
+    public:
+        static lane_thread_pool& instance()
+        {
+            static lane_thread_pool pool;
+            return pool;
+        }
+
+        ~lane_thread_pool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (std::thread& worker : workers_)
+            {
+                worker.join();
+            }
+        }
+
+        // Runs task(i) for i < count, task(0) on the calling thread,
+        // and waits for all of them. The first exception is rethrown.
+        void run(size_t count, std::function<void(size_t)> const& task)
+        {
+            // the workers are busy with the outer run
+            if (running())
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    task(i);
+                }
+                return;
+            }
+
+            std::unique_lock<std::mutex> run_lock(run_mutex_);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (workers_.size() + 1 < count)
+                {
+                    workers_.emplace_back(&lane_thread_pool::work, this, workers_.size() + 1);
+                }
+                task_ = &task;
+                count_ = count;
+                pending_ = count - 1;
+                error_ = std::exception_ptr();
+                generation_++;
+                in_parallel_flag() = true;
+            }
+            wake_.notify_all();
+            execute(0);
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return pending_ == 0; });
+            in_parallel_flag() = false;
+            task_ = 0;
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+        }
+
+        // True while shards are run, in the form required by CppAD::thread_alloc.
+        static bool in_parallel()
+        {
+            return in_parallel_flag();
+        }
+
+        // Index of the shard run by the calling thread, zero outside of the pool.
+        static size_t thread_num()
+        {
+            return thread_index();
+        }
+
+        // True if the calling thread runs a task of the pool.
+        static bool running()
+        {
+            return running_flag();
+        }
+
+    private:
+        lane_thread_pool()
+            : stop_(false)
+            , task_(0)
+            , count_(0)
+            , pending_(0)
+            , generation_(0)
+        {}
+
+        static std::atomic<bool>& in_parallel_flag()
+        {
+            static std::atomic<bool> flag(false);
+            return flag;
+        }
+
+        static size_t& thread_index()
+        {
+            static CL_THREAD_LOCAL size_t index = 0;
+            return index;
+        }
+
+        static bool& running_flag()
+        {
+            static CL_THREAD_LOCAL bool flag = false;
+            return flag;
+        }
+
+        void execute(size_t index)
+        {
+            running_flag() = true;
+            try
+            {
+                (*task_)(index);
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!error_)
+                {
+                    error_ = std::current_exception();
+                }
+            }
+            running_flag() = false;
+        }
+
+        void work(size_t index)
+        {
+            thread_index() = index;
+            size_t generation = 0;
+            for (;;)
+            {
+                bool active = false;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [&] { return stop_ || generation_ != generation; });
+                    if (stop_)
+                    {
+                        return;
+                    }
+                    generation = generation_;
+                    active = index < count_;
+                }
+
+                if (active)
+                {
+                    execute(index);
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (--pending_ == 0)
+                    {
+                        done_.notify_one();
+                    }
+                }
+            }
+        }
+
+        std::mutex run_mutex_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::vector<std::thread> workers_;
+        bool stop_;
+        std::function<void(size_t)> const* task_;
+        size_t count_;
+        size_t pending_;
+        size_t generation_;
+        std::exception_ptr error_;
+    };
+
+    /// <summary>Lanes of Base values as seen by lane-sharded sweeps.
+    /// Base without lanes is not sharded.</summary>
+    template <class Base>
+    struct lane_shard_traits
+    {
+        // Lane count of x, zero if x has no lanes.
+        static size_t lane_count(const Base&) { return 0; }
+
+        // Lanes [begin, end) of x.
+        static Base slice(const Base& x, size_t, size_t) { return x; }
+
+        // Joins parts of lanes given by offsets.
+        static Base join(const std::vector<Base>& parts, const std::vector<size_t>&) { return parts[0]; }
+    };
+
+    template <class Array>
+    struct is_fixed_lane_array : std::false_type {};
+
+    template <class Scalar, size_t N>
+    struct is_fixed_lane_array<std::array<Scalar, N>> : std::true_type {};
+
+    /// <summary>Arrays and broadcasts of tape_inner are split to the shards,
+    /// scalars are the same in all shards. The lane count of fixed size
+    /// arrays cannot be changed, so they are not sharded.</summary>
+    template <class Array>
+    struct lane_shard_traits<tape_inner<Array>>
+    {
+        typedef tape_inner<Array> inner_type;
+
+        static size_t lane_count(const inner_type& x)
+        {
+            if (is_fixed_lane_array<Array>::value || (!x.is_array() && !x.is_broadcast()))
+            {
+                return 0;
+            }
+            return x.size();
+        }
+
+        static inner_type slice(const inner_type& x, size_t begin, size_t end)
+        {
+            if (x.is_broadcast())
+            {
+                return inner_type::broadcast(x.scalar_value_, end - begin);
+            }
+            if (x.is_scalar())
+            {
+                return x;
+            }
+            return inner_type(&x.array_value_[begin], end - begin);
+        }
+
+        // Scalar parts are expanded to the lanes of their shards,
+        // the result is scalar if no part has lanes.
+        static inner_type join(const std::vector<inner_type>& parts, const std::vector<size_t>& offsets)
+        {
+            bool has_lanes = false;
+            for (const inner_type& part : parts)
+            {
+                has_lanes = has_lanes || lane_count(part) > 0;
+            }
+            if (!has_lanes)
+            {
+                return parts[0];
+            }
+
+            inner_type result(typename inner_type::scalar_type(), offsets.back());
+            typename inner_type::scalar_type* z = result.begin();
+            for (size_t k = 0; k < parts.size(); k++)
+            {
+                const inner_type& part = parts[k];
+                size_t count = offsets[k + 1] - offsets[k];
+                if (part.is_array())
+                {
+                    if (part.size() != count)
+                    {
+                        cl::throw_("Lane count of shard value does not match the shard.");
+                    }
+                    std::copy(part.begin(), part.begin() + count, z + offsets[k]);
+                }
+                else
+                {
+                    std::fill(z + offsets[k], z + offsets[k] + count, part.scalar_value_);
+                }
+            }
+            return result;
+        }
+    };
+
+    /// <summary>State shared by the shards of one sweep. Atomic functions
+    /// which mix lanes exchange their arguments here: all shards have to
+    /// make the same sequence of exchanges, each exchange is a barrier
+    /// for all shards.</summary>
+    template <class Base>
+    class lane_shard_sweep
+    {
+    public:
+        typedef lane_shard_traits<Base> traits;
+        typedef std::function<Base(const Base&)> transform_type;
+
+        explicit lane_shard_sweep(std::vector<size_t> const& offsets)
+            : offsets_(offsets)
+            , parts_(offsets.size() - 1)
+            , arrived_(0)
+            , finished_(0)
+            , generation_(0)
+            , broken_(false)
+        {}
+
+        size_t count() const { return parts_.size(); }
+
+        // Lane count of all shards.
+        size_t total_lanes() const { return offsets_.back(); }
+
+        // Lane count of the shard.
+        size_t lanes(size_t shard) const { return offsets_[shard + 1] - offsets_[shard]; }
+
+        // Returns sum of x over all shards.
+        Base sum(size_t shard, const Base& x)
+        {
+            parts_[shard] = x;
+            wait();
+            if (shard == 0)
+            {
+                result_ = parts_[0];
+                for (size_t k = 1; k < parts_.size(); k++)
+                {
+                    result_ = result_ + parts_[k];
+                }
+            }
+            wait();
+            return result_;
+        }
+
+        // Joins lanes of x from all shards, applies func
+        // and returns the lanes of the shard of the result.
+        Base transform(size_t shard, const Base& x, transform_type const& func)
+        {
+            parts_[shard] = x;
+            wait();
+            if (shard == 0)
+            {
+                result_ = func(traits::join(parts_, offsets_));
+            }
+            wait();
+            return traits::slice(result_, offsets_[shard], offsets_[shard + 1]);
+        }
+
+        // Called by each shard after its sweep, the shards
+        // which still wait for an exchange are failed.
+        void finish()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            finished_++;
+            if (arrived_ > 0)
+            {
+                broken_ = true;
+                changed_.notify_all();
+            }
+        }
+
+        // Fails the shards which wait for an exchange.
+        void abort()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            broken_ = true;
+            changed_.notify_all();
+        }
+
+    private:
+        // Waits until all shards arrive, shard zero computes
+        // the result between two waits.
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (broken_ || finished_ > 0)
+            {
+                broken_ = true;
+                changed_.notify_all();
+                cl::throw_("Shards of lane-sharded sweep made different exchanges.");
+            }
+            size_t generation = generation_;
+            if (++arrived_ == count())
+            {
+                arrived_ = 0;
+                generation_++;
+                changed_.notify_all();
+                return;
+            }
+            changed_.wait(lock, [&] { return broken_ || generation_ != generation; });
+            if (generation_ == generation)
+            {
+                cl::throw_("Shards of lane-sharded sweep made different exchanges.");
+            }
+        }
+
+        std::vector<size_t> offsets_;
+        std::vector<Base> parts_;
+        Base result_;
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        size_t arrived_;
+        size_t finished_;
+        size_t generation_;
+        bool broken_;
+    };
+
+    /// <summary>Makes the shard of a sweep current for the calling thread,
+    /// atomic functions which mix lanes use it to exchange their arguments.</summary>
+    template <class Base>
+    struct lane_shard_scope
+    {
+        lane_shard_scope(lane_shard_sweep<Base>& sweep, size_t shard)
+            : sweep_(sweep)
+            , shard_(shard)
+            , previous_(current())
+        {
+            current() = this;
+        }
+
+        ~lane_shard_scope()
+        {
+            current() = previous_;
+        }
+
+        // Shard of the calling thread, null if the sweep is not sharded.
+        static lane_shard_scope*& current()
+        {
+            static CL_THREAD_LOCAL lane_shard_scope* scope = 0;
+            return scope;
+        }
+
+        // Lane count of this shard and of all shards.
+        size_t lanes() const { return sweep_.lanes(shard_); }
+        size_t total_lanes() const { return sweep_.total_lanes(); }
+
+        // Returns sum of x over all shards.
+        Base sum(const Base& x) { return sweep_.sum(shard_, x); }
+
+        // Applies func to the lanes of x joined from all shards,
+        // returns the lanes of this shard of the result.
+        Base transform(const Base& x, typename lane_shard_sweep<Base>::transform_type const& func)
+        {
+            return sweep_.transform(shard_, x, func);
+        }
+
+    private:
+        lane_shard_scope(lane_shard_scope const&) = delete;
+        lane_shard_scope& operator=(lane_shard_scope const&) = delete;
+
+        lane_shard_sweep<Base>& sweep_;
+        size_t shard_;
+        lane_shard_scope* previous_;
+    };
+
+    namespace tapescript
+    {
+        // Throws if the calling thread runs a shard of lane-sharded sweep.
+        template <class Base>
+        inline void check_not_lane_sharded(const char* name)
+        {
+            if (lane_shard_scope<Base>::current())
+            {
+                cl::throw_(std::string(name) + " is not supported in lane-sharded sweeps.");
+            }
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_lane_shard_hpp
@@ -0,0 +1,214 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_shared_array_hpp
+#define cl_tape_impl_inner_shared_array_hpp
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+
+namespace cl
+{
+    /// <summary>Array with reference counted copy-on-write payload.
+    /// Used as Array parameter of tape_inner, so copies of tape_inner
+    /// to the player, Taylor coefficients and atomic arguments share
+    /// the elements until one of them is modified.</summary>
+    template <class Scalar>
+    class shared_array
+    {
+    public:
+        typedef Scalar value_type;
+        typedef size_t size_type;
+
+        shared_array()
+            : size_(0)
+        {}
+
+        // Array of count zero elements.
+        explicit shared_array(size_t count)
+            : shared_array(Scalar(), count)
+        {}
+
+        // Array of count elements equal to val.
+        shared_array(const Scalar& val, size_t count)
+            : shared_array()
+        {
+            allocate(count);
+            std::fill(data(), data() + size_, val);
+        }
+
+        // Array of count elements copied from ptr.
+        shared_array(const Scalar* ptr, size_t count)
+            : shared_array()
+        {
+            allocate(count);
+            std::copy(ptr, ptr + size_, data());
+        }
+
+        shared_array(std::initializer_list<Scalar> il)
+            : shared_array(il.begin(), il.size())
+        {}
+
+        // Copy shares the payload, it is copied on the first write.
+        shared_array(const shared_array&) = default;
+        shared_array& operator=(const shared_array&) = default;
+
+        shared_array(shared_array&& other)
+            : payload_(std::move(other.payload_))
+            , size_(other.size_)
+        {
+            other.size_ = 0;
+        }
+
+        shared_array& operator=(shared_array&& other)
+        {
+            if (this != &other)
+            {
+                payload_ = std::move(other.payload_);
+                size_ = other.size_;
+                other.size_ = 0;
+            }
+            return *this;
+        }
+
+        size_t size() const { return size_; }
+
+        // Returns true if the payload is not shared with other arrays.
+        bool unique() const { return payload_.use_count() <= 1; }
+
+        // Element access is read only, it never copies the payload.
+        const Scalar& operator[](size_t i) const { return data()[i]; }
+        const Scalar* begin() const { return data(); }
+        const Scalar* end() const { return data() + size_; }
+
+        // Returns the elements for writing, the shared payload is copied
+        // here once, so a kernel takes the pointer before its loop.
+        Scalar* mutable_data() { detach(); return data(); }
+
+        // Resizes the array and sets all elements to zero as valarray does,
+        // shared payload is released without copying.
+        void resize(size_t count)
+        {
+            if (count != size_ || !unique())
+            {
+                allocate(count);
+            }
+            std::fill(data(), data() + size_, Scalar());
+        }
+
+    private:
+        Scalar* data() const { return payload_.get(); }
+
+        // Makes own payload for count elements, the values are not set.
+        void allocate(size_t count)
+        {
+            if (count > 0)
+            {
+                payload_.reset(new Scalar[count], std::default_delete<Scalar[]>());
+            }
+            else
+            {
+                payload_.reset();
+            }
+            size_ = count;
+        }
+
+        // Copies the payload if it is shared.
+        void detach()
+        {
+            if (!unique())
+            {
+                const std::shared_ptr<Scalar> previous = payload_;
+                allocate(size_);
+                std::copy(previous.get(), previous.get() + size_, data());
+            }
+        }
+
+        std::shared_ptr<Scalar> payload_;
+        size_t size_;
+    };
+
+    // Elementwise arithmetic operations.
+#define CL_SHARED_ARRAY_OPERATOR(Op)                                                            \
+    template <class Scalar>                                                                     \
+    inline shared_array<Scalar> operator Op(                                                    \
+        const shared_array<Scalar>& x                                                           \
+        , const shared_array<Scalar>& y)                                                        \
+    {                                                                                           \
+        shared_array<Scalar> result(x.size());                                                  \
+        Scalar* z = result.mutable_data();                                                             \
+        for (size_t i = 0; i < x.size(); i++)                                                   \
+        {                                                                                       \
+            z[i] = x[i] Op y[i];                                                                \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar>                                                                     \
+    inline shared_array<Scalar> operator Op(                                                    \
+        const shared_array<Scalar>& x                                                           \
+        , const typename shared_array<Scalar>::value_type& y)                                   \
+    {                                                                                           \
+        shared_array<Scalar> result(x.size());                                                  \
+        Scalar* z = result.mutable_data();                                                             \
+        for (size_t i = 0; i < x.size(); i++)                                                   \
+        {                                                                                       \
+            z[i] = x[i] Op y;                                                                   \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar>                                                                     \
+    inline shared_array<Scalar> operator Op(                                                    \
+        const typename shared_array<Scalar>::value_type& x                                      \
+        , const shared_array<Scalar>& y)                                                        \
+    {                                                                                           \
+        shared_array<Scalar> result(y.size());                                                  \
+        Scalar* z = result.mutable_data();                                                             \
+        for (size_t i = 0; i < y.size(); i++)                                                   \
+        {                                                                                       \
+            z[i] = x Op y[i];                                                                   \
+        }                                                                                       \
+        return result;                                                                          \
+    }
+
+    CL_SHARED_ARRAY_OPERATOR(-)
+    CL_SHARED_ARRAY_OPERATOR(*)
+    CL_SHARED_ARRAY_OPERATOR(/)
+    CL_SHARED_ARRAY_OPERATOR(+)
+#undef CL_SHARED_ARRAY_OPERATOR
+
+    template <class Scalar>
+    inline shared_array<Scalar> operator-(const shared_array<Scalar>& x)
+    {
+        shared_array<Scalar> result(x.size());
+        Scalar* z = result.mutable_data();
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            z[i] = -x[i];
+        }
+        return result;
+    }
+}
+
+#endif // cl_tape_impl_inner_shared_array_hpp
@@ -0,0 +1,461 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_simd_math_hpp
+#define cl_tape_impl_inner_simd_math_hpp
+
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   define CL_SIMD_MATH_X86
+#   include <immintrin.h>
+#   if defined _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
+namespace cl
+{
+    /// <summary>Vectorized exp, log, sqrt, sin, cos, tanh and pow over arrays of double.
+    /// Kernels are compiled for SSE2, AVX2 with FMA and AVX-512,
+    /// the widest one supported by the CPU is selected at runtime.
+    /// Arguments out of the range of the vector kernels are passed to libm.</summary>
+    namespace simd_math
+    {
+        enum level_type
+        {
+            scalar_level = 0
+            , sse2_level = 1
+            , avx2_level = 2
+            , avx512_level = 3
+        };
+
+        // Multipliers of the lane hash. The low and the high word of each lane
+        // are mixed with the lane position and multiplied, the products are summed,
+        // so the hash does not depend on the width of the vectors.
+        static const std::uint64_t hash_position_low = 0x9E3779B9ULL;
+        static const std::uint64_t hash_position_high = 0x85EBCA6BULL;
+        static const std::uint64_t hash_low = 0xC2B2AE35ULL;
+        static const std::uint64_t hash_high = 0x27D4EB2FULL;
+
+        // Hash of the lane at position i, negative zero is hashed as zero.
+        inline std::uint64_t hash_lane(double x, std::uint64_t i)
+        {
+            double v = x + 0.0;
+            std::uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            std::uint64_t low = std::uint32_t(bits + i * hash_position_low);
+            std::uint64_t high = std::uint32_t((bits >> 32) ^ (i * hash_position_high));
+            return low * hash_low + high * hash_high;
+        }
+
+        // Arguments of the sin and cos kernels, the reduction by pi / 2
+        // is exact for the quadrants below 2^20.
+        static const double sin_cos_limit = 1.0e5;
+
+        // Bound of y * log(x) in the pow kernel, the error of the
+        // double-double product grows with it.
+        static const double pow_exp_limit = 16.0;
+
+#if defined CL_SIMD_MATH_X86
+
+        namespace sse2
+        {
+            struct pack
+            {
+                typedef __m128d vec;
+                static const size_t width = 2;
+
+                static inline vec load(const double* x) { return _mm_loadu_pd(x); }
+                static inline void store(double* z, vec v) { _mm_storeu_pd(z, v); }
+                static inline vec set1(double v) { return _mm_set1_pd(v); }
+                static inline vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+                static inline vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+                static inline vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+                static inline vec div(vec a, vec b) { return _mm_div_pd(a, b); }
+                static inline vec sqrt(vec a) { return _mm_sqrt_pd(a); }
+
+                // a * b + c and c - a * b
+                static inline vec fmadd(vec a, vec b, vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+                static inline vec fnmadd(vec a, vec b, vec c) { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+
+                // a < b ? t : f
+                static inline vec select_lt(vec a, vec b, vec t, vec f)
+                {
+                    vec mask = _mm_cmplt_pd(a, b);
+                    return _mm_or_pd(_mm_and_pd(mask, t), _mm_andnot_pd(mask, f));
+                }
+
+                // True if lo <= v <= hi for all lanes, false for nan.
+                static inline bool all_in(vec v, double lo, double hi)
+                {
+                    vec mask = _mm_and_pd(_mm_cmpge_pd(v, _mm_set1_pd(lo)), _mm_cmple_pd(v, _mm_set1_pd(hi)));
+                    return _mm_movemask_pd(mask) == 0x3;
+                }
+
+                // Rounding to the nearest integer, |v| < 2^31.
+                static inline vec round(vec v) { return _mm_cvtepi32_pd(_mm_cvtpd_epi32(v)); }
+
+                // 2^n for integer n in the normal exponent range.
+                static inline vec pow2n(vec n)
+                {
+                    __m128i e = _mm_add_epi32(_mm_cvtpd_epi32(n), _mm_set1_epi32(1023));
+                    e = _mm_unpacklo_epi32(e, _mm_setzero_si128());
+                    return _mm_castsi128_pd(_mm_slli_epi64(e, 52));
+                }
+
+                // Exponent e and mantissa m in [0.5, 1) of positive normal v = m * 2^e.
+                static inline vec exponent(vec v)
+                {
+                    __m128i e = _mm_srli_epi64(_mm_castpd_si128(v), 52);
+                    e = _mm_shuffle_epi32(e, _MM_SHUFFLE(0, 0, 2, 0));
+                    return _mm_sub_pd(_mm_cvtepi32_pd(e), _mm_set1_pd(1022.0));
+                }
+
+                static inline vec mantissa(vec v)
+                {
+                    __m128d mask = _mm_castsi128_pd(_mm_set1_epi64x(0x000fffffffffffffLL));
+                    return _mm_or_pd(_mm_and_pd(v, mask), _mm_set1_pd(0.5));
+                }
+
+                // Integer lanes used by the hash.
+                typedef __m128i ivec;
+                static inline ivec bits(vec v) { return _mm_castpd_si128(v); }
+                static inline ivec iset1(std::uint64_t v) { return _mm_set1_epi64x((long long)v); }
+                static inline ivec iramp(std::uint64_t step) { return _mm_set_epi64x((long long)step, 0); }
+                static inline ivec iadd(ivec a, ivec b) { return _mm_add_epi64(a, b); }
+                static inline ivec ixor(ivec a, ivec b) { return _mm_xor_si128(a, b); }
+                static inline ivec ihigh(ivec a) { return _mm_srli_epi64(a, 32); }
+                // Product of the low words.
+                static inline ivec imul(ivec a, ivec b) { return _mm_mul_epu32(a, b); }
+                static inline void istore(std::uint64_t* z, ivec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(z), v); }
+            };
+
+#           include <cl/tape/impl/inner/simd_math_kernels.hpp>
+        }
+
+#   if defined __clang__
+#       pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#   elif defined __GNUC__
+#       pragma GCC push_options
+#       pragma GCC target("avx2,fma")
+#   endif
+
+        namespace avx2
+        {
+            struct pack
+            {
+                typedef __m256d vec;
+                static const size_t width = 4;
+
+                static inline vec load(const double* x) { return _mm256_loadu_pd(x); }
+                static inline void store(double* z, vec v) { _mm256_storeu_pd(z, v); }
+                static inline vec set1(double v) { return _mm256_set1_pd(v); }
+                static inline vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+                static inline vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+                static inline vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+                static inline vec div(vec a, vec b) { return _mm256_div_pd(a, b); }
+                static inline vec sqrt(vec a) { return _mm256_sqrt_pd(a); }
+
+                static inline vec fmadd(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+                static inline vec fnmadd(vec a, vec b, vec c) { return _mm256_fnmadd_pd(a, b, c); }
+
+                static inline vec select_lt(vec a, vec b, vec t, vec f)
+                {
+                    return _mm256_blendv_pd(f, t, _mm256_cmp_pd(a, b, _CMP_LT_OQ));
+                }
+
+                static inline bool all_in(vec v, double lo, double hi)
+                {
+                    vec mask = _mm256_and_pd(
+                        _mm256_cmp_pd(v, _mm256_set1_pd(lo), _CMP_GE_OQ)
+                        , _mm256_cmp_pd(v, _mm256_set1_pd(hi), _CMP_LE_OQ));
+                    return _mm256_movemask_pd(mask) == 0xF;
+                }
+
+                static inline vec round(vec v)
+                {
+                    return _mm256_round_pd(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+
+                static inline vec pow2n(vec n)
+                {
+                    __m128i e = _mm_add_epi32(_mm256_cvtpd_epi32(n), _mm_set1_epi32(1023));
+                    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepi32_epi64(e), 52));
+                }
+
+                static inline vec exponent(vec v)
+                {
+                    __m256i e = _mm256_srli_epi64(_mm256_castpd_si256(v), 52);
+                    e = _mm256_permutevar8x32_epi32(e, _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0));
+                    return _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(e)), _mm256_set1_pd(1022.0));
+                }
+
+                static inline vec mantissa(vec v)
+                {
+                    __m256d mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x000fffffffffffffLL));
+                    return _mm256_or_pd(_mm256_and_pd(v, mask), _mm256_set1_pd(0.5));
+                }
+
+                typedef __m256i ivec;
+                static inline ivec bits(vec v) { return _mm256_castpd_si256(v); }
+                static inline ivec iset1(std::uint64_t v) { return _mm256_set1_epi64x((long long)v); }
+                static inline ivec iramp(std::uint64_t step)
+                {
+                    return _mm256_set_epi64x((long long)(3 * step), (long long)(2 * step), (long long)step, 0);
+                }
+                static inline ivec iadd(ivec a, ivec b) { return _mm256_add_epi64(a, b); }
+                static inline ivec ixor(ivec a, ivec b) { return _mm256_xor_si256(a, b); }
+                static inline ivec ihigh(ivec a) { return _mm256_srli_epi64(a, 32); }
+                static inline ivec imul(ivec a, ivec b) { return _mm256_mul_epu32(a, b); }
+                static inline void istore(std::uint64_t* z, ivec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(z), v); }
+            };
+
+#           include <cl/tape/impl/inner/simd_math_kernels.hpp>
+        }
+
+#   if defined __clang__
+#       pragma clang attribute pop
+#       pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#   elif defined __GNUC__
+#       pragma GCC pop_options
+#       pragma GCC push_options
+#       pragma GCC target("avx512f")
+#   endif
+
+        namespace avx512
+        {
+            struct pack
+            {
+                typedef __m512d vec;
+                static const size_t width = 8;
+
+                static inline vec load(const double* x) { return _mm512_loadu_pd(x); }
+                static inline void store(double* z, vec v) { _mm512_storeu_pd(z, v); }
+                static inline vec set1(double v) { return _mm512_set1_pd(v); }
+                static inline vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+                static inline vec sub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+                static inline vec mul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+                static inline vec div(vec a, vec b) { return _mm512_div_pd(a, b); }
+                static inline vec sqrt(vec a) { return _mm512_sqrt_pd(a); }
+
+                static inline vec fmadd(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+                static inline vec fnmadd(vec a, vec b, vec c) { return _mm512_fnmadd_pd(a, b, c); }
+
+                static inline vec select_lt(vec a, vec b, vec t, vec f)
+                {
+                    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), f, t);
+                }
+
+                static inline bool all_in(vec v, double lo, double hi)
+                {
+                    __mmask8 mask = _mm512_cmp_pd_mask(v, _mm512_set1_pd(lo), _CMP_GE_OQ)
+                        & _mm512_cmp_pd_mask(v, _mm512_set1_pd(hi), _CMP_LE_OQ);
+                    return mask == 0xFF;
+                }
+
+                static inline vec round(vec v)
+                {
+                    return _mm512_roundscale_pd(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+
+                static inline vec pow2n(vec n)
+                {
+                    __m256i e = _mm256_add_epi32(_mm512_cvtpd_epi32(n), _mm256_set1_epi32(1023));
+                    return _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_cvtepi32_epi64(e), 52));
+                }
+
+                static inline vec exponent(vec v)
+                {
+                    __m512i e = _mm512_srli_epi64(_mm512_castpd_si512(v), 52);
+                    return _mm512_sub_pd(_mm512_cvtepi32_pd(_mm512_cvtepi64_epi32(e)), _mm512_set1_pd(1022.0));
+                }
+
+                static inline vec mantissa(vec v)
+                {
+                    __m512i bits = _mm512_and_si512(_mm512_castpd_si512(v), _mm512_set1_epi64(0x000fffffffffffffLL));
+                    bits = _mm512_or_si512(bits, _mm512_set1_epi64(0x3fe0000000000000LL));
+                    return _mm512_castsi512_pd(bits);
+                }
+
+                typedef __m512i ivec;
+                static inline ivec bits(vec v) { return _mm512_castpd_si512(v); }
+                static inline ivec iset1(std::uint64_t v) { return _mm512_set1_epi64((long long)v); }
+                static inline ivec iramp(std::uint64_t step)
+                {
+                    return _mm512_set_epi64((long long)(7 * step), (long long)(6 * step), (long long)(5 * step)
+                        , (long long)(4 * step), (long long)(3 * step), (long long)(2 * step), (long long)step, 0);
+                }
+                static inline ivec iadd(ivec a, ivec b) { return _mm512_add_epi64(a, b); }
+                static inline ivec ixor(ivec a, ivec b) { return _mm512_xor_si512(a, b); }
+                // the forms with all lanes set in the zero mask have no undefined
+                // source operand, which gcc reports as maybe uninitialized
+                static inline ivec ihigh(ivec a) { return _mm512_maskz_srli_epi64(0xFF, a, 32); }
+                static inline ivec imul(ivec a, ivec b) { return _mm512_maskz_mul_epu32(0xFF, a, b); }
+                static inline void istore(std::uint64_t* z, ivec v) { _mm512_storeu_si512(z, v); }
+            };
+
+#           include <cl/tape/impl/inner/simd_math_kernels.hpp>
+        }
+
+#   if defined __clang__
+#       pragma clang attribute pop
+#   elif defined __GNUC__
+#       pragma GCC pop_options
+#   endif
+
+        // Returns the widest instruction set supported by the CPU and OS.
+        inline level_type detect_level()
+        {
+#   if defined __GNUC__
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return avx512_level;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return avx2_level;
+            return sse2_level;
+#   elif defined _MSC_VER
+            int info[4];
+            __cpuid(info, 1);
+            bool fma = (info[2] & (1 << 12)) != 0;
+            bool os_save = (info[2] & (1 << 27)) != 0;
+            unsigned long long xcr0 = os_save ? _xgetbv(0) : 0;
+            __cpuidex(info, 7, 0);
+            if ((info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6)
+                return avx512_level;
+            if ((info[1] & (1 << 5)) != 0 && fma && (xcr0 & 0x6) == 0x6)
+                return avx2_level;
+            return sse2_level;
+#   else
+            return sse2_level;
+#   endif
+        }
+#endif // CL_SIMD_MATH_X86
+
+        // Level used by the array functions, detected on the first use.
+        inline level_type& current_level()
+        {
+#if defined CL_SIMD_MATH_X86
+            static level_type level = detect_level();
+#else
+            static level_type level = scalar_level;
+#endif
+            return level;
+        }
+
+        // Selects a narrower level, for example to compare the results.
+        inline void set_level(level_type level)
+        {
+#if defined CL_SIMD_MATH_X86
+            current_level() = level < detect_level() ? level : detect_level();
+#else
+            current_level() = scalar_level;
+#endif
+        }
+
+        // Array functions z[i] = f(x[i]), z can coincide with x.
+#if defined CL_SIMD_MATH_X86
+#   define CL_SIMD_MATH_FUNCTION(Name)                                                          \
+        inline void Name(double* z, const double* x, size_t n)                                  \
+        {                                                                                       \
+            switch (current_level())                                                            \
+            {                                                                                   \
+            case avx512_level: avx512::Name(z, x, n); return;                                   \
+            case avx2_level: avx2::Name(z, x, n); return;                                       \
+            case sse2_level: sse2::Name(z, x, n); return;                                       \
+            default: break;                                                                     \
+            }                                                                                   \
+            for (size_t i = 0; i < n; i++)                                                      \
+            {                                                                                   \
+                z[i] = std::Name(x[i]);                                                         \
+            }                                                                                   \
+        }
+#else
+#   define CL_SIMD_MATH_FUNCTION(Name)                                                          \
+        inline void Name(double* z, const double* x, size_t n)                                  \
+        {                                                                                       \
+            for (size_t i = 0; i < n; i++)                                                      \
+            {                                                                                   \
+                z[i] = std::Name(x[i]);                                                         \
+            }                                                                                   \
+        }
+#endif
+
+        CL_SIMD_MATH_FUNCTION(exp)
+        CL_SIMD_MATH_FUNCTION(log)
+        CL_SIMD_MATH_FUNCTION(sqrt)
+        CL_SIMD_MATH_FUNCTION(sin)
+        CL_SIMD_MATH_FUNCTION(cos)
+        CL_SIMD_MATH_FUNCTION(tanh)
+#undef CL_SIMD_MATH_FUNCTION
+
+        // Array function z[i] = pow(x[i * x_step], y[i * y_step]), the step
+        // is 1 for an array and 0 for a scalar, z can coincide with x or y.
+        inline void pow(double* z, const double* x, size_t x_step, const double* y, size_t y_step, size_t n)
+        {
+            switch (current_level())
+            {
+#if defined CL_SIMD_MATH_X86
+            case avx512_level: avx512::pow(z, x, x_step, y, y_step, n); return;
+            case avx2_level: avx2::pow(z, x, x_step, y, y_step, n); return;
+            case sse2_level: sse2::pow(z, x, x_step, y, y_step, n); return;
+#endif
+            default: break;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                z[i] = std::pow(x[i * x_step], y[i * y_step]);
+            }
+        }
+
+        // Hash of the array content, the same for all levels,
+        // so the arrays which compare equal have the same hash.
+        inline std::uint64_t hash(const double* x, size_t n)
+        {
+            std::uint64_t sum = 0;
+            switch (current_level())
+            {
+#if defined CL_SIMD_MATH_X86
+            case avx512_level: sum = avx512::hash_sum(x, n); break;
+            case avx2_level: sum = avx2::hash_sum(x, n); break;
+            case sse2_level: sum = sse2::hash_sum(x, n); break;
+#endif
+            default:
+                for (size_t i = 0; i < n; i++)
+                {
+                    sum += hash_lane(x[i], i);
+                }
+                break;
+            }
+
+            // final mixing of splitmix64
+            std::uint64_t h = sum ^ (std::uint64_t(n) * 0x9E3779B97F4A7C15ULL);
+            h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+            return h ^ (h >> 31);
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_simd_math_hpp
@@ -0,0 +1,436 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Approximations of exp and tanh are taken from Cephes Math Library,
+Copyright (C) 1984-2000 Stephen L. Moshier.
+
+Approximations of log, sin and cos are taken from fdlibm,
+Copyright (C) 1993 by Sun Microsystems, Inc. All rights reserved.
+Developed at SunSoft, a Sun Microsystems, Inc. business.
+Permission to use, copy, modify, and distribute this
+software is freely granted, provided that this notice
+is preserved.
+*/
+
+// Array kernels of simd_math for one instruction set.
+// This file has no include guard, it is included by simd_math.hpp
+// once per instruction set inside the namespace which defines
+// the pack structure with the vector operations.
+
+// Returns exp(v), v in [-708, 709].
+inline pack::vec exp_vec(pack::vec v)
+{
+    typedef pack::vec vec;
+
+    // exp(x) = 2^n * exp(r), |r| <= ln(2) / 2
+    vec fx = pack::round(pack::mul(v, pack::set1(1.4426950408889634073599)));
+    vec r = pack::fnmadd(fx, pack::set1(6.93145751953125E-1), v);
+    r = pack::fnmadd(fx, pack::set1(1.42860682030941723212E-6), r);
+
+    // exp(r) = 1 + 2 r P(r^2) / (Q(r^2) - r P(r^2))
+    vec rr = pack::mul(r, r);
+    vec p = pack::fmadd(pack::set1(1.26177193074810590878E-4), rr, pack::set1(3.02994407707441961300E-2));
+    p = pack::mul(r, pack::fmadd(p, rr, pack::set1(9.99999999999999999910E-1)));
+    vec q = pack::fmadd(pack::set1(3.00198505138664455042E-6), rr, pack::set1(2.52448340349684104192E-3));
+    q = pack::fmadd(q, rr, pack::set1(2.27265548208155028766E-1));
+    q = pack::fmadd(q, rr, pack::set1(2.00000000000000000009E0));
+
+    vec e = pack::div(p, pack::sub(q, p));
+    e = pack::fmadd(e, pack::set1(2.0), pack::set1(1.0));
+
+    return pack::mul(e, pack::pow2n(fx));
+}
+
+// Writes exp(x[i]) for one pack.
+inline void exp_block(const double* x, double* z)
+{
+    pack::vec v = pack::load(x);
+    if (!pack::all_in(v, -708.0, 709.0))
+    {
+        // large arguments, underflow and nan are left to libm
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            z[k] = std::exp(x[k]);
+        }
+        return;
+    }
+    pack::store(z, exp_vec(v));
+}
+
+// Writes log(x[i]) for one pack.
+inline void log_block(const double* x, double* z)
+{
+    typedef pack::vec vec;
+
+    vec v = pack::load(x);
+    if (!pack::all_in(v, std::numeric_limits<double>::min(), std::numeric_limits<double>::max()))
+    {
+        // non positive, denormal, infinite and nan arguments are left to libm
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            z[k] = std::log(x[k]);
+        }
+        return;
+    }
+
+    // x = (1 + f) * 2^e, 1 + f in [sqrt(1/2), sqrt(2)), log(x) = log(1 + f) + e * ln(2)
+    const vec one = pack::set1(1.0);
+    vec e = pack::exponent(v);
+    vec m = pack::mantissa(v);
+    const vec sqrth = pack::set1(0.70710678118654752440);
+    e = pack::sub(e, pack::select_lt(m, sqrth, one, pack::set1(0.0)));
+    vec f = pack::sub(pack::select_lt(m, sqrth, pack::add(m, m), m), one);
+
+    // log(1 + f) = f - (f^2 / 2 - s * (f^2 / 2 + R(s^2))), s = f / (2 + f)
+    vec s = pack::div(f, pack::add(f, pack::set1(2.0)));
+    vec ss = pack::mul(s, s);
+    vec r = pack::fmadd(pack::set1(1.479819860511658591e-01), ss, pack::set1(1.531383769920937332e-01));
+    r = pack::fmadd(r, ss, pack::set1(1.818357216161805012e-01));
+    r = pack::fmadd(r, ss, pack::set1(2.222219843214978396e-01));
+    r = pack::fmadd(r, ss, pack::set1(2.857142874366239149e-01));
+    r = pack::fmadd(r, ss, pack::set1(3.999999999940941908e-01));
+    r = pack::fmadd(r, ss, pack::set1(6.666666666666735130e-01));
+    r = pack::mul(r, ss);
+    vec hfsq = pack::mul(pack::set1(0.5), pack::mul(f, f));
+
+    // e * ln(2) is split to the high part exact in the product and the low part
+    vec result = pack::fmadd(s, pack::add(hfsq, r), pack::mul(e, pack::set1(1.90821492927058770002e-10)));
+    result = pack::sub(pack::sub(hfsq, result), f);
+    pack::store(z, pack::sub(pack::mul(e, pack::set1(6.93147180369123816490e-01)), result));
+}
+
+// Sum s + err = a + b without rounding error.
+inline void two_sum(pack::vec a, pack::vec b, pack::vec& s, pack::vec& err)
+{
+    s = pack::add(a, b);
+    pack::vec bb = pack::sub(s, a);
+    err = pack::add(pack::sub(a, pack::sub(s, bb)), pack::sub(b, bb));
+}
+
+// Product p + err = a * b without rounding error, |a|, |b| < 2^995,
+// the operands are split by Dekker as the fmadd of SSE2 is not fused.
+inline void two_prod(pack::vec a, pack::vec b, pack::vec& p, pack::vec& err)
+{
+    const pack::vec split = pack::set1(134217729.0);
+    pack::vec ca = pack::mul(a, split);
+    pack::vec ah = pack::sub(ca, pack::sub(ca, a));
+    pack::vec al = pack::sub(a, ah);
+    pack::vec cb = pack::mul(b, split);
+    pack::vec bh = pack::sub(cb, pack::sub(cb, b));
+    pack::vec bl = pack::sub(b, bh);
+    p = pack::mul(a, b);
+    err = pack::sub(pack::mul(ah, bh), p);
+    err = pack::add(err, pack::mul(ah, bl));
+    err = pack::add(err, pack::mul(al, bh));
+    err = pack::add(err, pack::mul(al, bl));
+}
+
+// Returns log(v) = hi + lo with the error much below the ulp of hi,
+// v is positive normal.
+inline pack::vec log_dd(pack::vec v, pack::vec& lo)
+{
+    typedef pack::vec vec;
+
+    // the reduction of log_block
+    const vec one = pack::set1(1.0);
+    vec e = pack::exponent(v);
+    vec m = pack::mantissa(v);
+    const vec sqrth = pack::set1(0.70710678118654752440);
+    e = pack::sub(e, pack::select_lt(m, sqrth, one, pack::set1(0.0)));
+    vec f = pack::sub(pack::select_lt(m, sqrth, pack::add(m, m), m), one);
+
+    vec s = pack::div(f, pack::add(f, pack::set1(2.0)));
+    vec ss = pack::mul(s, s);
+    vec r = pack::fmadd(pack::set1(1.479819860511658591e-01), ss, pack::set1(1.531383769920937332e-01));
+    r = pack::fmadd(r, ss, pack::set1(1.818357216161805012e-01));
+    r = pack::fmadd(r, ss, pack::set1(2.222219843214978396e-01));
+    r = pack::fmadd(r, ss, pack::set1(2.857142874366239149e-01));
+    r = pack::fmadd(r, ss, pack::set1(3.999999999940941908e-01));
+    r = pack::fmadd(r, ss, pack::set1(6.666666666666735130e-01));
+    r = pack::mul(r, ss);
+
+    // log(1 + f) = f - f^2 / 2 + s * (f^2 / 2 + R(s^2)), the first two terms are exact
+    vec hfsq;
+    vec hfsq_lo;
+    two_prod(pack::mul(pack::set1(0.5), f), f, hfsq, hfsq_lo);
+    vec a;
+    vec a_lo;
+    two_sum(f, pack::sub(pack::set1(0.0), hfsq), a, a_lo);
+    vec tail = pack::fmadd(s, pack::add(hfsq, r), pack::sub(a_lo, hfsq_lo));
+
+    // e * ln(2) with the high part exact in the product
+    vec hi;
+    vec hi_lo;
+    two_sum(pack::mul(e, pack::set1(6.93147180369123816490e-01)), a, hi, hi_lo);
+    tail = pack::add(tail, pack::fmadd(e, pack::set1(1.90821492927058770002e-10), hi_lo));
+
+    vec sum = pack::add(hi, tail);
+    lo = pack::sub(tail, pack::sub(sum, hi));
+    return sum;
+}
+
+// Writes pow(x[i], y[i]) for one pack.
+inline void pow_block(const double* x, const double* y, double* z)
+{
+    typedef pack::vec vec;
+
+    vec vx = pack::load(x);
+    vec vy = pack::load(y);
+    bool in_range = pack::all_in(vx, std::numeric_limits<double>::min(), std::numeric_limits<double>::max())
+        && pack::all_in(vy, -1.0e15, 1.0e15);
+
+    // pow(x, y) = exp(y * log(x)), the product is kept in double-double
+    vec p;
+    vec p_lo;
+    if (in_range)
+    {
+        vec l_lo;
+        vec l = log_dd(vx, l_lo);
+        two_prod(vy, l, p, p_lo);
+        p_lo = pack::fmadd(vy, l_lo, p_lo);
+        in_range = pack::all_in(p, -pow_exp_limit, pow_exp_limit);
+    }
+    if (!in_range)
+    {
+        // negative bases, large results, large exponents and nan are left to libm
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            z[k] = std::pow(x[k], y[k]);
+        }
+        return;
+    }
+
+    // exp(p + p_lo) = exp(p) * (1 + p_lo)
+    vec e = exp_vec(p);
+    pack::store(z, pack::fmadd(e, p_lo, e));
+}
+
+// Writes sin(x[i]) or cos(x[i]) for one pack, quadrant is 0 for sin and 1 for cos.
+template <int Quadrant>
+inline void sin_cos_block(const double* x, double* z)
+{
+    typedef pack::vec vec;
+
+    vec v = pack::load(x);
+    if (!pack::all_in(v, -sin_cos_limit, sin_cos_limit))
+    {
+        // large arguments, infinity and nan are left to libm
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            z[k] = Quadrant == 0 ? std::sin(x[k]) : std::cos(x[k]);
+        }
+        return;
+    }
+
+    // x = n * pi / 2 + r, |r| <= pi / 4, pi / 2 is split to 33 bit parts
+    // so the products by n are exact
+    vec n = pack::round(pack::mul(v, pack::set1(6.36619772367581382433e-01)));
+    vec r = pack::fnmadd(n, pack::set1(1.57079632673412561417e+00), v);
+    r = pack::fnmadd(n, pack::set1(6.07710050630396597660e-11), r);
+    r = pack::fnmadd(n, pack::set1(2.02226624879595063154e-21), r);
+
+    // sin(r) = r + r^3 * S(r^2)
+    vec rr = pack::mul(r, r);
+    vec sp = pack::fmadd(pack::set1(1.58969099521155010221e-10), rr, pack::set1(-2.50507602534068634195e-08));
+    sp = pack::fmadd(sp, rr, pack::set1(2.75573137070700676789e-06));
+    sp = pack::fmadd(sp, rr, pack::set1(-1.98412698298579493134e-04));
+    sp = pack::fmadd(sp, rr, pack::set1(8.33333333332248946124e-03));
+    sp = pack::fmadd(sp, rr, pack::set1(-1.66666666666666324348e-01));
+    vec sin_r = pack::fmadd(pack::mul(rr, r), sp, r);
+
+    // cos(r) = 1 - r^2 / 2 + r^4 * C(r^2), the sum is made as in fdlibm
+    vec cp = pack::fmadd(pack::set1(-1.13596475577881948265e-11), rr, pack::set1(2.08757232129817482790e-09));
+    cp = pack::fmadd(cp, rr, pack::set1(-2.75573143513906633035e-07));
+    cp = pack::fmadd(cp, rr, pack::set1(2.48015872894767294178e-05));
+    cp = pack::fmadd(cp, rr, pack::set1(-1.38888888888741095749e-03));
+    cp = pack::fmadd(cp, rr, pack::set1(4.16666666666666019037e-02));
+    vec hz = pack::mul(pack::set1(0.5), rr);
+    vec w = pack::sub(pack::set1(1.0), hz);
+    vec cos_r = pack::add(w, pack::fmadd(pack::mul(rr, rr), cp, pack::sub(pack::sub(pack::set1(1.0), w), hz)));
+
+    // quadrant j = (n + Quadrant) mod 4 from the fraction of (n + Quadrant) / 4,
+    // its square is 0, 1/16, 1/4, 1/16 for j = 0, 1, 2, 3
+    const vec zero = pack::set1(0.0);
+    const vec one = pack::set1(1.0);
+    vec t = pack::mul(pack::add(n, pack::set1(double(Quadrant))), pack::set1(0.25));
+    vec frac = pack::sub(t, pack::round(t));
+    vec ff = pack::mul(frac, frac);
+    vec odd = pack::select_lt(ff, pack::set1(0.125), pack::select_lt(pack::set1(0.03125), ff, one, zero), zero);
+    vec negative = pack::select_lt(pack::set1(0.125), ff, one, pack::select_lt(frac, zero, odd, zero));
+
+    vec result = pack::select_lt(pack::set1(0.5), odd, cos_r, sin_r);
+    pack::store(z, pack::select_lt(pack::set1(0.5), negative, pack::sub(zero, result), result));
+}
+
+// Writes tanh(x[i]) for one pack.
+inline void tanh_block(const double* x, double* z)
+{
+    typedef pack::vec vec;
+
+    vec v = pack::load(x);
+    if (!pack::all_in(v, -22.0, 22.0))
+    {
+        // the result is +-1 for large arguments, nan is left to libm
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            z[k] = std::tanh(x[k]);
+        }
+        return;
+    }
+
+    // tanh(x) = x + x^3 * P(x^2) / Q(x^2) for |x| < 0.625
+    const vec zero = pack::set1(0.0);
+    const vec one = pack::set1(1.0);
+    vec xx = pack::mul(v, v);
+    vec p = pack::fmadd(pack::set1(-9.64399179425052238628E-1), xx, pack::set1(-9.92877231001918586564E1));
+    p = pack::fmadd(p, xx, pack::set1(-1.61468768441708447952E3));
+    vec q = pack::add(xx, pack::set1(1.12811678491632931402E2));
+    q = pack::fmadd(q, xx, pack::set1(2.23548839060100448583E3));
+    q = pack::fmadd(q, xx, pack::set1(4.84406305325125486048E3));
+    vec small = pack::fmadd(pack::mul(xx, v), pack::div(p, q), v);
+
+    // tanh(|x|) = 1 - 2 / (exp(2 |x|) + 1) otherwise
+    vec a = pack::select_lt(v, zero, pack::sub(zero, v), v);
+    vec large = pack::sub(one, pack::div(pack::set1(2.0), pack::add(exp_vec(pack::add(a, a)), one)));
+    large = pack::select_lt(v, zero, pack::sub(zero, large), large);
+
+    pack::store(z, pack::select_lt(a, pack::set1(0.625), small, large));
+}
+
+// Writes sqrt(x[i]) for one pack, the result is correctly rounded as libm one.
+inline void sqrt_block(const double* x, double* z)
+{
+    pack::store(z, pack::sqrt(pack::load(x)));
+}
+
+// Applies the block function to the array, the tail is processed
+// in a padded pack so all elements have the same rounding.
+template <void Block(const double*, double*)>
+inline void apply(double* z, const double* x, size_t n)
+{
+    size_t i = 0;
+    for (; i + pack::width <= n; i += pack::width)
+    {
+        Block(x + i, z + i);
+    }
+
+    if (i < n)
+    {
+        double buf[pack::width];
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            buf[k] = i + k < n ? x[i + k] : 1.0;
+        }
+        Block(buf, buf);
+        for (size_t k = 0; i + k < n; k++)
+        {
+            z[i + k] = buf[k];
+        }
+    }
+}
+
+// Applies the binary block function, an argument with zero step
+// is a scalar repeated for all elements.
+template <void Block(const double*, const double*, double*)>
+inline void apply(double* z, const double* x, size_t x_step, const double* y, size_t y_step, size_t n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    double xs[pack::width];
+    double ys[pack::width];
+    for (size_t k = 0; k < pack::width; k++)
+    {
+        xs[k] = x[0];
+        ys[k] = y[0];
+    }
+
+    size_t i = 0;
+    for (; i + pack::width <= n; i += pack::width)
+    {
+        Block(x_step ? x + i : xs, y_step ? y + i : ys, z + i);
+    }
+
+    if (i < n)
+    {
+        for (size_t k = 0; k < pack::width; k++)
+        {
+            xs[k] = i + k < n ? x[(i + k) * x_step] : 1.0;
+            ys[k] = i + k < n ? y[(i + k) * y_step] : 1.0;
+        }
+        Block(xs, ys, xs);
+        for (size_t k = 0; i + k < n; k++)
+        {
+            z[i + k] = xs[k];
+        }
+    }
+}
+
+inline void exp(double* z, const double* x, size_t n) { apply<exp_block>(z, x, n); }
+inline void log(double* z, const double* x, size_t n) { apply<log_block>(z, x, n); }
+inline void sqrt(double* z, const double* x, size_t n) { apply<sqrt_block>(z, x, n); }
+inline void sin(double* z, const double* x, size_t n) { apply<sin_cos_block<0> >(z, x, n); }
+inline void cos(double* z, const double* x, size_t n) { apply<sin_cos_block<1> >(z, x, n); }
+inline void tanh(double* z, const double* x, size_t n) { apply<tanh_block>(z, x, n); }
+
+inline void pow(double* z, const double* x, size_t x_step, const double* y, size_t y_step, size_t n)
+{
+    apply<pow_block>(z, x, x_step, y, y_step, n);
+}
+
+// Sum of hash_lane(x[i], i) over the array.
+inline std::uint64_t hash_sum(const double* x, size_t n)
+{
+    typedef pack::ivec ivec;
+
+    ivec sum = pack::iset1(0);
+    ivec low_position = pack::iramp(hash_position_low);
+    ivec high_position = pack::iramp(hash_position_high);
+    ivec low_step = pack::iset1(pack::width * hash_position_low);
+    ivec high_step = pack::iset1(pack::width * hash_position_high);
+    ivec low_factor = pack::iset1(hash_low);
+    ivec high_factor = pack::iset1(hash_high);
+
+    size_t i = 0;
+    for (; i + pack::width <= n; i += pack::width)
+    {
+        // adding zero turns negative zero to zero
+        ivec v = pack::bits(pack::add(pack::load(x + i), pack::set1(0.0)));
+        ivec low = pack::imul(pack::iadd(v, low_position), low_factor);
+        ivec high = pack::imul(pack::ixor(pack::ihigh(v), high_position), high_factor);
+        sum = pack::iadd(sum, pack::iadd(low, high));
+        low_position = pack::iadd(low_position, low_step);
+        high_position = pack::iadd(high_position, high_step);
+    }
+
+    std::uint64_t lanes[pack::width];
+    pack::istore(lanes, sum);
+    std::uint64_t result = 0;
+    for (size_t k = 0; k < pack::width; k++)
+    {
+        result += lanes[k];
+    }
+    for (; i < n; i++)
+    {
+        result += hash_lane(x[i], i);
+    }
+    return result;
+}
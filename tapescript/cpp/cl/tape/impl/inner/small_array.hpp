@@ -0,0 +1,238 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_small_array_hpp
+#define cl_tape_impl_inner_small_array_hpp
+
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+
+namespace cl
+{
+    /// <summary>Array with inline storage for up to N elements,
+    /// longer arrays are allocated on the heap. Used as Array parameter
+    /// of tape_inner, so the short arrays are stored inside tape_inner
+    /// and copying them does not allocate.</summary>
+    template <class Scalar, size_t N = 16>
+    class small_array
+    {
+    public:
+        typedef Scalar value_type;
+        typedef size_t size_type;
+
+        small_array()
+            : data_(buffer_)
+            , size_(0)
+            , capacity_(N)
+        {}
+
+        // Array of count zero elements.
+        explicit small_array(size_t count)
+            : small_array()
+        {
+            resize(count);
+        }
+
+        // Array of count elements equal to val.
+        small_array(const Scalar& val, size_t count)
+            : small_array()
+        {
+            reserve(count);
+            size_ = count;
+            std::fill(data_, data_ + size_, val);
+        }
+
+        // Array of count elements copied from ptr.
+        small_array(const Scalar* ptr, size_t count)
+            : small_array()
+        {
+            reserve(count);
+            size_ = count;
+            std::copy(ptr, ptr + size_, data_);
+        }
+
+        small_array(std::initializer_list<Scalar> il)
+            : small_array(il.begin(), il.size())
+        {}
+
+        small_array(const small_array& other)
+            : small_array(other.data_, other.size_)
+        {}
+
+        small_array(small_array&& other)
+            : small_array()
+        {
+            *this = std::move(other);
+        }
+
+        ~small_array()
+        {
+            if (data_ != buffer_)
+            {
+                delete[] data_;
+            }
+        }
+
+        // Heap storage of this array is reused if it is large enough.
+        small_array& operator=(const small_array& other)
+        {
+            if (this != &other)
+            {
+                reserve(other.size_);
+                size_ = other.size_;
+                std::copy(other.data_, other.data_ + size_, data_);
+            }
+            return *this;
+        }
+
+        // Heap storage of other is taken, inline elements are copied.
+        small_array& operator=(small_array&& other)
+        {
+            if (this == &other)
+            {
+                return *this;
+            }
+
+            if (other.data_ == other.buffer_)
+            {
+                reserve(other.size_);
+                size_ = other.size_;
+                std::copy(other.data_, other.data_ + size_, data_);
+            }
+            else
+            {
+                if (data_ != buffer_)
+                {
+                    delete[] data_;
+                }
+                data_ = other.data_;
+                capacity_ = other.capacity_;
+                size_ = other.size_;
+                other.data_ = other.buffer_;
+                other.capacity_ = N;
+            }
+            other.size_ = 0;
+            return *this;
+        }
+
+        size_t size() const { return size_; }
+
+        Scalar& operator[](size_t i) { return data_[i]; }
+        const Scalar& operator[](size_t i) const { return data_[i]; }
+
+        Scalar* begin() { return data_; }
+        const Scalar* begin() const { return data_; }
+        Scalar* end() { return data_ + size_; }
+        const Scalar* end() const { return data_ + size_; }
+
+        // Resizes the array and sets all elements to zero as valarray does.
+        void resize(size_t count)
+        {
+            reserve(count);
+            size_ = count;
+            std::fill(data_, data_ + size_, Scalar());
+        }
+
+    private:
+        // Makes storage for count elements, the previous values are not kept.
+        void reserve(size_t count)
+        {
+            if (count <= capacity_)
+            {
+                return;
+            }
+
+            Scalar* data = new Scalar[count];
+            if (data_ != buffer_)
+            {
+                delete[] data_;
+            }
+            data_ = data;
+            capacity_ = count;
+        }
+
+        Scalar* data_;
+        size_t size_;
+        size_t capacity_;
+        Scalar buffer_[N];
+    };
+
+    // Elementwise arithmetic operations.
+#define CL_SMALL_ARRAY_OPERATOR(Op)                                                             \
+    template <class Scalar, size_t N>                                                           \
+    inline small_array<Scalar, N> operator Op(                                                  \
+        const small_array<Scalar, N>& x                                                         \
+        , const small_array<Scalar, N>& y)                                                      \
+    {                                                                                           \
+        small_array<Scalar, N> result(x.size());                                                \
+        for (size_t i = 0; i < x.size(); i++)                                                   \
+        {                                                                                       \
+            result[i] = x[i] Op y[i];                                                           \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar, size_t N>                                                           \
+    inline small_array<Scalar, N> operator Op(                                                  \
+        const small_array<Scalar, N>& x                                                         \
+        , const typename small_array<Scalar, N>::value_type& y)                                 \
+    {                                                                                           \
+        small_array<Scalar, N> result(x.size());                                                \
+        for (size_t i = 0; i < x.size(); i++)                                                   \
+        {                                                                                       \
+            result[i] = x[i] Op y;                                                              \
+        }                                                                                       \
+        return result;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template <class Scalar, size_t N>                                                           \
+    inline small_array<Scalar, N> operator Op(                                                  \
+        const typename small_array<Scalar, N>::value_type& x                                    \
+        , const small_array<Scalar, N>& y)                                                      \
+    {                                                                                           \
+        small_array<Scalar, N> result(y.size());                                                \
+        for (size_t i = 0; i < y.size(); i++)                                                   \
+        {                                                                                       \
+            result[i] = x Op y[i];                                                              \
+        }                                                                                       \
+        return result;                                                                          \
+    }
+
+    CL_SMALL_ARRAY_OPERATOR(-)
+    CL_SMALL_ARRAY_OPERATOR(*)
+    CL_SMALL_ARRAY_OPERATOR(/)
+    CL_SMALL_ARRAY_OPERATOR(+)
+#undef CL_SMALL_ARRAY_OPERATOR
+
+    template <class Scalar, size_t N>
+    inline small_array<Scalar, N> operator-(const small_array<Scalar, N>& x)
+    {
+        small_array<Scalar, N> result(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            result[i] = -x[i];
+        }
+        return result;
+    }
+}
+
+#endif // cl_tape_impl_inner_small_array_hpp
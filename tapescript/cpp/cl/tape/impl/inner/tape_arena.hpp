@@ -0,0 +1,244 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_tape_arena_hpp
+#define cl_tape_impl_inner_tape_arena_hpp
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <cl/tape/impl/detail/thread_local.hpp>
+#include <cl/tape/impl/inner/tape_inner.hpp>
+
+namespace cl
+{
+    /// <summary>Pool of array storage owned by a tape function.
+    /// Base without array storage has nothing to pool.</summary>
+    template <class Base>
+    class tape_arena
+    {
+    public:
+        // Gives x storage for the lane count of model.
+        bool acquire(Base&, const Base&) { return false; }
+
+        // Takes array storage of x back to the pool.
+        void release(Base&) {}
+
+        // Takes array storage of x which is not used anymore.
+        void discard(Base&) {}
+
+        // Frees all pooled storage.
+        void clear() {}
+
+        // Returns the number of pooled arrays.
+        size_t size() const { return 0; }
+    };
+
+    /// <summary>Pool of tape_inner array storage in size classes keyed by lane count.
+    /// Storage released after a sweep is given to the work objects
+    /// of the next sweep, so the repeated sweeps of the same tape
+    /// do not allocate, the pool is freed together with the function.
+    /// In the compact layout a scalar cannot keep storage to take it from
+    /// the pool, so the released storage is freed and the pool stays empty.</summary>
+    template <class Array>
+    class tape_arena<tape_inner<Array>>
+    {
+    public:
+        typedef tape_inner<Array> inner_type;
+        typedef typename inner_type::array_type array_type;
+
+        // Gives x storage for the lane count of model.
+        // The value and mode of x are not changed, the storage
+        // is used when x becomes an array of this size.
+        // In the compact layout a scalar has no storage to take it.
+        // Returns false if model is scalar.
+        bool acquire(inner_type& x, const inner_type& model)
+        {
+            if (model.is_scalar())
+            {
+                return false;
+            }
+            if (!x.has_array_storage() || x.array_value_.size() == model.size())
+            {
+                return true;
+            }
+
+            auto it = pool_.find(model.size());
+            if (it == pool_.end() || it->second.empty())
+            {
+                return true;
+            }
+
+            array_type previous;
+            std::swap(previous, x.array_value_);
+            std::swap(x.array_value_, it->second.back());
+            it->second.pop_back();
+            store(previous);
+            return true;
+        }
+
+        // Takes array storage of x back to the pool.
+        // Have to be called only for objects which are not used anymore
+        // or which are scalars.
+        void release(inner_type& x)
+        {
+            if (!x.has_array_storage())
+            {
+                return;
+            }
+
+#if defined CL_TAPE_INNER_COMPACT
+            x.~inner_type();
+            new (&x) inner_type();
+#else
+            array_type previous;
+            std::swap(previous, x.array_value_);
+            if (x.is_array())
+            {
+                x.make_scalar();
+            }
+            store(previous);
+#endif
+        }
+
+        // Takes array storage of x which is not used anymore back to the pool
+        // for the next results.
+        void discard(inner_type& x)
+        {
+            release(x);
+        }
+
+        // Frees all pooled storage.
+        void clear()
+        {
+            pool_.clear();
+        }
+
+        // Returns the number of pooled arrays.
+        size_t size() const
+        {
+            size_t result = 0;
+            for (auto const& bucket : pool_)
+            {
+                result += bucket.second.size();
+            }
+            return result;
+        }
+
+    private:
+        // Puts not empty storage to the pool.
+        void store(array_type& x)
+        {
+            size_t count = x.size();
+            if (count == 0)
+            {
+                return;
+            }
+
+            std::vector<array_type>& bucket = pool_[count];
+            bucket.push_back(array_type());
+            std::swap(bucket.back(), x);
+        }
+
+        std::map<size_t, std::vector<array_type>> pool_;
+    };
+
+    /// <summary>Makes the arena current for the calling thread
+    /// while a tape function runs its sweeps.</summary>
+    template <class Base>
+    struct tape_arena_scope
+    {
+        explicit tape_arena_scope(tape_arena<Base>& arena)
+            : previous_(current())
+        {
+            current() = &arena;
+        }
+
+        ~tape_arena_scope()
+        {
+            current() = previous_;
+        }
+
+        // Arena of the calling thread, null if there is no one.
+        static tape_arena<Base>*& current()
+        {
+            static CL_THREAD_LOCAL tape_arena<Base>* arena = 0;
+            return arena;
+        }
+
+    private:
+        tape_arena_scope(tape_arena_scope const&) = delete;
+        tape_arena_scope& operator=(tape_arena_scope const&) = delete;
+
+        tape_arena<Base>* previous_;
+    };
+
+    namespace tapescript
+    {
+        // Gives x storage for the lane count of model from the current arena,
+        // returns false if model is scalar or there is no arena.
+        template <class Base>
+        inline bool arena_acquire(Base& x, const Base& model)
+        {
+            if (tape_arena<Base>* arena = tape_arena_scope<Base>::current())
+            {
+                return arena->acquire(x, model);
+            }
+            return false;
+        }
+
+        // Assigns value to x using storage from the current arena.
+        template <class Base>
+        inline void arena_assign(Base& x, const Base& value)
+        {
+            arena_acquire(x, value);
+            x = value;
+        }
+
+        // Takes array storage of the range back to the current arena.
+        template <class Base>
+        inline void arena_release(Base* begin, Base* end)
+        {
+            if (tape_arena<Base>* arena = tape_arena_scope<Base>::current())
+            {
+                for (; begin != end; ++begin)
+                {
+                    arena->release(*begin);
+                }
+            }
+        }
+
+        // Takes array storage of the range which is not used anymore
+        // to the current arena.
+        template <class Base>
+        inline void arena_discard(Base* begin, Base* end)
+        {
+            if (tape_arena<Base>* arena = tape_arena_scope<Base>::current())
+            {
+                for (; begin != end; ++begin)
+                {
+                    arena->discard(*begin);
+                }
+            }
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_tape_arena_hpp
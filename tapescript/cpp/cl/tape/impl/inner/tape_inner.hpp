@@ -30,6 +30,11 @@ limitations under the License.
 
 namespace cl
 {
+    namespace tapescript
+    {
+        template <class Expr> struct inner_expr;
+    }
+
     /// <summary>Class that aggregates a scalar value and an array value.
     /// Used as Base template parameter for CppAD::AD class.</summary>
     template <class Array>
@@ -45,47 +50,97 @@ namespace cl
             ScalarMode = 1 << 0
             , IntrusiveScalar = 1 << 1
             , ArrayMode = 1 << 2
+            , BroadcastMode = 1 << 3
         };
 
         // Default and scalar_type constructor.
         tape_inner(const scalar_type& val = scalar_type())
             : mode_(ScalarMode)
+            , broadcast_size_(0)
             , scalar_value_(val)
-            , array_value_()
         {}
 
-        tape_inner(const tape_inner&) = default;
+#if defined CL_TAPE_INNER_COMPACT
+        tape_inner(const tape_inner& other)
+            : mode_(other.mode_)
+            , broadcast_size_(other.broadcast_size_)
+        {
+            if (other.is_array())
+            {
+                new (&array_value_) array_type(other.array_value_);
+            }
+            else
+            {
+                scalar_value_ = other.scalar_value_;
+            }
+        }
 
         tape_inner(tape_inner&& other)
             : mode_(other.mode_)
+            , broadcast_size_(other.broadcast_size_)
+        {
+            if (other.is_array())
+            {
+                new (&array_value_) array_type(std::move(other.array_value_));
+            }
+            else
+            {
+                scalar_value_ = other.scalar_value_;
+            }
+        }
+
+        ~tape_inner()
+        {
+            if (is_array())
+            {
+                array_value_.~array_type();
+            }
+        }
+#else
+        // Array value is copied only in array mode.
+        tape_inner(const tape_inner& other)
+            : mode_(other.mode_)
+            , broadcast_size_(other.broadcast_size_)
+            , scalar_value_(other.scalar_value_)
+        {
+            if (other.is_array())
+            {
+                array_value_ = other.array_value_;
+            }
+        }
+
+        tape_inner(tape_inner&& other)
+            : mode_(other.mode_)
+            , broadcast_size_(other.broadcast_size_)
             , scalar_value_(std::move(other.scalar_value_))
             , array_value_(std::move(other.array_value_))
         {}
+#endif
 
         // Array mode is used for array value storage.
         tape_inner(const array_type& v)
             : mode_(ArrayMode)
-            , scalar_value_()
+            , broadcast_size_(0)
             , array_value_(v)
         {}
 
         tape_inner(array_type&& v)
             : mode_(ArrayMode)
-            , scalar_value_()
+            , broadcast_size_(0)
             , array_value_(std::move(v))
         {}
 
         // Construct as array with equal coefficients.
         tape_inner(const scalar_type& val, size_t count)
             : mode_(ArrayMode)
-            , scalar_value_()
+            , broadcast_size_(0)
             , array_value_(traits::make(val, count))
         {}
 
         // Construct as array with values passed by pointer.
         tape_inner(const scalar_type* ptr, size_t count)
             : mode_(ArrayMode)
-            , scalar_value_()
+            , broadcast_size_(0)
             , array_value_(traits::make(ptr, count))
         {}
 
@@ -94,26 +149,71 @@ namespace cl
             : tape_inner(il.begin(), il.size())
         {}
 
+        // Returns array of count lanes equal to val without array storage,
+        // scalar if count is zero.
+        static tape_inner broadcast(const scalar_type& val, size_t count)
+        {
+            tape_inner result(val);
+            result.set_broadcast(count);
+            return result;
+        }
+
+        // Construct from lazy elementwise expression, see tape_inner_expr.hpp.
+        template <class Expr>
+        tape_inner(const tapescript::inner_expr<Expr>& expr)
+            : tape_inner()
+        {
+            evaluate(*this, expr);
+        }
+
+        // Assignment of a scalar keeps array storage for the further use,
+        // assignment of an array of the same size reuses it.
         inline tape_inner& operator=(tape_inner const& other)
         {
-            mode_ = other.mode_;
-            scalar_value_ = other.scalar_value_;
-            array_value_ = other.array_value_;
+            if (other.is_array())
+            {
+                set_array_mode();
+                array_value_ = other.array_value_;
+            }
+            else
+            {
+                make_scalar(other.mode_);
+                broadcast_size_ = other.broadcast_size_;
+                scalar_value_ = other.scalar_value_;
+            }
             return *this;
         }
 
         inline tape_inner& operator=(tape_inner&& other)
         {
-            mode_ = other.mode_;
-            scalar_value_ = std::move(other.scalar_value_);
-            array_value_ = std::move(other.array_value_);
+            if (other.is_array())
+            {
+                set_array_mode();
+                array_value_ = std::move(other.array_value_);
+            }
+            else
+            {
+                make_scalar(other.mode_);
+                broadcast_size_ = other.broadcast_size_;
+                scalar_value_ = std::move(other.scalar_value_);
+            }
             return *this;
         }
 
-        // Returns true if scalar mode used (ordinary or intrusive).
+        // Evaluates lazy elementwise expression in one loop.
+        template <class Expr>
+        inline tape_inner& operator=(const tapescript::inner_expr<Expr>& expr)
+        {
+            evaluate(*this, expr);
+            return *this;
+        }
+
+        // Returns true if the value is stored as scalar (ordinary, intrusive or broadcast).
+        // Broadcast is a scalar for the elementwise operations,
+        // the operations on it keep its lane count.
         bool is_scalar() const
         {
-            return (mode_ & (ScalarMode | IntrusiveScalar)) != 0;
+            return (mode_ & (ScalarMode | IntrusiveScalar | BroadcastMode)) != 0;
         }
 
         // Returns true if array mode used.
@@ -122,6 +222,36 @@ namespace cl
             return !is_scalar();
         }
 
+        // Returns true if broadcast mode used.
+        bool is_broadcast() const
+        {
+            return mode_ == BroadcastMode;
+        }
+
+        // Switches ordinary scalar to broadcast of count lanes,
+        // zero count and other modes are not changed.
+        void set_broadcast(size_t count)
+        {
+            if (mode_ == ScalarMode && count > 0)
+            {
+                mode_ = BroadcastMode;
+                broadcast_size_ = static_cast<unsigned int>(count);
+            }
+        }
+
+        // Converts broadcast to array with storage.
+        void materialize()
+        {
+            if (is_broadcast())
+            {
+                const scalar_type val = scalar_value_;
+                const size_t count = broadcast_size_;
+                make_array(count);
+                scalar_type* z = array_data(array_value_);
+                std::fill(z, z + count, val);
+            }
+        }
+
         // Returns true if intrusive scalar mode used.
         bool is_intrusive() const
         {
@@ -159,7 +289,7 @@ namespace cl
         {
             if (is_scalar())
             {
-                return -scalar_value_;
+                return broadcast(-scalar_value_, broadcast_size_);
             }
             return tape_inner(-array_value_);
         }
@@ -170,12 +300,13 @@ namespace cl
         {
             if (is_scalar())
             {
-                return func(scalar_value_);
+                return broadcast(func(scalar_value_), broadcast_size_);
             }
-            array_type result(array_value_.size());
+            array_type result = traits::make(scalar_type(), array_value_.size());
+            scalar_type* z = array_data(result);
             for (size_type i = 0; i < result.size(); i++)
             {
-                result[i] = func(array_value_[i]);
+                z[i] = func(array_value_[i]);
             }
             return result;
         }
@@ -191,19 +322,13 @@ namespace cl
             else if (is_scalar() && right.is_scalar())                                          \
             {                                                                                   \
                 scalar_value_ Op##= right.scalar_value_;                                        \
+                set_broadcast(right.broadcast_size_);                                           \
             }                                                                                   \
-            else if (is_array() && right.is_scalar())                                           \
-            {                                                                                   \
-                array_value_ Op##= right.scalar_value_;                                         \
-            }                                                                                   \
-            else if (is_scalar() && right.is_array())                                           \
-            {                                                                                   \
-                array_value_ = scalar_value_ Op right.array_value_;                             \
-                mode_ = ArrayMode;                                                              \
-            }                                                                                   \
-            else if (is_array() && right.is_array())                                            \
+            else                                                                                \
             {                                                                                   \
-                array_value_ Op##= right.array_value_;                                          \
+                update_lanes(right, tape_inner()                                                \
+                    , [](scalar_type& z, const scalar_type& x, const scalar_type&)              \
+                    { z Op##= x; });                                                            \
             }                                                                                   \
             return *this;                                                                       \
         }
@@ -213,6 +338,118 @@ namespace cl
         CL_INNER_ARRAY_ASSIGN_OPERATOR(/)
 #undef CL_INNER_ARRAY_ASSIGN_OPERATOR
 
+        // Destination-aware kernels write the result into this object.
+        // Storage of array_value_ is reused if the array size is not changed,
+        // so repeated evaluation into the same Taylor slot does not allocate.
+        // Aliasing of the destination with the arguments is allowed.
+
+        // Assigns scalar value, array storage is kept for the further use.
+        inline void assign(const scalar_type& val)
+        {
+            make_scalar();
+            scalar_value_ = val;
+        }
+
+        // Assigns broadcast of count lanes, scalar if count is zero.
+        inline void assign_broadcast(const scalar_type& val, size_t count)
+        {
+            assign(val);
+            set_broadcast(count);
+        }
+
+        // Assigns x op y.
+#define CL_INNER_ARRAY_ASSIGN_KERNEL(Name, Op)                                                  \
+        inline void Name(const tape_inner& x, const tape_inner& y)                              \
+        {                                                                                       \
+            if (x.is_scalar() && y.is_scalar())                                                 \
+            {                                                                                   \
+                assign_broadcast(x.scalar_value_ Op y.scalar_value_, broadcast_size(x, y));     \
+                return;                                                                         \
+            }                                                                                   \
+            assign_lanes(x, y                                                                   \
+                , [](const scalar_type& a, const scalar_type& b) { return a Op b; });           \
+        }
+        CL_INNER_ARRAY_ASSIGN_KERNEL(assign_add, +)
+        CL_INNER_ARRAY_ASSIGN_KERNEL(assign_sub, -)
+        CL_INNER_ARRAY_ASSIGN_KERNEL(assign_mul, *)
+        CL_INNER_ARRAY_ASSIGN_KERNEL(assign_div, /)
+#undef CL_INNER_ARRAY_ASSIGN_KERNEL
+
+        // Changes sign of the value in place.
+        inline void negate()
+        {
+            if (is_scalar())
+            {
+                scalar_value_ = -scalar_value_;
+                return;
+            }
+            scalar_type* z = array_data(array_value_);
+            for (size_type i = 0; i < array_value_.size(); i++)
+            {
+                z[i] = -z[i];
+            }
+        }
+
+        // Adds a * x * y in a single pass.
+        inline void add_mul(const tape_inner& x, const tape_inner& y, const scalar_type& a = scalar_type(1))
+        {
+            if (is_intrusive())
+            {
+                scalar_value_ += dot(x, y, a);
+            }
+            else if (is_scalar() && x.is_scalar() && y.is_scalar())
+            {
+                scalar_value_ += a * x.scalar_value_ * y.scalar_value_;
+                set_broadcast(broadcast_size(x, y));
+            }
+            else
+            {
+                update_lanes(x, y
+                    , [&a](scalar_type& z, const scalar_type& u, const scalar_type& v)
+                    { z += a * u * v; });
+            }
+        }
+
+        // Subtracts a * x * y in a single pass.
+        inline void sub_mul(const tape_inner& x, const tape_inner& y, const scalar_type& a = scalar_type(1))
+        {
+            if (is_intrusive())
+            {
+                scalar_value_ -= dot(x, y, a);
+            }
+            else if (is_scalar() && x.is_scalar() && y.is_scalar())
+            {
+                scalar_value_ -= a * x.scalar_value_ * y.scalar_value_;
+                set_broadcast(broadcast_size(x, y));
+            }
+            else
+            {
+                update_lanes(x, y
+                    , [&a](scalar_type& z, const scalar_type& u, const scalar_type& v)
+                    { z -= a * u * v; });
+            }
+        }
+
+        // Adds x / (a * y) in a single pass.
+        inline void add_div(const tape_inner& x, const tape_inner& y, const scalar_type& a = scalar_type(1))
+        {
+            if (is_intrusive())
+            {
+                scalar_value_ += quot(x, y, a);
+            }
+            else if (is_scalar() && x.is_scalar() && y.is_scalar())
+            {
+                scalar_value_ += x.scalar_value_ / (a * y.scalar_value_);
+                set_broadcast(broadcast_size(x, y));
+            }
+            else
+            {
+                update_lanes(x, y
+                    , [&a](scalar_type& z, const scalar_type& u, const scalar_type& v)
+                    { z += u / (a * v); });
+            }
+        }
+
         // Gives the element of an array by the index.
         // If the object is array valued returns an element of the array value.
         // Othervise returns scalar value.
@@ -228,6 +465,10 @@ namespace cl
 
         scalar_type sum() const
         {
+            if (is_broadcast())
+            {
+                return scalar_value_ * broadcast_size_;
+            }
             if (is_scalar())
             {
                 return scalar_value_;
@@ -243,22 +484,31 @@ namespace cl
         // Returns size of array value.
         size_t size() const
         {
+            if (is_broadcast())
+            {
+                return broadcast_size_;
+            }
             CL_ASSERT(is_array(), "Have to be an array.");
             size_type temp = array_value_.size();
             CL_ASSERT(temp >= 0, "");
             return (size_t)temp;
         }
 
+        // Resizes the array and sets all elements to zero.
         void resize(size_t size)
         {
-            mode_ = ArrayMode;
-            array_value_.resize(size);
+            set_array_mode();
+            traits::resize(array_value_, size);
+            scalar_type* z = array_data(array_value_);
+            std::fill(z, z + size, scalar_type());
         }
 
+        // Non-const access takes own storage of shared array once,
+        // the loops take begin() before the loop rather than the elements.
         scalar_type* begin()
         {
             CL_ASSERT(is_array(), "Have to be an array to take an iterator.");
-            return &array_value_[0];
+            return array_data(array_value_);
         }
 
         scalar_type const* begin() const
@@ -270,7 +520,7 @@ namespace cl
         scalar_type* end()
         {
             CL_ASSERT(is_array(), "Have to be an array to take an iterator.");
-            return &array_value_[0] + size();
+            return array_data(array_value_) + size();
         }
 
         scalar_type const* end() const
@@ -282,7 +532,7 @@ namespace cl
         scalar_type& operator[](size_t index)
         {
             CL_ASSERT(is_array(), "Have to be an array to access via [].");
-            return array_value_[index];
+            return array_data(array_value_)[index];
         }
 
         scalar_type const& operator[](size_t index) const
@@ -291,9 +541,213 @@ namespace cl
             return array_value_[index];
         }
 
+        // Switches to array mode with count lanes,
+        // storage is reused if the array size is not changed.
+        inline void make_array(size_t count)
+        {
+            set_array_mode();
+            traits::resize(array_value_, count);
+        }
+
+        // Switches to scalar mode, the scalar value is not set.
+        inline void make_scalar(Mode mode = ScalarMode)
+        {
+#if defined CL_TAPE_INNER_COMPACT
+            if (is_array())
+            {
+                array_value_.~array_type();
+            }
+#endif
+            mode_ = mode;
+            broadcast_size_ = 0;
+        }
+
+        // Returns lane count of broadcast argument, zero if there is no one.
+        static inline size_t broadcast_size(const tape_inner& x, const tape_inner& y)
+        {
+            return x.broadcast_size_ ? x.broadcast_size_ : y.broadcast_size_;
+        }
+
+        // Returns true if array_value_ holds storage which can be reused,
+        // in the compact layout only array mode object has it.
+        bool has_array_storage() const
+        {
+#if defined CL_TAPE_INNER_COMPACT
+            return is_array();
+#else
+            return true;
+#endif
+        }
+
         Mode mode_;
-        scalar_type scalar_value_;
+
+        // Lane count in broadcast mode, zero in other modes.
+        // It takes the alignment padding after mode_.
+        unsigned int broadcast_size_;
+#if defined CL_TAPE_INNER_COMPACT
+        // Only the value of the current mode is alive,
+        // the array value is constructed on switch to array mode.
+        union
+        {
+            scalar_type scalar_value_;
+            array_type array_value_;
+        };
+#else
+        // Array storage is kept in scalar mode for the further use.
+        scalar_type scalar_value_ = scalar_type();
         array_type array_value_;
+#endif
+
+    private:
+        // Switches to array mode keeping the array value if it is alive.
+        inline void set_array_mode()
+        {
+#if defined CL_TAPE_INNER_COMPACT
+            if (is_scalar())
+            {
+                new (&array_value_) array_type();
+            }
+#endif
+            mode_ = ArrayMode;
+            broadcast_size_ = 0;
+        }
+
+        // Number of lanes of the result of an elementwise operation.
+        static inline size_t lanes(const tape_inner& x, const tape_inner& y)
+        {
+            return x.is_array() || x.is_broadcast() ? x.size() : y.size();
+        }
+
+        // Assigns func(x[i], y[i]) to each lane, at least one argument is an array.
+        template <class Func>
+        inline void assign_lanes(const tape_inner& x, const tape_inner& y, Func func)
+        {
+            const size_t n = lanes(x, y);
+            const scalar_type xs = x.is_scalar() ? x.scalar_value_ : scalar_type();
+            const scalar_type ys = y.is_scalar() ? y.scalar_value_ : scalar_type();
+            make_array(n);
+            if (n == 0)
+            {
+                return;
+            }
+
+            scalar_type* z = array_data(array_value_);
+            if (x.is_array() && y.is_array())
+            {
+                const scalar_type* xa = &x.array_value_[0];
+                const scalar_type* ya = &y.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    z[i] = func(xa[i], ya[i]);
+                }
+            }
+            else if (x.is_array())
+            {
+                const scalar_type* xa = &x.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    z[i] = func(xa[i], ys);
+                }
+            }
+            else
+            {
+                const scalar_type* ya = &y.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    z[i] = func(xs, ya[i]);
+                }
+            }
+        }
+
+        // Applies func(z[i], x[i], y[i]) to each lane of this not intrusive object,
+        // a scalar destination is broadcast to the lane count of the arguments.
+        template <class Func>
+        inline void update_lanes(const tape_inner& x, const tape_inner& y, Func func)
+        {
+            const scalar_type xs = x.is_scalar() ? x.scalar_value_ : scalar_type();
+            const scalar_type ys = y.is_scalar() ? y.scalar_value_ : scalar_type();
+            if (is_scalar())
+            {
+                const scalar_type zs = scalar_value_;
+                make_array(lanes(x, y));
+                scalar_type* z = array_data(array_value_);
+                std::fill(z, z + array_value_.size(), zs);
+            }
+
+            const size_t n = array_value_.size();
+            if (n == 0)
+            {
+                return;
+            }
+
+            scalar_type* z = array_data(array_value_);
+            if (x.is_array() && y.is_array())
+            {
+                const scalar_type* xa = &x.array_value_[0];
+                const scalar_type* ya = &y.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    func(z[i], xa[i], ya[i]);
+                }
+            }
+            else if (x.is_array())
+            {
+                const scalar_type* xa = &x.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    func(z[i], xa[i], ys);
+                }
+            }
+            else if (y.is_array())
+            {
+                const scalar_type* ya = &y.array_value_[0];
+                for (size_t i = 0; i < n; i++)
+                {
+                    func(z[i], xs, ya[i]);
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    func(z[i], xs, ys);
+                }
+            }
+        }
+
+        // Returns sum of a * x[i] * y[i] over lanes.
+        static inline scalar_type dot(const tape_inner& x, const tape_inner& y, const scalar_type& a)
+        {
+            if (x.is_scalar() && y.is_scalar())
+            {
+                const scalar_type result = a * x.scalar_value_ * y.scalar_value_;
+                const size_t count = broadcast_size(x, y);
+                return count ? result * count : result;
+            }
+            scalar_type result = 0.0;
+            for (size_t i = 0; i < lanes(x, y); i++)
+            {
+                result += a * x.element_at(i) * y.element_at(i);
+            }
+            return result;
+        }
+
+        // Returns sum of x[i] / (a * y[i]) over lanes.
+        static inline scalar_type quot(const tape_inner& x, const tape_inner& y, const scalar_type& a)
+        {
+            if (x.is_scalar() && y.is_scalar())
+            {
+                const scalar_type result = x.scalar_value_ / (a * y.scalar_value_);
+                const size_t count = broadcast_size(x, y);
+                return count ? result * count : result;
+            }
+            scalar_type result = 0.0;
+            for (size_t i = 0; i < lanes(x, y); i++)
+            {
+                result += x.element_at(i) / (a * y.element_at(i));
+            }
+            return result;
+        }
     };
 
 
@@ -301,6 +755,12 @@ namespace cl
     template <class Array>
     inline std::ostream& operator<<(std::ostream& os, const tape_inner<Array>& x)
     {
+        if (x.is_broadcast())
+        {
+            tape_inner<Array> array(x);
+            array.materialize();
+            return os << array;
+        }
         if (x.is_scalar())
         {
             return os << x.scalar_value_;
@@ -332,7 +792,8 @@ namespace cl
     {                                                                                           \
         if (x.is_scalar() && y.is_scalar())                                                     \
         {                                                                                       \
-            return x.scalar_value_ Op y.scalar_value_;                                          \
+            return tape_inner<Array>::broadcast(x.scalar_value_ Op y.scalar_value_              \
+                , tape_inner<Array>::broadcast_size(x, y));                                     \
         }                                                                                       \
         else if (x.is_array() && y.is_scalar())                                                 \
         {                                                                                       \
@@ -355,7 +816,7 @@ namespace cl
     {                                                                                           \
         if (x.is_scalar())                                                                      \
         {                                                                                       \
-            return x.scalar_value_ Op y;                                                        \
+            return tape_inner<Array>::broadcast(x.scalar_value_ Op y, x.broadcast_size_);       \
         }                                                                                       \
         return tape_inner<Array>(x.array_value_ Op y);                                          \
     }                                                                                           \
@@ -367,7 +828,7 @@ namespace cl
     {                                                                                           \
         if (y.is_scalar())                                                                      \
         {                                                                                       \
-            return x Op y.scalar_value_;                                                        \
+            return tape_inner<Array>::broadcast(x Op y.scalar_value_, y.broadcast_size_);       \
         }                                                                                       \
         return tape_inner<Array>(x Op y.array_value_);                                          \
     }
@@ -475,9 +936,22 @@ namespace cl
         {                                                                                       \
             if (x.is_scalar())                                                                  \
             {                                                                                   \
-                return std::Name(x.scalar_value_);                                              \
+                return cl::tape_inner<Array>::broadcast(                                        \
+                    std::Name(x.scalar_value_), x.broadcast_size_);                             \
             }                                                                                   \
             return cl::tape_inner<Array>::traits::Name(x.array_value_);                         \
+        }                                                                                       \
+                                                                                                \
+        template <class Array>                                                                  \
+        inline void Name(cl::tape_inner<Array>& result, const cl::tape_inner<Array>& x)         \
+        {                                                                                       \
+            if (x.is_scalar())                                                                  \
+            {                                                                                   \
+                result.assign_broadcast(std::Name(x.scalar_value_), x.broadcast_size_);         \
+                return;                                                                         \
+            }                                                                                   \
+            result.make_array(x.size());                                                        \
+            cl::tape_inner<Array>::traits::Name(result.array_value_, x.array_value_);           \
         }
         CL_INNER_ARRAY_FUNCTION(abs)
         CL_INNER_ARRAY_FUNCTION(acos)
@@ -501,16 +975,26 @@ namespace cl
 
             if (x.is_scalar())
             {
-                if (x.scalar_value_ > 0.)
-                    return scalar_type(1.0);
-                if (x.scalar_value_ == 0.)
-                    return scalar_type(0.0);
-                return scalar_type(-1.0);
+                const scalar_type value = x.scalar_value_ > 0. ? scalar_type(1.0)
+                    : (x.scalar_value_ == 0. ? scalar_type(0.0) : scalar_type(-1.0));
+                return cl::tape_inner<Array>::broadcast(value, x.broadcast_size_);
             }
 
             return cl::tape_inner<Array>::traits::sign(x.array_value_);
         }
 
+        template <class Array>
+        inline void sign(cl::tape_inner<Array>& result, const cl::tape_inner<Array>& x)
+        {
+            if (x.is_scalar())
+            {
+                result.assign_broadcast(sign(x).scalar_value_, x.broadcast_size_);
+                return;
+            }
+            result.make_array(x.size());
+            cl::tape_inner<Array>::traits::sign(result.array_value_, x.array_value_);
+        }
+
         // Math power functioon.
         template <class Array>
         inline cl::tape_inner<Array> pow(
@@ -520,7 +1004,8 @@ namespace cl
             typedef typename cl::tape_inner<Array>::traits traits;
             if (left.is_scalar() && right.is_scalar())
             {
-                return std::pow(left.scalar_value_, right.scalar_value_);
+                return cl::tape_inner<Array>::broadcast(std::pow(left.scalar_value_, right.scalar_value_)
+                    , cl::tape_inner<Array>::broadcast_size(left, right));
             }
             else if (left.is_array() && right.is_scalar())
             {
@@ -545,7 +1030,7 @@ namespace cl
             typedef typename cl::tape_inner<Array>::traits traits;
             if (left.is_scalar())
             {
-                return std::pow(left.scalar_value_, right);
+                return cl::tape_inner<Array>::broadcast(std::pow(left.scalar_value_, right), left.broadcast_size_);
             }
             return traits::pow(left.array_value_, right);
         }
@@ -559,18 +1044,52 @@ namespace cl
             typedef typename cl::tape_inner<Array>::traits traits;
             if (right.is_scalar())
             {
-                return std::pow(left, right.scalar_value_);
+                return cl::tape_inner<Array>::broadcast(std::pow(left, right.scalar_value_), right.broadcast_size_);
             }
             return traits::pow(left, right.array_value_);
         }
 
+        // Math power function, the result is written to result.
+        template <class Array>
+        inline void pow(
+            cl::tape_inner<Array>& result
+            , const cl::tape_inner<Array>& left
+            , const cl::tape_inner<Array>& right)
+        {
+            typedef typename cl::tape_inner<Array>::traits traits;
+            if (left.is_scalar() && right.is_scalar())
+            {
+                result.assign_broadcast(std::pow(left.scalar_value_, right.scalar_value_)
+                    , cl::tape_inner<Array>::broadcast_size(left, right));
+                return;
+            }
+            else if (left.is_array() && right.is_scalar())
+            {
+                const typename traits::scalar_type y = right.scalar_value_;
+                result.make_array(left.size());
+                traits::pow(result.array_value_, left.array_value_, y);
+            }
+            else if (left.is_scalar() && right.is_array())
+            {
+                const typename traits::scalar_type x = left.scalar_value_;
+                result.make_array(right.size());
+                traits::pow(result.array_value_, x, right.array_value_);
+            }
+            else // (left.is_array() && right.is_array())
+            {
+                result.make_array(left.size());
+                traits::pow(result.array_value_, left.array_value_, right.array_value_);
+            }
+        }
+
         template <class T>
         void set_intrusive(T& val, const T& model = T()){}
 
         template <class Array>
         void set_intrusive(tape_inner<Array>& val, const tape_inner<Array>& model = tape_inner<Array>())
         {
-            if (model.is_scalar())
+            // partial of broadcast has lanes
+            if (model.is_scalar() && !model.is_broadcast())
             {
                 val.set_intrusive();
             }
@@ -0,0 +1,348 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_inner_tape_inner_expr_hpp
+#define cl_tape_impl_inner_tape_inner_expr_hpp
+
+#include <cmath>
+#include <cl/tape/impl/inner/tape_inner.hpp>
+
+// Lazy elementwise expressions of tape_inner for the computations outside the tape.
+// An expression is started by lazy(x), the operators and math functions applied
+// to it build the expression tree and the whole chain is evaluated in one loop
+// when it is assigned to tape_inner, without the intermediate arrays:
+//
+//     z = lazy(x) * y + 2.0 * exp(lazy(w));
+//
+// Constants are scalars at compile time and are broadcast without the lane lookup,
+// the mode of tape_inner terminals is checked once before the loop.
+// Elements are computed by the same operations as the eager operators,
+// so the results are identical.
+
+namespace cl
+{
+    namespace tapescript
+    {
+        /// <summary>Base of the elementwise expressions over tape_inner.</summary>
+        template <class Expr>
+        struct inner_expr
+        {
+            const Expr& derived() const
+            {
+                return static_cast<const Expr&>(*this);
+            }
+        };
+
+        /// <summary>Expression terminal which refers to tape_inner,
+        /// a scalar and a broadcast are read with zero stride.</summary>
+        template <class Array>
+        struct inner_terminal : inner_expr<inner_terminal<Array>>
+        {
+            typedef tape_inner<Array> inner_type;
+            typedef typename inner_type::scalar_type scalar_type;
+
+            explicit inner_terminal(const inner_type& x)
+                : array_(x.is_array() || x.is_broadcast())
+                , size_(array_ ? x.size() : 0)
+                , stride_(x.is_array() ? 1 : 0)
+                , ptr_(x.is_array() && x.size() ? &x.array_value_[0] : &x.scalar_value_)
+            {}
+
+            bool is_array() const { return array_; }
+            bool is_dense() const { return stride_ == 1; }
+            bool is_uniform() const { return stride_ == 0; }
+            size_t size() const { return size_; }
+
+            scalar_type operator[](size_t i) const { return ptr_[i * stride_]; }
+            scalar_type dense(size_t i) const { return ptr_[i]; }
+
+        private:
+            bool array_;
+            size_t size_;
+            size_t stride_;
+            const scalar_type* ptr_;
+        };
+
+        /// <summary>Expression terminal which is a scalar at compile time.</summary>
+        template <class Array>
+        struct inner_constant : inner_expr<inner_constant<Array>>
+        {
+            typedef typename tape_inner<Array>::scalar_type scalar_type;
+
+            explicit inner_constant(const scalar_type& value)
+                : value_(value)
+            {}
+
+            bool is_array() const { return false; }
+            bool is_dense() const { return true; }
+            bool is_uniform() const { return true; }
+            size_t size() const { return 0; }
+
+            scalar_type operator[](size_t) const { return value_; }
+            scalar_type dense(size_t) const { return value_; }
+
+        private:
+            scalar_type value_;
+        };
+
+        /// <summary>Elementwise binary operation.</summary>
+        template <class Op, class Left, class Right>
+        struct inner_binary : inner_expr<inner_binary<Op, Left, Right>>
+        {
+            typedef typename Left::scalar_type scalar_type;
+
+            inner_binary(const Left& left, const Right& right)
+                : left_(left)
+                , right_(right)
+            {
+                if (left_.is_array() && right_.is_array() && left_.size() != right_.size())
+                {
+                    cl::throw_("Array sizes of the expression do not match");
+                }
+            }
+
+            bool is_array() const { return left_.is_array() || right_.is_array(); }
+            bool is_dense() const { return left_.is_dense() && right_.is_dense(); }
+            bool is_uniform() const { return left_.is_uniform() && right_.is_uniform(); }
+            size_t size() const { return left_.is_array() ? left_.size() : right_.size(); }
+
+            scalar_type operator[](size_t i) const { return Op::apply(left_[i], right_[i]); }
+            scalar_type dense(size_t i) const { return Op::apply(left_.dense(i), right_.dense(i)); }
+
+        private:
+            Left left_;
+            Right right_;
+        };
+
+        /// <summary>Elementwise unary operation.</summary>
+        template <class Op, class Arg>
+        struct inner_unary : inner_expr<inner_unary<Op, Arg>>
+        {
+            typedef typename Arg::scalar_type scalar_type;
+
+            explicit inner_unary(const Arg& arg)
+                : arg_(arg)
+            {}
+
+            bool is_array() const { return arg_.is_array(); }
+            bool is_dense() const { return arg_.is_dense(); }
+            bool is_uniform() const { return arg_.is_uniform(); }
+            size_t size() const { return arg_.size(); }
+
+            scalar_type operator[](size_t i) const { return Op::apply(arg_[i]); }
+            scalar_type dense(size_t i) const { return Op::apply(arg_.dense(i)); }
+
+        private:
+            Arg arg_;
+        };
+
+        // Starts lazy expression of x.
+        template <class Array>
+        inline inner_terminal<Array> lazy(const tape_inner<Array>& x)
+        {
+            return inner_terminal<Array>(x);
+        }
+
+        // Evaluates expression to z in one loop.
+        // Terminal referring to z is allowed, lanes are read before they are written.
+        template <class Array, class Expr>
+        inline void evaluate(tape_inner<Array>& z, const inner_expr<Expr>& expr)
+        {
+            typedef typename tape_inner<Array>::scalar_type scalar_type;
+            const Expr& e = expr.derived();
+
+            if (e.is_uniform())
+            {
+                // all lanes are equal, scalar result keeps the lane count
+                z.assign_broadcast(e[0], e.size());
+                return;
+            }
+
+            if (!z.has_array_storage())
+            {
+                // z can be referred by the expression, its scalar value
+                // is not kept after the array is constructed in its place
+                tape_inner<Array> result(scalar_type(), e.size());
+                evaluate(result, expr);
+                z = std::move(result);
+                return;
+            }
+
+            const size_t n = e.size();
+            z.make_array(n);
+            if (n == 0)
+            {
+                return;
+            }
+
+            scalar_type* result = cl::array_data(z.array_value_);
+            if (e.is_dense())
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    result[i] = e.dense(i);
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    result[i] = e[i];
+                }
+            }
+        }
+
+        // Array type of the expression.
+        template <class Expr>
+        struct inner_expr_array;
+
+        template <class Array>
+        struct inner_expr_array<inner_terminal<Array>> { typedef Array type; };
+
+        template <class Array>
+        struct inner_expr_array<inner_constant<Array>> { typedef Array type; };
+
+        template <class Op, class Left, class Right>
+        struct inner_expr_array<inner_binary<Op, Left, Right>> : inner_expr_array<Left> {};
+
+        template <class Op, class Arg>
+        struct inner_expr_array<inner_unary<Op, Arg>> : inner_expr_array<Arg> {};
+
+        // Elementwise operations.
+        struct inner_plus { template <class T> static T apply(const T& x, const T& y) { return x + y; } };
+        struct inner_minus { template <class T> static T apply(const T& x, const T& y) { return x - y; } };
+        struct inner_multiplies { template <class T> static T apply(const T& x, const T& y) { return x * y; } };
+        struct inner_divides { template <class T> static T apply(const T& x, const T& y) { return x / y; } };
+        struct inner_negate { template <class T> static T apply(const T& x) { return -x; } };
+
+        // Binary operators of expressions, tape_inner and scalars,
+        // at least one operand is an expression.
+#define CL_INNER_EXPR_OPERATOR(Op, Func)                                                        \
+        template <class Left, class Right>                                                      \
+        inline inner_binary<Func, Left, Right> operator Op(                                     \
+            const inner_expr<Left>& x                                                           \
+            , const inner_expr<Right>& y)                                                       \
+        {                                                                                       \
+            return inner_binary<Func, Left, Right>(x.derived(), y.derived());                   \
+        }                                                                                       \
+                                                                                                \
+        template <class Left, class Array>                                                      \
+        inline inner_binary<Func, Left, inner_terminal<Array>> operator Op(                     \
+            const inner_expr<Left>& x                                                           \
+            , const tape_inner<Array>& y)                                                       \
+        {                                                                                       \
+            return inner_binary<Func, Left, inner_terminal<Array>>(                             \
+                x.derived(), inner_terminal<Array>(y));                                         \
+        }                                                                                       \
+                                                                                                \
+        template <class Array, class Right>                                                     \
+        inline inner_binary<Func, inner_terminal<Array>, Right> operator Op(                    \
+            const tape_inner<Array>& x                                                          \
+            , const inner_expr<Right>& y)                                                       \
+        {                                                                                       \
+            return inner_binary<Func, inner_terminal<Array>, Right>(                            \
+                inner_terminal<Array>(x), y.derived());                                         \
+        }                                                                                       \
+                                                                                                \
+        template <class Left>                                                                   \
+        inline inner_binary<Func, Left                                                          \
+            , inner_constant<typename inner_expr_array<Left>::type>> operator Op(               \
+            const inner_expr<Left>& x                                                           \
+            , const typename Left::scalar_type& y)                                              \
+        {                                                                                       \
+            typedef inner_constant<typename inner_expr_array<Left>::type> constant;             \
+            return inner_binary<Func, Left, constant>(x.derived(), constant(y));                \
+        }                                                                                       \
+                                                                                                \
+        template <class Right>                                                                  \
+        inline inner_binary<Func                                                                \
+            , inner_constant<typename inner_expr_array<Right>::type>, Right> operator Op(       \
+            const typename Right::scalar_type& x                                                \
+            , const inner_expr<Right>& y)                                                       \
+        {                                                                                       \
+            typedef inner_constant<typename inner_expr_array<Right>::type> constant;            \
+            return inner_binary<Func, constant, Right>(constant(x), y.derived());               \
+        }
+
+        CL_INNER_EXPR_OPERATOR(+, inner_plus)
+        CL_INNER_EXPR_OPERATOR(-, inner_minus)
+        CL_INNER_EXPR_OPERATOR(*, inner_multiplies)
+        CL_INNER_EXPR_OPERATOR(/, inner_divides)
+#undef CL_INNER_EXPR_OPERATOR
+
+        template <class Arg>
+        inline inner_unary<inner_negate, Arg> operator-(const inner_expr<Arg>& x)
+        {
+            return inner_unary<inner_negate, Arg>(x.derived());
+        }
+
+        // Standart math functions of expressions.
+#define CL_INNER_EXPR_FUNCTION(Name)                                                            \
+        struct inner_##Name                                                                     \
+        {                                                                                       \
+            template <class T> static T apply(const T& x) { return std::Name(x); }              \
+        };                                                                                      \
+                                                                                                \
+        template <class Arg>                                                                    \
+        inline inner_unary<inner_##Name, Arg> Name(const inner_expr<Arg>& x)                    \
+        {                                                                                       \
+            return inner_unary<inner_##Name, Arg>(x.derived());                                 \
+        }
+        CL_INNER_EXPR_FUNCTION(abs)
+        CL_INNER_EXPR_FUNCTION(acos)
+        CL_INNER_EXPR_FUNCTION(sqrt)
+        CL_INNER_EXPR_FUNCTION(asin)
+        CL_INNER_EXPR_FUNCTION(atan)
+        CL_INNER_EXPR_FUNCTION(cos)
+        CL_INNER_EXPR_FUNCTION(sin)
+        CL_INNER_EXPR_FUNCTION(cosh)
+        CL_INNER_EXPR_FUNCTION(sinh)
+        CL_INNER_EXPR_FUNCTION(exp)
+        CL_INNER_EXPR_FUNCTION(log)
+        CL_INNER_EXPR_FUNCTION(tan)
+        CL_INNER_EXPR_FUNCTION(tanh)
+#undef CL_INNER_EXPR_FUNCTION
+    }
+
+    // Compound assignment of expression evaluates it in one loop with the left side.
+#define CL_INNER_EXPR_ASSIGN_OPERATOR(Op, Func)                                                 \
+    template <class Array, class Expr>                                                          \
+    inline tape_inner<Array>& operator Op##=(                                                   \
+        tape_inner<Array>& z                                                                    \
+        , const tapescript::inner_expr<Expr>& x)                                                \
+    {                                                                                           \
+        if (z.is_intrusive())                                                                   \
+        {                                                                                       \
+            return z Op##= tape_inner<Array>(x);                                                \
+        }                                                                                       \
+        tapescript::evaluate(z, tapescript::inner_binary<tapescript::Func                       \
+            , tapescript::inner_terminal<Array>, Expr>(                                         \
+                tapescript::inner_terminal<Array>(z), x.derived()));                            \
+        return z;                                                                               \
+    }
+
+    CL_INNER_EXPR_ASSIGN_OPERATOR(+, inner_plus)
+    CL_INNER_EXPR_ASSIGN_OPERATOR(-, inner_minus)
+    CL_INNER_EXPR_ASSIGN_OPERATOR(*, inner_multiplies)
+    CL_INNER_EXPR_ASSIGN_OPERATOR(/, inner_divides)
+#undef CL_INNER_EXPR_ASSIGN_OPERATOR
+}
+
+#endif // cl_tape_impl_inner_tape_inner_expr_hpp
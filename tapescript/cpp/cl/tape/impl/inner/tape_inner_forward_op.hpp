@@ -0,0 +1,606 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+This file includes code from CppAD, a C++ algorithmic differentiation library
+distributed under multiple licenses. This distribution is under the terms of
+the Eclipse Public License Version 1.0, a copy of which is available at:
+
+https://www.eclipse.org/legal/epl-v10.html
+
+CppAD code included in this file is subject to copyright:
+
+Copyright (C) 2003-15 Bradley M. Bell
+*/
+
+#ifndef cl_tape_impl_inner_tape_inner_forward_op_hpp
+#define cl_tape_impl_inner_tape_inner_forward_op_hpp
+
+#include <cl/tape/impl/inner/tape_inner.hpp>
+
+// Overloads of CppAD forward operators for tape_inner Base.
+// The stock operators build a new tape_inner for every result
+// and move it into the Taylor slot, here the result is written
+// directly into the existing storage of the slot. So the second
+// and later replays of the same tape do not allocate.
+// Have to be included before the forward sweeps.
+namespace CppAD
+{
+    template <class Array>
+    inline const cl::tape_inner<Array>& par_or_var(
+        bool                                is_var,
+        addr_t                              index,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              d = 0)
+    {
+        return is_var ? taylor[index * cap_order + d] : parameter[index];
+    }
+
+    // z = x op y, both arguments are variables.
+#define CL_INNER_FORWARD_VV_OP(Name, Kernel)                                                    \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op_0(                                                          \
+        size_t                              i_z,                                                \
+        const addr_t*                       arg,                                                \
+        const cl::tape_inner<Array>*,                                                           \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;                                 \
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;                                 \
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;                                    \
+        z[0].Kernel(x[0], y[0]);                                                                \
+    }
+
+    CL_INNER_FORWARD_VV_OP(addvv, assign_add)
+    CL_INNER_FORWARD_VV_OP(subvv, assign_sub)
+    CL_INNER_FORWARD_VV_OP(mulvv, assign_mul)
+    CL_INNER_FORWARD_VV_OP(divvv, assign_div)
+#undef CL_INNER_FORWARD_VV_OP
+
+    // z = p op y, the first argument is a parameter.
+#define CL_INNER_FORWARD_PV_OP(Name, Kernel)                                                    \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op_0(                                                          \
+        size_t                              i_z,                                                \
+        const addr_t*                       arg,                                                \
+        const cl::tape_inner<Array>*        parameter,                                          \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        const cl::tape_inner<Array>& x = parameter[arg[0]];                                     \
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;                                 \
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;                                    \
+        z[0].Kernel(x, y[0]);                                                                   \
+    }
+
+    CL_INNER_FORWARD_PV_OP(addpv, assign_add)
+    CL_INNER_FORWARD_PV_OP(subpv, assign_sub)
+    CL_INNER_FORWARD_PV_OP(mulpv, assign_mul)
+    CL_INNER_FORWARD_PV_OP(divpv, assign_div)
+#undef CL_INNER_FORWARD_PV_OP
+
+    // z = x op p, the second argument is a parameter.
+#define CL_INNER_FORWARD_VP_OP(Name, Kernel)                                                    \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op_0(                                                          \
+        size_t                              i_z,                                                \
+        const addr_t*                       arg,                                                \
+        const cl::tape_inner<Array>*        parameter,                                          \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;                                 \
+        const cl::tape_inner<Array>& y = parameter[arg[1]];                                     \
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;                                    \
+        z[0].Kernel(x[0], y);                                                                   \
+    }
+
+    CL_INNER_FORWARD_VP_OP(subvp, assign_sub)
+    CL_INNER_FORWARD_VP_OP(divvp, assign_div)
+#undef CL_INNER_FORWARD_VP_OP
+
+    // z = f(x) for the functions without auxiliary result.
+#define CL_INNER_FORWARD_UNARY_OP(Name)                                                         \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op_0(                                                          \
+        size_t                              i_z,                                                \
+        size_t                              i_x,                                                \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;                                    \
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;                                    \
+        cl::tapescript::Name(z[0], x[0]);                                                       \
+    }
+
+    CL_INNER_FORWARD_UNARY_OP(abs)
+    CL_INNER_FORWARD_UNARY_OP(exp)
+    CL_INNER_FORWARD_UNARY_OP(log)
+    CL_INNER_FORWARD_UNARY_OP(sign)
+    CL_INNER_FORWARD_UNARY_OP(sqrt)
+#undef CL_INNER_FORWARD_UNARY_OP
+
+    // sin(x) with auxiliary result cos(x) in the previous variable.
+    template <class Array>
+    inline void forward_sin_op_0(
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* s = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* c = s - cap_order;
+
+        cl::tapescript::sin(s[0], x[0]);
+        cl::tapescript::cos(c[0], x[0]);
+    }
+
+    // cos(x) with auxiliary result sin(x) in the previous variable.
+    template <class Array>
+    inline void forward_cos_op_0(
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* c = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* s = c - cap_order;
+
+        cl::tapescript::cos(c[0], x[0]);
+        cl::tapescript::sin(s[0], x[0]);
+    }
+
+    // tanh(x) with auxiliary result tanh(x)^2 in the previous variable.
+    template <class Array>
+    inline void forward_tanh_op_0(
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* y = z - cap_order;
+
+        cl::tapescript::tanh(z[0], x[0]);
+        y[0].assign_mul(z[0], z[0]);
+    }
+
+    // Power operators have three results: log(x), log(x) * y, pow(x, y).
+#define CL_INNER_FORWARD_POW_OP(Name, IsVarX, IsVarY)                                           \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op_0(                                                          \
+        size_t                              i_z,                                                \
+        const addr_t*                       arg,                                                \
+        const cl::tape_inner<Array>*        parameter,                                          \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        i_z -= 2;                                                                               \
+        const cl::tape_inner<Array>& x                                                          \
+            = par_or_var(IsVarX, arg[0], parameter, cap_order, taylor);                         \
+        const cl::tape_inner<Array>& y                                                          \
+            = par_or_var(IsVarY, arg[1], parameter, cap_order, taylor);                         \
+        cl::tape_inner<Array>* z_0 = taylor + i_z * cap_order;                                  \
+        cl::tape_inner<Array>* z_1 = z_0 + cap_order;                                           \
+        cl::tape_inner<Array>* z_2 = z_1 + cap_order;                                           \
+                                                                                                \
+        cl::tapescript::log(z_0[0], x);                                                         \
+        z_1[0].assign_mul(z_0[0], y);                                                           \
+        cl::tapescript::pow(z_2[0], x, y);                                                      \
+    }
+
+    CL_INNER_FORWARD_POW_OP(powvv, true, true)
+    CL_INNER_FORWARD_POW_OP(powpv, false, true)
+    CL_INNER_FORWARD_POW_OP(powvp, true, false)
+#undef CL_INNER_FORWARD_POW_OP
+
+    // Conditional expression, operands are referenced instead of copied.
+    template <class Array>
+    inline void forward_cond_op_0(
+        size_t                              i_z,
+        const addr_t*                       arg,
+        size_t,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(size_t(arg[0]) < static_cast<size_t> (CompareNe));
+        CPPAD_ASSERT_UNKNOWN(arg[1] != 0);
+
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        CondExpOp(
+            z[0],
+            CompareOp(arg[0]),
+            par_or_var((arg[1] & 1) != 0, arg[2], parameter, cap_order, taylor),
+            par_or_var((arg[1] & 2) != 0, arg[3], parameter, cap_order, taylor),
+            par_or_var((arg[1] & 4) != 0, arg[4], parameter, cap_order, taylor),
+            par_or_var((arg[1] & 8) != 0, arg[5], parameter, cap_order, taylor)
+            );
+    }
+
+    // Orders p to q of z = x + y, z = x - y.
+#define CL_INNER_FORWARD_LINEAR_OP(Name, Kernel, IsVarX, IsVarY)                                \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op(                                                            \
+        size_t                              p,                                                  \
+        size_t                              q,                                                  \
+        size_t                              i_z,                                                \
+        const addr_t*                       arg,                                                \
+        const cl::tape_inner<Array>*        parameter,                                          \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);                                                    \
+        CPPAD_ASSERT_UNKNOWN(p <= q);                                                           \
+                                                                                                \
+        const cl::tape_inner<Array> zero(0);                                                    \
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;                                    \
+        for (size_t d = p; d <= q; d++)                                                         \
+        {                                                                                       \
+            /* parameters have zero higher order coefficients */                                \
+            const cl::tape_inner<Array>& x = (IsVarX || d == 0)                                 \
+                ? par_or_var(IsVarX, arg[0], parameter, cap_order, taylor, d) : zero;           \
+            const cl::tape_inner<Array>& y = (IsVarY || d == 0)                                 \
+                ? par_or_var(IsVarY, arg[1], parameter, cap_order, taylor, d) : zero;           \
+            z[d].Kernel(x, y);                                                                  \
+        }                                                                                       \
+    }
+
+    CL_INNER_FORWARD_LINEAR_OP(addvv, assign_add, true, true)
+    CL_INNER_FORWARD_LINEAR_OP(addpv, assign_add, false, true)
+    CL_INNER_FORWARD_LINEAR_OP(subvv, assign_sub, true, true)
+    CL_INNER_FORWARD_LINEAR_OP(subpv, assign_sub, false, true)
+    CL_INNER_FORWARD_LINEAR_OP(subvp, assign_sub, true, false)
+#undef CL_INNER_FORWARD_LINEAR_OP
+
+    // Orders p to q of z = x * y.
+    template <class Array>
+    inline void forward_mulvv_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        for (size_t d = p; d <= q; d++)
+        {
+            z[d].assign(0);
+            for (size_t k = 0; k <= d; k++)
+            {
+                z[d].add_mul(x[d - k], y[k]);
+            }
+        }
+    }
+
+    // Orders p to q of z = p * y.
+    template <class Array>
+    inline void forward_mulpv_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        const cl::tape_inner<Array>& x = parameter[arg[0]];
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        for (size_t d = p; d <= q; d++)
+        {
+            z[d].assign_mul(x, y[d]);
+        }
+    }
+
+    // Orders p to q of z = x / y.
+    template <class Array>
+    inline void forward_divvv_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        for (size_t d = p; d <= q; d++)
+        {
+            z[d] = x[d];
+            for (size_t k = 1; k <= d; k++)
+            {
+                z[d].sub_mul(z[d - k], y[k]);
+            }
+            z[d] /= y[0];
+        }
+    }
+
+    // Orders p to q of z = p / y.
+    template <class Array>
+    inline void forward_divpv_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        const cl::tape_inner<Array>& x = parameter[arg[0]];
+        cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        if (p == 0)
+        {
+            z[0].assign_div(x, y[0]);
+            p++;
+        }
+        for (size_t d = p; d <= q; d++)
+        {
+            z[d].assign(0);
+            for (size_t k = 1; k <= d; k++)
+            {
+                z[d].sub_mul(z[d - k], y[k]);
+            }
+            z[d] /= y[0];
+        }
+    }
+
+    // Orders p to q of z = x / p.
+    template <class Array>
+    inline void forward_divvp_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;
+        const cl::tape_inner<Array>& y = parameter[arg[1]];
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        for (size_t d = p; d <= q; d++)
+        {
+            z[d].assign_div(x[d], y);
+        }
+    }
+
+    // Orders p to q of z = exp(x).
+    template <class Array>
+    inline void forward_exp_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        if (p == 0)
+        {
+            cl::tapescript::exp(z[0], x[0]);
+            p++;
+        }
+        for (size_t j = p; j <= q; j++)
+        {
+            z[j].assign_mul(x[1], z[j - 1]);
+            for (size_t k = 2; k <= j; k++)
+            {
+                z[j].add_mul(x[k], z[j - k], k);
+            }
+            z[j] /= double(j);
+        }
+    }
+
+    // Orders p to q of z = log(x).
+    template <class Array>
+    inline void forward_log_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        if (p == 0)
+        {
+            cl::tapescript::log(z[0], x[0]);
+            p++;
+            if (q == 0)
+                return;
+        }
+        if (p == 1)
+        {
+            z[1].assign_div(x[1], x[0]);
+            p++;
+        }
+        for (size_t j = p; j <= q; j++)
+        {
+            z[j].assign_mul(z[1], x[j - 1]);
+            z[j].negate();
+            for (size_t k = 2; k < j; k++)
+            {
+                z[j].sub_mul(z[k], x[j - k], k);
+            }
+            z[j] /= double(j);
+            z[j] += x[j];
+            z[j] /= x[0];
+        }
+    }
+
+    // Orders p to q of z = sqrt(x).
+    template <class Array>
+    inline void forward_sqrt_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        const cl::tape_inner<Array> half(0.5);
+
+        if (p == 0)
+        {
+            cl::tapescript::sqrt(z[0], x[0]);
+            p++;
+        }
+        for (size_t j = p; j <= q; j++)
+        {
+            z[j].assign(0);
+            for (size_t k = 1; k < j; k++)
+            {
+                z[j].sub_mul(z[k], z[j - k], k);
+            }
+            z[j] /= double(j);
+            z[j].add_mul(x[j], half);
+            z[j] /= z[0];
+        }
+    }
+
+    // Orders p to q of sin(x) and cos(x), the result s or c is selected by IsSin.
+#define CL_INNER_FORWARD_TRIG_OP(Name, IsSin)                                                   \
+    template <class Array>                                                                      \
+    inline void forward_##Name##_op(                                                            \
+        size_t                              p,                                                  \
+        size_t                              q,                                                  \
+        size_t                              i_z,                                                \
+        size_t                              i_x,                                                \
+        size_t                              cap_order,                                          \
+        cl::tape_inner<Array>*              taylor)                                             \
+    {                                                                                           \
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);                                                    \
+        CPPAD_ASSERT_UNKNOWN(p <= q);                                                           \
+                                                                                                \
+        cl::tape_inner<Array>* x = taylor + i_x * cap_order;                                    \
+        cl::tape_inner<Array>* r = taylor + i_z * cap_order;                                    \
+        cl::tape_inner<Array>* s = IsSin ? r : r - cap_order;                                   \
+        cl::tape_inner<Array>* c = IsSin ? r - cap_order : r;                                   \
+                                                                                                \
+        if (p == 0)                                                                             \
+        {                                                                                       \
+            cl::tapescript::sin(s[0], x[0]);                                                    \
+            cl::tapescript::cos(c[0], x[0]);                                                    \
+            p++;                                                                                \
+        }                                                                                       \
+        for (size_t j = p; j <= q; j++)                                                         \
+        {                                                                                       \
+            s[j].assign(0);                                                                     \
+            c[j].assign(0);                                                                     \
+            for (size_t k = 1; k <= j; k++)                                                     \
+            {                                                                                   \
+                s[j].add_mul(x[k], c[j - k], k);                                                \
+                c[j].sub_mul(x[k], s[j - k], k);                                                \
+            }                                                                                   \
+            s[j] /= double(j);                                                                  \
+            c[j] /= double(j);                                                                  \
+        }                                                                                       \
+    }
+
+    CL_INNER_FORWARD_TRIG_OP(sin, true)
+    CL_INNER_FORWARD_TRIG_OP(cos, false)
+#undef CL_INNER_FORWARD_TRIG_OP
+
+    // Orders p to q of the conditional expression.
+    template <class Array>
+    inline void forward_cond_op(
+        size_t                              p,
+        size_t                              q,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        size_t,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        cl::tape_inner<Array>*              taylor)
+    {
+        CPPAD_ASSERT_UNKNOWN(size_t(arg[0]) < static_cast<size_t> (CompareNe));
+        CPPAD_ASSERT_UNKNOWN(arg[1] != 0);
+        CPPAD_ASSERT_UNKNOWN(q < cap_order);
+        CPPAD_ASSERT_UNKNOWN(p <= q);
+
+        const cl::tape_inner<Array> zero(0);
+        cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+
+        const cl::tape_inner<Array>& y_0
+            = par_or_var((arg[1] & 1) != 0, arg[2], parameter, cap_order, taylor);
+        const cl::tape_inner<Array>& y_1
+            = par_or_var((arg[1] & 2) != 0, arg[3], parameter, cap_order, taylor);
+
+        for (size_t d = p; d <= q; d++)
+        {
+            // parameters have zero higher order coefficients
+            const cl::tape_inner<Array>& y_2 = ((arg[1] & 4) != 0 || d == 0)
+                ? par_or_var((arg[1] & 4) != 0, arg[4], parameter, cap_order, taylor, d) : zero;
+            const cl::tape_inner<Array>& y_3 = ((arg[1] & 8) != 0 || d == 0)
+                ? par_or_var((arg[1] & 8) != 0, arg[5], parameter, cap_order, taylor, d) : zero;
+
+            CondExpOp(z[d], CompareOp(arg[0]), y_0, y_1, y_2, y_3);
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_tape_inner_forward_op_hpp
@@ -0,0 +1,463 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+This file includes code from CppAD, a C++ algorithmic differentiation library
+distributed under multiple licenses. This distribution is under the terms of
+the Eclipse Public License Version 1.0, a copy of which is available at:
+
+https://www.eclipse.org/legal/epl-v10.html
+
+CppAD code included in this file is subject to copyright:
+
+Copyright (C) 2003-15 Bradley M. Bell
+*/
+
+#ifndef cl_tape_impl_inner_tape_inner_reverse_op_hpp
+#define cl_tape_impl_inner_tape_inner_reverse_op_hpp
+
+#include <cl/tape/impl/inner/tape_inner_forward_op.hpp>
+
+// Overloads of CppAD reverse operators for tape_inner Base.
+// The stock operators evaluate expressions like px += pz * y
+// through temporary tape_inner objects, here partials are
+// updated in place in a single pass over the lanes.
+// Addition and subtraction are in place already and not overloaded.
+// Have to be included before the reverse sweep.
+namespace CppAD
+{
+    // Returns true if all partials of orders 0 to d are identical zero.
+    template <class Array>
+    inline bool zero_partials(size_t d, const cl::tape_inner<Array>* pz)
+    {
+        bool skip(true);
+        for (size_t i_d = 0; i_d <= d; i_d++)
+            skip &= IdenticalZero(pz[i_d]);
+        return skip;
+    }
+
+    // Reverse z = x * y.
+    template <class Array>
+    inline void reverse_mulvv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        const cl::tape_inner<Array>* x = taylor + arg[0] * cap_order;
+        const cl::tape_inner<Array>* y = taylor + arg[1] * cap_order;
+        cl::tape_inner<Array>* px = partial + arg[0] * nc_partial;
+        cl::tape_inner<Array>* py = partial + arg[1] * nc_partial;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+
+        if (zero_partials(d, pz))
+            return;
+
+        size_t j = d + 1;
+        while (j)
+        {
+            --j;
+            for (size_t k = 0; k <= j; k++)
+            {
+                px[j - k].add_mul(pz[j], y[k]);
+                py[k].add_mul(pz[j], x[j - k]);
+            }
+        }
+    }
+
+    // Reverse z = p * y.
+    template <class Array>
+    inline void reverse_mulpv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t,
+        const cl::tape_inner<Array>*,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        const cl::tape_inner<Array>& x = parameter[arg[0]];
+        cl::tape_inner<Array>* py = partial + arg[1] * nc_partial;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+
+        size_t j = d + 1;
+        while (j)
+        {
+            --j;
+            py[j].add_mul(pz[j], x);
+        }
+    }
+
+    // Reverse z = x / y and z = p / y, x is ignored if px is null.
+    template <class Array>
+    inline void reverse_div_op(
+        size_t                              d,
+        const cl::tape_inner<Array>*        y,
+        const cl::tape_inner<Array>*        z,
+        cl::tape_inner<Array>*              px,
+        cl::tape_inner<Array>*              py,
+        cl::tape_inner<Array>*              pz)
+    {
+        if (zero_partials(d, pz))
+            return;
+
+        size_t j = d + 1;
+        while (j)
+        {
+            --j;
+            pz[j] /= y[0];
+            if (px)
+                px[j] += pz[j];
+            for (size_t k = 1; k <= j; k++)
+            {
+                pz[j - k].sub_mul(pz[j], y[k]);
+                py[k].sub_mul(pz[j], z[j - k]);
+            }
+            py[0].sub_mul(pz[j], z[j]);
+        }
+    }
+
+    // Reverse z = x / y.
+    template <class Array>
+    inline void reverse_divvv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        reverse_div_op(d
+            , taylor + arg[1] * cap_order
+            , taylor + i_z * cap_order
+            , partial + arg[0] * nc_partial
+            , partial + arg[1] * nc_partial
+            , partial + i_z * nc_partial);
+    }
+
+    // Reverse z = p / y.
+    template <class Array>
+    inline void reverse_divpv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        reverse_div_op(d
+            , taylor + arg[1] * cap_order
+            , taylor + i_z * cap_order
+            , (cl::tape_inner<Array>*)0
+            , partial + arg[1] * nc_partial
+            , partial + i_z * nc_partial);
+    }
+
+    // Reverse z = x / p.
+    template <class Array>
+    inline void reverse_divvp_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t,
+        const cl::tape_inner<Array>*,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        const cl::tape_inner<Array>& y = parameter[arg[1]];
+        cl::tape_inner<Array>* px = partial + arg[0] * nc_partial;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+
+        size_t j = d + 1;
+        while (j)
+        {
+            --j;
+            px[j].add_div(pz[j], y);
+        }
+    }
+
+    // Reverse z = exp(x).
+    template <class Array>
+    inline void reverse_exp_op(
+        size_t                              d,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        const cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* px = partial + i_x * nc_partial;
+        const cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+
+        if (zero_partials(d, pz))
+            return;
+
+        size_t j = d;
+        while (j)
+        {
+            pz[j] /= double(j);
+            for (size_t k = 1; k <= j; k++)
+            {
+                px[k].add_mul(pz[j], z[j - k], k);
+                pz[j - k].add_mul(pz[j], x[k], k);
+            }
+            --j;
+        }
+        px[0].add_mul(pz[0], z[0]);
+    }
+
+    // Reverse z = log(x).
+    template <class Array>
+    inline void reverse_log_op(
+        size_t                              d,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        const cl::tape_inner<Array>* x = taylor + i_x * cap_order;
+        cl::tape_inner<Array>* px = partial + i_x * nc_partial;
+        const cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+
+        if (zero_partials(d, pz))
+            return;
+
+        size_t j = d;
+        while (j)
+        {
+            pz[j] /= x[0];
+            px[0].sub_mul(pz[j], z[j]);
+            px[j] += pz[j];
+            pz[j] /= double(j);
+            for (size_t k = 1; k < j; k++)
+            {
+                pz[k].sub_mul(pz[j], x[j - k], k);
+                px[j - k].sub_mul(pz[j], z[k], k);
+            }
+            --j;
+        }
+        px[0].add_div(pz[0], x[0]);
+    }
+
+    // Reverse z = sqrt(x).
+    template <class Array>
+    inline void reverse_sqrt_op(
+        size_t                              d,
+        size_t                              i_z,
+        size_t                              i_x,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        cl::tape_inner<Array>* px = partial + i_x * nc_partial;
+        const cl::tape_inner<Array>* z = taylor + i_z * cap_order;
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+        const cl::tape_inner<Array> two(2);
+
+        if (zero_partials(d, pz))
+            return;
+
+        size_t j = d;
+        while (j)
+        {
+            pz[j] /= z[0];
+            pz[0].sub_mul(pz[j], z[j]);
+            px[j].add_div(pz[j], two);
+            for (size_t k = 1; k < j; k++)
+                pz[k].sub_mul(pz[j], z[j - k]);
+            --j;
+        }
+        px[0].add_div(pz[0], z[0], 2);
+    }
+
+    // Reverse of sin(x) and cos(x), the result is selected by IsSin.
+#define CL_INNER_REVERSE_TRIG_OP(Name, IsSin)                                                   \
+    template <class Array>                                                                      \
+    inline void reverse_##Name##_op(                                                            \
+        size_t                              d,                                                  \
+        size_t                              i_z,                                                \
+        size_t                              i_x,                                                \
+        size_t                              cap_order,                                          \
+        const cl::tape_inner<Array>*        taylor,                                             \
+        size_t                              nc_partial,                                         \
+        cl::tape_inner<Array>*              partial)                                            \
+    {                                                                                           \
+        const cl::tape_inner<Array>* x = taylor + i_x * cap_order;                              \
+        cl::tape_inner<Array>* px = partial + i_x * nc_partial;                                 \
+        const cl::tape_inner<Array>* r = taylor + i_z * cap_order;                              \
+        cl::tape_inner<Array>* pr = partial + i_z * nc_partial;                                 \
+        const cl::tape_inner<Array>* s = IsSin ? r : r - cap_order;                             \
+        const cl::tape_inner<Array>* c = IsSin ? r - cap_order : r;                             \
+        cl::tape_inner<Array>* ps = IsSin ? pr : pr - nc_partial;                               \
+        cl::tape_inner<Array>* pc = IsSin ? pr - nc_partial : pr;                               \
+                                                                                                \
+        if (zero_partials(d, pr))                                                               \
+            return;                                                                             \
+                                                                                                \
+        size_t j = d;                                                                           \
+        while (j)                                                                               \
+        {                                                                                       \
+            ps[j] /= double(j);                                                                 \
+            pc[j] /= double(j);                                                                 \
+            for (size_t k = 1; k <= j; k++)                                                     \
+            {                                                                                   \
+                px[k].add_mul(ps[j], c[j - k], k);                                              \
+                px[k].sub_mul(pc[j], s[j - k], k);                                              \
+                ps[j - k].sub_mul(pc[j], x[k], k);                                              \
+                pc[j - k].add_mul(ps[j], x[k], k);                                              \
+            }                                                                                   \
+            --j;                                                                                \
+        }                                                                                       \
+        px[0].add_mul(ps[0], c[0]);                                                             \
+        px[0].sub_mul(pc[0], s[0]);                                                             \
+    }
+
+    CL_INNER_REVERSE_TRIG_OP(sin, true)
+    CL_INNER_REVERSE_TRIG_OP(cos, false)
+#undef CL_INNER_REVERSE_TRIG_OP
+
+    // Reverse of pow(x, y) through its three results, exp(log(x) * y).
+    template <class Array>
+    inline void reverse_powvv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        i_z -= 2;
+        reverse_exp_op(d, i_z + 2, i_z + 1, cap_order, taylor, nc_partial, partial);
+
+        addr_t adr[2];
+        adr[0] = addr_t(i_z);
+        adr[1] = arg[1];
+        reverse_mulvv_op(d, i_z + 1, adr, parameter, cap_order, taylor, nc_partial, partial);
+
+        reverse_log_op(d, i_z, size_t(arg[0]), cap_order, taylor, nc_partial, partial);
+    }
+
+    // Reverse of pow(p, y), log(p) is a parameter stored in the Taylor coefficients.
+    template <class Array>
+    inline void reverse_powpv_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        i_z -= 2;
+        reverse_exp_op(d, i_z + 2, i_z + 1, cap_order, taylor, nc_partial, partial);
+
+        addr_t adr[2];
+        adr[0] = addr_t(i_z * cap_order);
+        adr[1] = arg[1];
+        reverse_mulpv_op(d, i_z + 1, adr, taylor, cap_order, taylor, nc_partial, partial);
+    }
+
+    // Reverse of pow(x, p).
+    template <class Array>
+    inline void reverse_powvp_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        i_z -= 2;
+        reverse_exp_op(d, i_z + 2, i_z + 1, cap_order, taylor, nc_partial, partial);
+
+        addr_t adr[2];
+        adr[0] = arg[1];
+        adr[1] = addr_t(i_z);
+        reverse_mulpv_op(d, i_z + 1, adr, parameter, cap_order, taylor, nc_partial, partial);
+
+        reverse_log_op(d, i_z, size_t(arg[0]), cap_order, taylor, nc_partial, partial);
+    }
+
+    // Reverse of the conditional expression, the selected partial
+    // is added without a temporary.
+    template <class Array>
+    inline void reverse_cond_op(
+        size_t                              d,
+        size_t                              i_z,
+        const addr_t*                       arg,
+        size_t,
+        const cl::tape_inner<Array>*        parameter,
+        size_t                              cap_order,
+        const cl::tape_inner<Array>*        taylor,
+        size_t                              nc_partial,
+        cl::tape_inner<Array>*              partial)
+    {
+        CPPAD_ASSERT_UNKNOWN(size_t(arg[0]) < static_cast<size_t> (CompareNe));
+        CPPAD_ASSERT_UNKNOWN(arg[1] != 0);
+
+        const cl::tape_inner<Array> zero(0);
+        cl::tape_inner<Array>* pz = partial + i_z * nc_partial;
+        const cl::tape_inner<Array>& y_0
+            = par_or_var((arg[1] & 1) != 0, arg[2], parameter, cap_order, taylor);
+        const cl::tape_inner<Array>& y_1
+            = par_or_var((arg[1] & 2) != 0, arg[3], parameter, cap_order, taylor);
+
+        if (arg[1] & 4)
+        {
+            cl::tape_inner<Array>* py_2 = partial + arg[4] * nc_partial;
+            size_t j = d + 1;
+            while (j--)
+            {
+                CondExpOpAdd(py_2[j], CompareOp(arg[0]), y_0, y_1, pz[j], zero);
+            }
+        }
+        if (arg[1] & 8)
+        {
+            cl::tape_inner<Array>* py_3 = partial + arg[5] * nc_partial;
+            size_t j = d + 1;
+            while (j--)
+            {
+                CondExpOpAdd(py_3[j], CompareOp(arg[0]), y_0, y_1, zero, pz[j]);
+            }
+        }
+    }
+}
+
+#endif // cl_tape_impl_inner_tape_inner_reverse_op_hpp
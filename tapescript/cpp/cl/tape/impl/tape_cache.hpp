@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_tape_cache_hpp
+#define cl_tape_impl_tape_cache_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include <cl/tape/impl/detail/utils.hpp>
+
+#if defined CL_TAPE_CPPAD
+
+namespace cl
+{
+    /// <summary>Cache of the recorded tapes of a function which is called
+    /// many times with the same control flow. The tape is found by the call
+    /// site given by the user and the lane counts of the inputs, it is replayed
+    /// by zero order forward sweep on the new inputs and recorded again only if
+    /// a comparison of the sweep has a result different from the recording.
+    /// The values used by the recording besides the inputs have to be the same
+    /// for the call site, the values which change are passed as inputs
+    /// or as dynamic parameters.</summary>
+    template <class Base>
+    class tape_cache
+    {
+    public:
+        typedef tape_function<Base> function_type;
+        typedef std::vector<tape_wrapper<Base>> tape_vector;
+
+        tape_cache()
+            : hits_(0)
+            , records_(0)
+        {}
+
+        // Returns the tape of site for the inputs x with y = f(x) computed
+        // by zero order forward sweep, reverse sweeps can follow. The tape
+        // is recorded by Y = record(X) if it is not cached for the key
+        // or the control flow at x is not the recorded one. If record throws
+        // the recording is aborted and the exception is passed on.
+        template <class VectorBase, class Record>
+        function_type& forward(std::string const& site, VectorBase const& x, VectorBase& y, Record record)
+        {
+            std::unique_ptr<function_type>& f = tapes_[key(site, x)];
+            if (f)
+            {
+                y = f->forward(0, x);
+                if (f->compare_change() == 0)
+                {
+                    hits_++;
+                    return *f;
+                }
+            }
+
+            tape_vector X;
+            X.reserve(x.size());
+            for (size_t j = 0; j < size_t(x.size()); j++)
+            {
+                X.push_back(tape_wrapper<Base>(x[j]));
+            }
+            tape_start(X);
+            tape_vector Y;
+            try
+            {
+                Y = record(X);
+                f.reset(new function_type(X, Y));
+            }
+            catch (...)
+            {
+                // the next recording on this thread can start
+                CppAD::AD<Base>::abort_recording();
+                throw;
+            }
+            records_++;
+
+            // the tape keeps the values of the recording as zero order coefficients
+            y.resize(Y.size());
+            for (size_t i = 0; i < Y.size(); i++)
+            {
+                y[i] = CppAD::Value(get_ad_value(Y[i]));
+            }
+            return *f;
+        }
+
+        // Number of calls which replayed a cached tape.
+        size_t hits() const { return hits_; }
+
+        // Number of calls which recorded the tape.
+        size_t records() const { return records_; }
+
+        // Number of cached tapes.
+        size_t size() const { return tapes_.size(); }
+
+        void clear()
+        {
+            tapes_.clear();
+        }
+
+    private:
+        // Call site followed by the lane counts of the inputs, zero for scalar.
+        typedef std::pair<std::string, std::vector<size_t>> key_type;
+
+        struct key_hash
+        {
+            size_t operator()(key_type const& k) const
+            {
+                size_t h = std::hash<std::string>()(k.first);
+                for (size_t lanes : k.second)
+                {
+                    h ^= lanes + 0x9e3779b9 + (h << 6) + (h >> 2);
+                }
+                return h;
+            }
+        };
+
+        template <class VectorBase>
+        static key_type key(std::string const& site, VectorBase const& x)
+        {
+            key_type k(site, std::vector<size_t>(x.size()));
+            for (size_t j = 0; j < size_t(x.size()); j++)
+            {
+                k.second[j] = tapescript::simplify_traits<Base>::lanes(x[j]);
+            }
+            return k;
+        }
+
+        std::unordered_map<key_type, std::unique_ptr<function_type>, key_hash> tapes_;
+        size_t hits_;
+        size_t records_;
+    };
+}
+
+#endif
+
+#endif // cl_tape_impl_tape_cache_hpp
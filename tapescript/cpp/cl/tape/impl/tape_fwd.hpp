@@ -92,6 +92,17 @@ namespace cl
     template <typename Base>
     class tape_function;
 
+    namespace tapescript
+    {
+        /// <summary>Record time simplification of tape_wrapper operations.</summary>
+        template <class Base>
+        class ad_simplify;
+
+        /// <summary>Fields of CppAD::AD which are protected in this library.</summary>
+        template <class Base>
+        struct ad_fields;
+    }
+
     template <class Array> struct tape_inner;
     typedef std::valarray<double> tape_array;
     typedef tape_inner<tape_array> tape_value;
@@ -198,6 +209,23 @@ namespace CppAD
         const cl::tape_inner<Array>&       exp_if_true,
         const cl::tape_inner<Array>&       exp_if_false);
 
+    template <typename Array>
+    void CondExpOp(
+        cl::tape_inner<Array>&             result,
+        CompareOp                      cop,
+        const cl::tape_inner<Array>&       left,
+        const cl::tape_inner<Array>&       right,
+        const cl::tape_inner<Array>&       exp_if_true,
+        const cl::tape_inner<Array>&       exp_if_false);
+
+    template <typename Array>
+    void CondExpOpAdd(
+        cl::tape_inner<Array>&             result,
+        CompareOp                      cop,
+        const cl::tape_inner<Array>&       left,
+        const cl::tape_inner<Array>&       right,
+        const cl::tape_inner<Array>&       exp_if_true,
+        const cl::tape_inner<Array>&       exp_if_false);
 
 }
 
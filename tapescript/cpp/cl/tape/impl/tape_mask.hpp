@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2015-present CompatibL
+
+Performance test results and finance-specific examples are available at:
+
+http://www.tapescript.org
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef cl_tape_impl_tape_mask_hpp
+#define cl_tape_impl_tape_mask_hpp
+
+#include <memory>
+#include <cl/tape/impl/double.hpp>
+#include <cl/tape/impl/detail/utils.hpp>
+
+namespace cl
+{
+    namespace tapescript
+    {
+        template <class Base>
+        struct tape_mask_node;
+
+        /// <summary>Lane mask which is the result of lanewise comparison
+        /// of tape values, or of the combination of masks by &, | and !.
+        /// The comparison is not recorded by itself, where(mask, a, b) records
+        /// one conditional expression for each comparison of the mask, and
+        /// its lanes are selected by branch-free kernel.
+        /// Masks share their nodes, so the combination and the inversion
+        /// do not copy the sub-masks or the compared values.</summary>
+        template <class Base>
+        struct tape_mask
+        {
+            enum compare_type { Lt, Le, Eq, Ge, Gt, And, Or };
+
+            tape_mask(compare_type compare, tape_wrapper<Base> const& left, tape_wrapper<Base> const& right)
+                : node_(std::make_shared<tape_mask_node<Base>>(compare, left, right))
+                , inverted_(false)
+            {}
+
+            tape_mask(compare_type combine, tape_mask const& first, tape_mask const& second)
+                : node_(std::make_shared<tape_mask_node<Base>>(combine, first, second))
+                , inverted_(false)
+            {}
+
+            tape_mask(std::shared_ptr<const tape_mask_node<Base>> const& node, bool inverted)
+                : node_(node)
+                , inverted_(inverted)
+            {}
+
+            // Returns mask of the lanes where this mask is false.
+            tape_mask operator!() const
+            {
+                tape_mask result(*this);
+                result.inverted_ = !inverted_;
+                return result;
+            }
+
+#if !defined CL_TAPE_CPPAD
+            // Returns comparison result, without tape
+            // the values are doubles of a single lane.
+            bool holds() const
+            {
+                return node_->holds() != inverted_;
+            }
+#endif
+
+            std::shared_ptr<const tape_mask_node<Base>> node_;
+            bool inverted_;
+        };
+
+        /// <summary>Node of the mask tree, either the comparison
+        /// of two values or the combination of two masks.</summary>
+        template <class Base>
+        struct tape_mask_node
+        {
+            typedef typename tape_mask<Base>::compare_type compare_type;
+
+            tape_mask_node(compare_type compare, tape_wrapper<Base> const& left, tape_wrapper<Base> const& right)
+                : compare_(compare)
+                , left_(left)
+                , right_(right)
+                , first_()
+                , second_()
+                , first_inverted_(false)
+                , second_inverted_(false)
+            {}
+
+            tape_mask_node(compare_type combine, tape_mask<Base> const& first, tape_mask<Base> const& second)
+                : compare_(combine)
+                , left_()
+                , right_()
+                , first_(first.node_)
+                , second_(second.node_)
+                , first_inverted_(first.inverted_)
+                , second_inverted_(second.inverted_)
+            {}
+
+            tape_mask<Base> first() const { return tape_mask<Base>(first_, first_inverted_); }
+
+            tape_mask<Base> second() const { return tape_mask<Base>(second_, second_inverted_); }
+
+#if defined CL_TAPE_CPPAD
+            CppAD::CompareOp compare_op() const
+            {
+                switch (compare_)
+                {
+                case tape_mask<Base>::Lt: return CppAD::CompareLt;
+                case tape_mask<Base>::Le: return CppAD::CompareLe;
+                case tape_mask<Base>::Eq: return CppAD::CompareEq;
+                case tape_mask<Base>::Ge: return CppAD::CompareGe;
+                default: return CppAD::CompareGt;
+                }
+            }
+#else
+            bool holds() const
+            {
+                switch (compare_)
+                {
+                case tape_mask<Base>::Lt: return left_ < right_;
+                case tape_mask<Base>::Le: return left_ <= right_;
+                case tape_mask<Base>::Eq: return left_ == right_;
+                case tape_mask<Base>::Ge: return left_ >= right_;
+                case tape_mask<Base>::Gt: return left_ > right_;
+                case tape_mask<Base>::And: return first().holds() && second().holds();
+                default: return first().holds() || second().holds();
+                }
+            }
+#endif
+
+            compare_type compare_;
+            // compared values
+            tape_wrapper<Base> left_;
+            tape_wrapper<Base> right_;
+            // combined masks, shared with the operands of & and |
+            std::shared_ptr<const tape_mask_node> first_;
+            std::shared_ptr<const tape_mask_node> second_;
+            bool first_inverted_;
+            bool second_inverted_;
+        };
+
+        // Mask of the lanes where both masks are true.
+        template <class Base>
+        inline tape_mask<Base> operator&(tape_mask<Base> const& x, tape_mask<Base> const& y)
+        {
+            return tape_mask<Base>(tape_mask<Base>::And, x, y);
+        }
+
+        // Mask of the lanes where either mask is true.
+        template <class Base>
+        inline tape_mask<Base> operator|(tape_mask<Base> const& x, tape_mask<Base> const& y)
+        {
+            return tape_mask<Base>(tape_mask<Base>::Or, x, y);
+        }
+
+#define CL_TAPE_MASK_COMPARE(Name, Compare)                                                     \
+        template <class Base>                                                                   \
+        inline tape_mask<Base> Name(tape_wrapper<Base> const& x, tape_wrapper<Base> const& y)   \
+        {                                                                                       \
+            return tape_mask<Base>(tape_mask<Base>::Compare, x, y);                             \
+        }                                                                                       \
+                                                                                                \
+        template <class Base>                                                                   \
+        inline tape_mask<Base> Name(tape_wrapper<Base> const& x, double y)                      \
+        {                                                                                       \
+            return Name(x, tape_wrapper<Base>(y));                                              \
+        }                                                                                       \
+                                                                                                \
+        template <class Base>                                                                   \
+        inline tape_mask<Base> Name(double x, tape_wrapper<Base> const& y)                      \
+        {                                                                                       \
+            return Name(tape_wrapper<Base>(x), y);                                              \
+        }
+
+        // Lanewise x < y.
+        CL_TAPE_MASK_COMPARE(lt, Lt)
+        // Lanewise x <= y.
+        CL_TAPE_MASK_COMPARE(le, Le)
+        // Lanewise x == y.
+        CL_TAPE_MASK_COMPARE(eq, Eq)
+        // Lanewise x >= y.
+        CL_TAPE_MASK_COMPARE(ge, Ge)
+        // Lanewise x > y.
+        CL_TAPE_MASK_COMPARE(gt, Gt)
+#undef CL_TAPE_MASK_COMPARE
+
+        // Returns lanes of if_true where mask is true and lanes of if_false elsewhere.
+        // The combined masks are selected by nested conditional expressions.
+        template <class Base>
+        inline tape_wrapper<Base> where(tape_mask<Base> const& mask
+            , tape_wrapper<Base> const& if_true, tape_wrapper<Base> const& if_false)
+        {
+#if defined CL_TAPE_CPPAD
+            tape_mask_node<Base> const& node = *mask.node_;
+            tape_wrapper<Base> const& t = mask.inverted_ ? if_false : if_true;
+            tape_wrapper<Base> const& f = mask.inverted_ ? if_true : if_false;
+            switch (node.compare_)
+            {
+            case tape_mask<Base>::And:
+                return where(node.first(), where(node.second(), t, f), f);
+            case tape_mask<Base>::Or:
+                return where(node.first(), t, where(node.second(), t, f));
+            default:
+                return CppAD::CondExpOp(node.compare_op(), get_ad_value(node.left_), get_ad_value(node.right_)
+                    , get_ad_value(t), get_ad_value(f));
+            }
+#else
+            return mask.holds() ? if_true : if_false;
+#endif
+        }
+
+        template <class Base>
+        inline tape_wrapper<Base> where(tape_mask<Base> const& mask
+            , tape_wrapper<Base> const& if_true, double if_false)
+        {
+            return where(mask, if_true, tape_wrapper<Base>(if_false));
+        }
+
+        template <class Base>
+        inline tape_wrapper<Base> where(tape_mask<Base> const& mask
+            , double if_true, tape_wrapper<Base> const& if_false)
+        {
+            return where(mask, tape_wrapper<Base>(if_true), if_false);
+        }
+    }
+}
+
+#endif // cl_tape_impl_tape_mask_hpp
@@ -101,6 +101,15 @@ namespace cl
 #       include <cl/tape/impl/detail/enable_ad.hpp>
 #   endif
 
+#   if defined CL_TAPE_INNER_ARRAY_ENABLED
+#       include <cl/tape/impl/inner/tape_inner_forward_op.hpp>
+#       include <cl/tape/impl/inner/tape_inner_reverse_op.hpp>
+#   endif
+
+#   include <cl/tape/impl/ad/tape_compare.hpp>
+#   include <cl/tape/impl/ad/tape_fusion.hpp>
+#   include <cl/tape/impl/ad/tape_liveness.hpp>
+#   include <cl/tape/impl/ad/tape_recompute.hpp>
 #   include <cl/tape/impl/ad/tape_forward0sweep.hpp>
 #   include <cl/tape/impl/ad/tape_forward1sweep.hpp>
 #   include <cl/tape/impl/ad/tape_reverse_sweep.hpp>
@@ -119,6 +128,9 @@ namespace cl
 #   undef private
 
 #   include <cl/tape/impl/ad/tape_reverse.hpp>
+#   include <cl/tape/impl/ad/tape_lane_shards.hpp>
+#   include <cl/tape/impl/ad/tape_optimizer.hpp>
+#   include <cl/tape/impl/ad/tape_dynamic.hpp>
 
 
 //#   if defined CL_BASE_SERIALIZER_OPEN
@@ -168,6 +180,9 @@ namespace ext
 #include <cl/tape/impl/doublelimits.hpp>
 #include <cl/tape/impl/doublemath.hpp>
 #include <cl/tape/impl/doubleoperators.hpp>
+#include <cl/tape/impl/tape_mask.hpp>
+#include <cl/tape/impl/tape_cache.hpp>
+#include <cl/tape/impl/atomics/tape_loop.hpp>
 
 #if defined CL_TAPE_COMPLEX_ENABLED
 #   include <cl/tape/impl/traits.hpp>